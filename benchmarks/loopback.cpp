@@ -0,0 +1,689 @@
+/*
+ * End-to-end throughput and latency of the socket classes over the loopback
+ * interface. Both ends run in this process: the main thread drives clients and
+ * an echo server by polling, like a game would, while the IO threads of the
+ * library do the actual work.
+ *
+ * Scenarios:
+ * - tcp: connections from TcpSocket::connectTo to a CombinedTcpAcceptor, each
+ *   keeping a window of messages in flight which the server echoes back.
+ * - tcp-connect: the rate at which connections are established and accepted,
+ *   with the given number of connections opened at once.
+ * - udp: UdpSocket clients sending datagrams to a UdpSocket which echoes them,
+ *   with segmentation offload enabled and disabled. The loopback MTU of 64 KB
+ *   accepts any segment size, so this doesn't cover paths where the kernel
+ *   rejects segments because the MTU is smaller.
+ * - rudp: one-way traffic over ReliableUdpConnection pairs, with more messages
+ *   queued than fit into the send window. Fails if the sender retransmits
+ *   messages which have arrived, e.g. because acknowledgements lag behind.
+ *   Datagrams the kernel drops for lack of receive buffer space are counted as
+ *   lost, their retransmits are expected.
+ *
+ * msgs/s counts completed round trips, MB/s the payload bytes echoed per second
+ * in one direction. Latencies are round trip times in microseconds, except for
+ * rudp where they are the time from send() until the message is received. For
+ * udp, datagrams which don't come back within LOSS_TIMEOUT are counted as lost.
+ *
+ * Run with --help for the options. With --json, the results are written as JSON.
+ */
+#include <faucet/Asio.hpp>
+#include <faucet/Buffer.hpp>
+#include <faucet/SocketStats.hpp>
+#include <faucet/tcp/TcpSocket.hpp>
+#include <faucet/tcp/CombinedTcpAcceptor.hpp>
+#include <faucet/udp/UdpSocket.hpp>
+#include <faucet/udp/ReliableUdpConnection.hpp>
+
+#include <boost/integer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	const std::chrono::milliseconds LOSS_TIMEOUT(500);
+
+	/**
+	 * Messages kept queued on each rudp sender, well above the 256 messages
+	 * which ReliableUdpConnection keeps in flight.
+	 */
+	const size_t RUDP_BACKLOG = 1024;
+
+	/**
+	 * The most datagrams per message an rudp run may take. Each message needs
+	 * one, and the receiver acknowledges every IMMEDIATE_ACK_PACKETS of them.
+	 */
+	const double RUDP_MAX_DATAGRAMS_PER_MESSAGE = 1.25;
+
+	struct Options {
+		Options() : host("127.0.0.1"), sizes(), connections(), windows(), offload(),
+				warmupSeconds(0.2), durationSeconds(1.0), shards(1), json(false),
+				tcp(true), tcpConnect(true), udp(true), rudp(true) {}
+
+		std::string host;
+		std::vector<size_t> sizes;
+		std::vector<size_t> connections;
+		std::vector<size_t> windows;
+		std::vector<size_t> offload;
+		double warmupSeconds;
+		double durationSeconds;
+		size_t shards;
+		bool json;
+		bool tcp;
+		bool tcpConnect;
+		bool udp;
+		bool rudp;
+	};
+
+	struct Result {
+		Result(const std::string &scenario, size_t size, size_t connections, size_t window, int offload) :
+				scenario(scenario), size(size), connections(connections), window(window), offload(offload),
+				messages(0), lost(0), seconds(0), rttMicros() {}
+
+		std::string scenario;
+		size_t size;
+		size_t connections;
+		size_t window;
+		int offload;
+		uint64_t messages;
+		uint64_t lost;
+		double seconds;
+		std::vector<double> rttMicros;
+	};
+
+	/**
+	 * Tracks the warmup and measurement phases of a run.
+	 */
+	class Phase {
+	public:
+		explicit Phase(const Options &options) :
+				measureStart_(Clock::now() + toDuration(options.warmupSeconds)),
+				end_(measureStart_ + toDuration(options.durationSeconds)),
+				measuring_(false) {}
+
+		/**
+		 * Returns false once the run is over. Clears the result when the
+		 * measurement starts, so that only the measured phase is reported.
+		 */
+		bool update(Result &result) {
+			Clock::time_point now = Clock::now();
+			if(!measuring_ && now >= measureStart_) {
+				measuring_ = true;
+				result.messages = 0;
+				result.lost = 0;
+				result.rttMicros.clear();
+			}
+			if(now >= end_) {
+				result.seconds = std::chrono::duration<double>(now - measureStart_).count();
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		static Clock::duration toDuration(double seconds) {
+			return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+		}
+
+		Clock::time_point measureStart_;
+		Clock::time_point end_;
+		bool measuring_;
+	};
+
+	double microsSince(Clock::time_point start) {
+		return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+	}
+
+	void fail(const std::string &message) {
+		fprintf(stderr, "%s\n", message.c_str());
+		exit(1);
+	}
+
+	void checkError(Fallible &fallible) {
+		if(fallible.hasError()) {
+			fail(fallible.getErrorMessage());
+		}
+	}
+
+	std::vector<size_t> parseList(const std::string &list) {
+		std::vector<size_t> values;
+		size_t start = 0;
+		while(start <= list.size()) {
+			size_t end = list.find(',', start);
+			if(end == std::string::npos) {
+				end = list.size();
+			}
+			std::string item = list.substr(start, end - start);
+			if(item == "on") {
+				values.push_back(1);
+			} else if(item == "off") {
+				values.push_back(0);
+			} else if(!item.empty()) {
+				values.push_back(strtoul(item.c_str(), 0, 10));
+			}
+			start = end + 1;
+		}
+		return values;
+	}
+
+	void printUsage() {
+		printf("Options (lists are comma separated):\n"
+				"  --host=ADDRESS         127.0.0.1 or ::1 (default 127.0.0.1)\n"
+				"  --sizes=LIST           message sizes in bytes (default 16,256,1400,16384)\n"
+				"  --connections=LIST     concurrent connections or UDP clients (default 1,16,64)\n"
+				"  --window=LIST          messages in flight per connection (default 1,32)\n"
+				"  --offload=LIST         UDP segmentation offload, on and/or off (default on,off)\n"
+				"  --warmup=SECONDS       time before measuring each run (default 0.2)\n"
+				"  --duration=SECONDS     measured time of each run (default 1)\n"
+				"  --shards=N             listener shards of the acceptor (default 1)\n"
+				"  --scenarios=LIST       any of tcp,tcp-connect,udp,rudp (default all)\n"
+				"  --json                 write the results as JSON\n");
+	}
+
+	Options parseOptions(int argc, char **argv) {
+		Options options;
+		options.sizes = parseList("16,256,1400,16384");
+		options.connections = parseList("1,16,64");
+		options.windows = parseList("1,32");
+		options.offload = parseList("on,off");
+
+		for(int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			size_t equals = arg.find('=');
+			std::string name = arg.substr(0, equals);
+			std::string value = (equals == std::string::npos) ? "" : arg.substr(equals + 1);
+
+			if(name == "--host") {
+				options.host = value;
+			} else if(name == "--sizes") {
+				options.sizes = parseList(value);
+			} else if(name == "--connections") {
+				options.connections = parseList(value);
+			} else if(name == "--window") {
+				options.windows = parseList(value);
+			} else if(name == "--offload") {
+				options.offload = parseList(value);
+			} else if(name == "--warmup") {
+				options.warmupSeconds = atof(value.c_str());
+			} else if(name == "--duration") {
+				options.durationSeconds = atof(value.c_str());
+			} else if(name == "--shards") {
+				options.shards = strtoul(value.c_str(), 0, 10);
+			} else if(name == "--scenarios") {
+				std::string list = "," + value + ",";
+				options.tcp = (list.find(",tcp,") != std::string::npos);
+				options.tcpConnect = (list.find(",tcp-connect,") != std::string::npos);
+				options.udp = (list.find(",udp,") != std::string::npos);
+				options.rudp = (list.find(",rudp,") != std::string::npos);
+			} else if(name == "--json") {
+				options.json = true;
+			} else {
+				printUsage();
+				exit(name == "--help" ? 0 : 1);
+			}
+		}
+		return options;
+	}
+
+	/*
+	 * TCP echo: the server writes back whatever it receives, and each client
+	 * counts a message as complete once all of its bytes have returned.
+	 */
+	struct TcpClient {
+		std::shared_ptr<TcpSocket> socket;
+		std::deque<Clock::time_point> sendTimes;
+		size_t partialBytes;
+	};
+
+	Result runTcp(const Options &options, size_t size, size_t connections, size_t window) {
+		Result result("tcp", size, connections, window, -1);
+		auto acceptor = CombinedTcpAcceptor::listen(0, boost::asio::socket_base::max_connections, options.shards);
+		checkError(*acceptor);
+
+		std::vector<TcpClient> clients(connections);
+		for(size_t i = 0; i < connections; ++i) {
+			clients[i].socket = TcpSocket::connectTo(options.host.c_str(), acceptor->getLocalPort());
+			clients[i].partialBytes = 0;
+		}
+
+		std::vector<std::shared_ptr<TcpSocket> > serverSockets;
+		while(serverSockets.size() < connections) {
+			std::shared_ptr<TcpSocket> accepted = acceptor->accept();
+			if(accepted) {
+				serverSockets.push_back(accepted);
+			} else {
+				std::this_thread::yield();
+			}
+			checkError(*acceptor);
+		}
+
+		std::vector<uint8_t> message(size, 0x5a);
+		Phase phase(options);
+		while(phase.update(result)) {
+			bool progress = false;
+			for(TcpClient &client : clients) {
+				if(client.sendTimes.size() < window) {
+					while(client.sendTimes.size() < window) {
+						client.socket->write(message.data(), size);
+						client.sendTimes.push_back(Clock::now());
+					}
+					client.socket->send();
+					progress = true;
+				}
+			}
+
+			for(auto &server : serverSockets) {
+				if(server->receive() > 0) {
+					Buffer &received = server->getReceiveBuffer();
+					server->write(received.getData(), received.size());
+					server->send();
+					progress = true;
+				}
+			}
+
+			for(TcpClient &client : clients) {
+				size_t received = client.socket->receive();
+				if(received > 0) {
+					client.partialBytes += received;
+					while(client.partialBytes >= size) {
+						result.rttMicros.push_back(microsSince(client.sendTimes.front()));
+						client.sendTimes.pop_front();
+						client.partialBytes -= size;
+						++result.messages;
+					}
+					progress = true;
+				}
+				checkError(*client.socket);
+			}
+
+			if(!progress) {
+				std::this_thread::yield();
+			}
+		}
+
+		for(TcpClient &client : clients) {
+			client.socket->disconnectAbortive();
+		}
+		return result;
+	}
+
+	/*
+	 * Connection rate: open the given number of connections at once, wait until
+	 * all of them are established on both ends, then reset them and start over.
+	 * The latency is the time from connectTo() until the client is connected.
+	 */
+	Result runTcpConnect(const Options &options, size_t connections) {
+		Result result("tcp-connect", 0, connections, 0, -1);
+		auto acceptor = CombinedTcpAcceptor::listen(0, boost::asio::socket_base::max_connections, options.shards);
+		checkError(*acceptor);
+
+		Phase phase(options);
+		while(phase.update(result)) {
+			Clock::time_point started = Clock::now();
+			std::vector<std::shared_ptr<TcpSocket> > clients;
+			for(size_t i = 0; i < connections; ++i) {
+				clients.push_back(TcpSocket::connectTo(options.host.c_str(), acceptor->getLocalPort()));
+			}
+
+			std::vector<std::shared_ptr<TcpSocket> > serverSockets;
+			std::vector<bool> connected(connections, false);
+			size_t connectedCount = 0;
+			while(connectedCount < connections || serverSockets.size() < connections) {
+				std::shared_ptr<TcpSocket> accepted = acceptor->accept();
+				if(accepted) {
+					serverSockets.push_back(accepted);
+				}
+				for(size_t i = 0; i < connections; ++i) {
+					if(!connected[i] && !clients[i]->isConnecting()) {
+						checkError(*clients[i]);
+						connected[i] = true;
+						++connectedCount;
+						result.rttMicros.push_back(microsSince(started));
+					}
+				}
+				if(!accepted) {
+					std::this_thread::yield();
+				}
+			}
+			result.messages += connections;
+
+			for(size_t i = 0; i < connections; ++i) {
+				clients[i]->disconnectAbortive();
+				serverSockets[i]->disconnectAbortive();
+			}
+		}
+		return result;
+	}
+
+	/*
+	 * UDP echo: every datagram carries a sequence number in its first bytes, so
+	 * that the client can match replies and detect lost datagrams. Clients cork
+	 * their socket while refilling the window, so that the datagrams are passed
+	 * to the kernel in batches.
+	 */
+	struct UdpClient {
+		std::shared_ptr<UdpSocket> socket;
+		std::unordered_map<uint64_t, Clock::time_point> inFlight;
+	};
+
+	Result runUdp(const Options &options, size_t size, size_t connections, size_t window, bool offload) {
+		size = std::max(size, sizeof(uint64_t));
+		Result result("udp", size, connections, window, offload);
+
+		auto server = UdpSocket::bind(0);
+		checkError(*server);
+		server->setSegmentationOffload(offload);
+		boost::asio::ip::udp::endpoint serverEndpoint(boost::asio::ip::address::from_string(options.host),
+				server->getLocalPort());
+
+		std::vector<UdpClient> clients(connections);
+		for(UdpClient &client : clients) {
+			client.socket = UdpSocket::bind(0);
+			checkError(*client.socket);
+			client.socket->setSegmentationOffload(offload);
+		}
+
+		std::vector<uint8_t> message(size, 0x5a);
+		uint64_t nextSequence = 0;
+		Clock::time_point lastExpiry = Clock::now();
+		Phase phase(options);
+		while(phase.update(result)) {
+			bool progress = false;
+			for(UdpClient &client : clients) {
+				if(client.inFlight.size() < window) {
+					client.socket->setCorked(true);
+					while(client.inFlight.size() < window) {
+						uint64_t sequence = nextSequence++;
+						memcpy(message.data(), &sequence, sizeof(sequence));
+						std::unique_ptr<Buffer> datagram(new Buffer());
+						datagram->write(message.data(), size);
+						client.inFlight[sequence] = Clock::now();
+						client.socket->send(std::move(datagram), serverEndpoint);
+					}
+					client.socket->setCorked(false);
+					progress = true;
+				}
+			}
+
+			while(server->receive()) {
+				Buffer &received = server->getReceiveBuffer();
+				std::unique_ptr<Buffer> reply(new Buffer());
+				reply->write(received.getData(), received.size());
+				boost::asio::ip::udp::endpoint sender(boost::asio::ip::address::from_string(server->getRemoteIp()),
+						server->getRemotePort());
+				server->send(std::move(reply), sender);
+				progress = true;
+			}
+
+			for(UdpClient &client : clients) {
+				while(client.socket->receive()) {
+					uint64_t sequence;
+					if(client.socket->read(reinterpret_cast<uint8_t *>(&sequence), sizeof(sequence)) == sizeof(sequence)) {
+						auto found = client.inFlight.find(sequence);
+						if(found != client.inFlight.end()) {
+							result.rttMicros.push_back(microsSince(found->second));
+							client.inFlight.erase(found);
+							++result.messages;
+						}
+					}
+					progress = true;
+				}
+			}
+
+			Clock::time_point now = Clock::now();
+			if(now - lastExpiry >= LOSS_TIMEOUT / 5) {
+				for(UdpClient &client : clients) {
+					for(auto it = client.inFlight.begin(); it != client.inFlight.end();) {
+						if(now - it->second >= LOSS_TIMEOUT) {
+							it = client.inFlight.erase(it);
+							++result.lost;
+						} else {
+							++it;
+						}
+					}
+				}
+				lastExpiry = now;
+			}
+
+			if(!progress) {
+				std::this_thread::yield();
+			}
+		}
+
+		for(UdpClient &client : clients) {
+			client.socket->close();
+		}
+		server->close();
+		return result;
+	}
+
+	/*
+	 * Reliable UDP, one way: each sender keeps RUDP_BACKLOG messages queued on
+	 * channel 0 and the receiver only reads. Since the channel is ordered, the
+	 * send times of the outstanding messages are matched in order.
+	 */
+	struct RudpPair {
+		std::shared_ptr<ReliableUdpConnection> sender;
+		std::shared_ptr<ReliableUdpConnection> receiver;
+		std::deque<Clock::time_point> sendTimes;
+	};
+
+	/**
+	 * Datagrams dropped by the kernel because a socket's receive buffer was
+	 * full, for IPv4 and IPv6 together. These counters are system wide.
+	 */
+	uint64_t kernelReceiveDrops() {
+		uint64_t drops = 0;
+		std::ifstream snmp("/proc/net/snmp");
+		std::string names, values;
+		while(std::getline(snmp, names) && std::getline(snmp, values)) {
+			if(names.compare(0, 4, "Udp:") != 0) {
+				continue;
+			}
+			std::istringstream nameStream(names), valueStream(values);
+			std::string name, value;
+			while(nameStream >> name && valueStream >> value) {
+				if(name == "RcvbufErrors") {
+					drops += strtoull(value.c_str(), 0, 10);
+				}
+			}
+		}
+
+		std::ifstream snmp6("/proc/net/snmp6");
+		std::string name;
+		uint64_t value;
+		while(snmp6 >> name >> value) {
+			if(name == "Udp6RcvbufErrors") {
+				drops += value;
+			}
+		}
+		return drops;
+	}
+
+	uint16_t unusedUdpPort() {
+		auto socket = UdpSocket::bind(0);
+		checkError(*socket);
+		uint16_t port = socket->getLocalPort();
+		socket->close();
+		return port;
+	}
+
+	Result runRudp(const Options &options, size_t size, size_t connections) {
+		if(size > ReliableUdpConnection::MAX_MESSAGE_SIZE) {
+			size = ReliableUdpConnection::MAX_MESSAGE_SIZE;
+		}
+		Result result("rudp", size, connections, RUDP_BACKLOG, -1);
+		uint64_t datagramsBefore = SocketStats::global().get(STAT_MESSAGES_SENT);
+		uint64_t dropsBefore = kernelReceiveDrops();
+
+		std::vector<RudpPair> pairs(connections);
+		for(RudpPair &pair : pairs) {
+			uint16_t senderPort = unusedUdpPort();
+			uint16_t receiverPort = unusedUdpPort();
+			pair.sender = ReliableUdpConnection::connect(senderPort, options.host, receiverPort);
+			pair.receiver = ReliableUdpConnection::connect(receiverPort, options.host, senderPort);
+			checkError(*pair.sender);
+			checkError(*pair.receiver);
+		}
+
+		std::vector<uint8_t> message(size, 0x5a);
+		uint64_t delivered = 0;
+		Phase phase(options);
+		while(phase.update(result)) {
+			bool progress = false;
+			for(RudpPair &pair : pairs) {
+				while(pair.sendTimes.size() < RUDP_BACKLOG) {
+					pair.sender->write(message.data(), size);
+					if(!pair.sender->send(0)) {
+						checkError(*pair.sender);
+						fail("Unable to queue a message");
+					}
+					pair.sendTimes.push_back(Clock::now());
+					progress = true;
+				}
+
+				while(pair.receiver->receive()) {
+					result.rttMicros.push_back(microsSince(pair.sendTimes.front()));
+					pair.sendTimes.pop_front();
+					++result.messages;
+					++delivered;
+					progress = true;
+				}
+				checkError(*pair.sender);
+				checkError(*pair.receiver);
+			}
+
+			if(!progress) {
+				std::this_thread::yield();
+			}
+		}
+
+		for(RudpPair &pair : pairs) {
+			pair.sender->close();
+			pair.receiver->close();
+		}
+
+		/*
+		 * Messages which are still outstanding when the run ends may have been
+		 * sent already, and each datagram dropped by the kernel is sent again,
+		 * which allows for that many more datagrams.
+		 */
+		uint64_t datagrams = SocketStats::global().get(STAT_MESSAGES_SENT) - datagramsBefore;
+		result.lost = kernelReceiveDrops() - dropsBefore;
+		uint64_t slack = connections * RUDP_BACKLOG + result.lost;
+		if(datagrams > RUDP_MAX_DATAGRAMS_PER_MESSAGE * delivered + slack) {
+			fprintf(stderr, "rudp: %llu datagrams for %llu messages\n", (unsigned long long) datagrams,
+					(unsigned long long) delivered);
+			fail("The sender retransmits messages which have arrived");
+		}
+		return result;
+	}
+
+	double percentile(const std::vector<double> &sorted, double fraction) {
+		if(sorted.empty()) {
+			return 0;
+		}
+		size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+
+	void printResult(const Options &options, Result &result, bool first) {
+		std::sort(result.rttMicros.begin(), result.rttMicros.end());
+		double messagesPerSecond = result.seconds > 0 ? result.messages / result.seconds : 0;
+		double megabytesPerSecond = messagesPerSecond * result.size / 1e6;
+		double p50 = percentile(result.rttMicros, 0.5);
+		double p99 = percentile(result.rttMicros, 0.99);
+		double p999 = percentile(result.rttMicros, 0.999);
+		const char *offload = (result.offload < 0) ? "-" : (result.offload ? "on" : "off");
+
+		if(options.json) {
+			printf("%s\n    {\"scenario\": \"%s\", \"host\": \"%s\", \"size\": %lu, \"connections\": %lu, "
+					"\"window\": %lu, \"offload\": \"%s\", \"seconds\": %.3f, \"messages\": %llu, \"lost\": %llu, "
+					"\"msgs_per_second\": %.1f, \"mb_per_second\": %.3f, "
+					"\"rtt_p50_us\": %.2f, \"rtt_p99_us\": %.2f, \"rtt_p999_us\": %.2f}",
+					first ? "" : ",", result.scenario.c_str(), options.host.c_str(),
+					(unsigned long) result.size, (unsigned long) result.connections, (unsigned long) result.window,
+					offload, result.seconds, (unsigned long long) result.messages, (unsigned long long) result.lost,
+					messagesPerSecond, megabytesPerSecond, p50, p99, p999);
+		} else {
+			if(first) {
+				printf("%-12s %7s %6s %6s %7s %12s %10s %10s %10s %10s %8s\n", "scenario", "size", "conns", "window",
+						"offload", "msgs/s", "MB/s", "p50 us", "p99 us", "p999 us", "lost");
+			}
+			printf("%-12s %7lu %6lu %6lu %7s %12.0f %10.2f %10.1f %10.1f %10.1f %8llu\n", result.scenario.c_str(),
+					(unsigned long) result.size, (unsigned long) result.connections, (unsigned long) result.window,
+					offload, messagesPerSecond, megabytesPerSecond, p50, p99, p999,
+					(unsigned long long) result.lost);
+		}
+		fflush(stdout);
+	}
+}
+
+int main(int argc, char **argv) {
+	Options options = parseOptions(argc, argv);
+	Asio::startup();
+
+	if(options.json) {
+		printf("{\"benchmarks\": [");
+	}
+
+	bool first = true;
+	if(options.tcpConnect) {
+		for(size_t connections : options.connections) {
+			Result result = runTcpConnect(options, connections);
+			printResult(options, result, first);
+			first = false;
+		}
+	}
+	if(options.tcp) {
+		for(size_t size : options.sizes) {
+			for(size_t connections : options.connections) {
+				for(size_t window : options.windows) {
+					Result result = runTcp(options, size, connections, window);
+					printResult(options, result, first);
+					first = false;
+				}
+			}
+		}
+	}
+	if(options.udp) {
+		for(size_t size : options.sizes) {
+			for(size_t connections : options.connections) {
+				for(size_t window : options.windows) {
+					for(size_t offload : options.offload) {
+						Result result = runUdp(options, size, connections, window, offload);
+						printResult(options, result, first);
+						first = false;
+					}
+				}
+			}
+		}
+	}
+	if(options.rudp) {
+		for(size_t size : options.sizes) {
+			for(size_t connections : options.connections) {
+				Result result = runRudp(options, size, connections);
+				printResult(options, result, first);
+				first = false;
+			}
+		}
+	}
+
+	if(options.json) {
+		printf("\n]}\n");
+	}
+
+	Asio::shutdown();
+	return 0;
+}
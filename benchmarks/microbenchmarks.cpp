@@ -0,0 +1,458 @@
+/*
+ * Microbenchmarks for the hot paths of the library, built on Google Benchmark.
+ *
+ * Run with --benchmark_format=json (or --benchmark_out=file.json) to get
+ * machine readable results which can be compared between builds.
+ */
+#include <faucet/Buffer.hpp>
+#include <faucet/HexCodec.hpp>
+#include <faucet/Base64Codec.hpp>
+#include <faucet/HandleMap.hpp>
+#include <faucet/Fallible.hpp>
+#include <faucet/tcp/SendBuffer.hpp>
+#include <faucet/udp/DatagramQueue.hpp>
+#include <faucet/DllExport.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/integer.hpp>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Exported functions of socketApi.cpp, called the same way the game calls them.
+ */
+DLLEXPORT double dllStartup();
+DLLEXPORT double dllShutdown();
+DLLEXPORT double buffer_create();
+DLLEXPORT double buffer_destroy(double handle);
+DLLEXPORT double buffer_clear(double handle);
+DLLEXPORT double buffer_size(double handle);
+DLLEXPORT double buffer_set_readpos(double handle, double newPos);
+DLLEXPORT double write_ubyte(double handle, double value);
+DLLEXPORT double write_int(double handle, double value);
+DLLEXPORT double write_double(double handle, double value);
+DLLEXPORT double read_ubyte(double handle);
+DLLEXPORT double read_int(double handle);
+DLLEXPORT double read_double(double handle);
+DLLEXPORT double _fnet_hidden_bytes_before_delimiter(double handle, const char *needle);
+DLLEXPORT double udp_bind(double port);
+DLLEXPORT double udp_receive(double handle);
+DLLEXPORT double socket_has_error(double handle);
+DLLEXPORT double socket_sendbuffer_size(double socketHandle);
+DLLEXPORT double socket_receivebuffer_size(double socketHandle);
+DLLEXPORT double socket_destroy(double handle);
+
+namespace {
+	/**
+	 * A string in the GM8 layout, with its length stored right before the characters.
+	 */
+	class GmString {
+	public:
+		explicit GmString(const std::string &str) : data_(sizeof(uint32_t) + str.size() + 1) {
+			uint32_t length = str.size();
+			memcpy(data_.data(), &length, sizeof(length));
+			memcpy(data_.data() + sizeof(length), str.c_str(), str.size() + 1);
+		}
+
+		const char *c_str() const {
+			return data_.data() + sizeof(uint32_t);
+		}
+
+	private:
+		std::vector<char> data_;
+	};
+
+	std::vector<uint8_t> randomBytes(size_t size) {
+		std::vector<uint8_t> bytes(size);
+		uint32_t state = 12345;
+		for(size_t i = 0; i < size; ++i) {
+			state = state * 1103515245 + 12345;
+			bytes[i] = static_cast<uint8_t>(state >> 16);
+		}
+		return bytes;
+	}
+
+	const size_t VALUES_PER_ITERATION = 1024;
+
+	/*
+	 * Buffer writes and reads, for every value type in both byte orders.
+	 * state.range(0) is 1 for little endian.
+	 */
+	template<typename IntType>
+	void BM_BufferWriteInt(benchmark::State &state) {
+		Buffer buffer;
+		buffer.setLittleEndian(state.range(0));
+		for(auto _ : state) {
+			buffer.clear();
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				buffer.writeIntValue<IntType>(static_cast<double>(i));
+			}
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+		state.SetBytesProcessed(state.iterations() * VALUES_PER_ITERATION * sizeof(IntType));
+	}
+
+	void BM_BufferWriteFloat(benchmark::State &state) {
+		Buffer buffer;
+		buffer.setLittleEndian(state.range(0));
+		for(auto _ : state) {
+			buffer.clear();
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				buffer.writeFloat(i * 0.5);
+			}
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+		state.SetBytesProcessed(state.iterations() * VALUES_PER_ITERATION * sizeof(float));
+	}
+
+	void BM_BufferWriteDouble(benchmark::State &state) {
+		Buffer buffer;
+		buffer.setLittleEndian(state.range(0));
+		for(auto _ : state) {
+			buffer.clear();
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				buffer.writeDouble(i * 0.5);
+			}
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+		state.SetBytesProcessed(state.iterations() * VALUES_PER_ITERATION * sizeof(double));
+	}
+
+	template<typename ValueType>
+	void BM_BufferRead(benchmark::State &state) {
+		Buffer buffer;
+		buffer.setLittleEndian(state.range(0));
+		std::vector<uint8_t> data = randomBytes(VALUES_PER_ITERATION * sizeof(ValueType));
+		buffer.write(data.data(), data.size());
+		for(auto _ : state) {
+			buffer.setReadpos(0);
+			double sum = 0;
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				sum += buffer.readValue<ValueType>();
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+		state.SetBytesProcessed(state.iterations() * VALUES_PER_ITERATION * sizeof(ValueType));
+	}
+
+	/*
+	 * Hex and Base64 encoding (read_hex, read_base64) and decoding
+	 * (write_hex, write_base64), state.range(0) is the size of the binary data.
+	 */
+	void BM_HexEncode(benchmark::State &state) {
+		static const HexCodec codec;
+		std::vector<uint8_t> data = randomBytes(state.range(0));
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(codec.readHex(data.data(), data.size()));
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+
+	void BM_HexDecode(benchmark::State &state) {
+		static const HexCodec codec;
+		std::vector<uint8_t> data = randomBytes(state.range(0));
+		std::string hex = codec.readHex(data.data(), data.size());
+		Buffer buffer;
+		for(auto _ : state) {
+			buffer.clear();
+			codec.writeHex(hex.c_str(), buffer);
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+
+	void BM_Base64Encode(benchmark::State &state) {
+		static const Base64Codec codec;
+		std::vector<uint8_t> data = randomBytes(state.range(0));
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(codec.readBase64(data.data(), data.size()));
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+
+	void BM_Base64Decode(benchmark::State &state) {
+		static const Base64Codec codec;
+		std::vector<uint8_t> data = randomBytes(state.range(0));
+		std::string base64 = codec.readBase64(data.data(), data.size());
+		Buffer buffer;
+		for(auto _ : state) {
+			buffer.clear();
+			codec.writeBase64(base64.c_str(), buffer);
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+	}
+
+	/*
+	 * HandleMap operations, with state.range(0) other handles already allocated.
+	 */
+	typedef HandleMap<Fallible, ReadWritable, Buffer> BenchmarkHandleMap;
+
+	void fillHandleMap(BenchmarkHandleMap &handles, size_t count) {
+		for(size_t i = 0; i < count; ++i) {
+			handles.allocate(std::make_shared<Buffer>());
+		}
+	}
+
+	void BM_HandleMapAllocateRelease(benchmark::State &state) {
+		BenchmarkHandleMap handles;
+		fillHandleMap(handles, state.range(0));
+		std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>();
+		for(auto _ : state) {
+			uint32_t handle = handles.allocate(buffer);
+			handles.release(handle);
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	void BM_HandleMapFind(benchmark::State &state) {
+		BenchmarkHandleMap handles;
+		fillHandleMap(handles, state.range(0));
+		uint32_t handle = handles.allocate(std::make_shared<Buffer>());
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(handles.find<ReadWritable>(handle));
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	void BM_HandleMapFindMissing(benchmark::State &state) {
+		BenchmarkHandleMap handles;
+		fillHandleMap(handles, state.range(0));
+		uint32_t handle = handles.allocate(std::make_shared<Buffer>());
+		handles.release(handle);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(handles.find<ReadWritable>(handle));
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	/*
+	 * SendBuffer as used by TcpSocket: push a message, commit and pop it once sent.
+	 * state.range(0) is the message size.
+	 */
+	void BM_SendBufferPushCommitPop(benchmark::State &state) {
+		SendBuffer sendBuffer;
+		std::vector<uint8_t> message = randomBytes(state.range(0));
+		for(auto _ : state) {
+			sendBuffer.push(message.data(), message.size());
+			sendBuffer.commit();
+			benchmark::DoNotOptimize(sendBuffer.committedAsConstBufferSequence());
+			sendBuffer.pop(message.size());
+		}
+		state.SetBytesProcessed(state.iterations() * message.size());
+	}
+
+	/*
+	 * A DatagramQueue held at its memory limit, so that every push drops an item
+	 * according to the policy in state.range(0). Datagrams come from state.range(1)
+	 * senders, in turn.
+	 */
+	void BM_DatagramQueueChurn(benchmark::State &state) {
+		DatagramQueue queue;
+		queue.setDropPolicy(static_cast<DropPolicy>(state.range(0)));
+		queue.setMemSizeLimit(256 * 1024);
+
+		std::vector<uint8_t> payload = randomBytes(512);
+		size_t senders = state.range(1);
+		size_t counter = 0;
+		auto nextItem = [&]() {
+			std::unique_ptr<Buffer> buffer(new Buffer());
+			buffer->write(payload.data(), payload.size());
+			boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), 10000 + counter % senders);
+			QueueItem item(std::move(buffer), endpoint);
+			item.priority = counter % 4;
+			++counter;
+			return item;
+		};
+
+		for(auto _ : state) {
+			queue.push(nextItem());
+			if(counter % 8 == 0) {
+				benchmark::DoNotOptimize(queue.take());
+			}
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	/*
+	 * Searching a buffer for a delimiter through the exported function, with
+	 * the delimiter at the end of state.range(0) bytes of data.
+	 */
+	void BM_DelimiterSearch(benchmark::State &state) {
+		double handle = buffer_create();
+		std::string data(state.range(0), 'a');
+		for(size_t i = 0; i < data.size(); i += 7) {
+			data[i] = '\r';
+		}
+		data += "\r\n";
+		for(size_t i = 0; i < data.size(); ++i) {
+			write_ubyte(handle, static_cast<uint8_t>(data[i]));
+		}
+		GmString delimiter("\r\n");
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(_fnet_hidden_bytes_before_delimiter(handle, delimiter.c_str()));
+		}
+		state.SetBytesProcessed(state.iterations() * data.size());
+		buffer_destroy(handle);
+	}
+
+	/*
+	 * The overhead of one exported function call, which includes the lock-free
+	 * handle lookup, compared to writing to a Buffer directly.
+	 */
+	void BM_ApiWriteUbyte(benchmark::State &state) {
+		double handle = buffer_create();
+		for(auto _ : state) {
+			buffer_clear(handle);
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				write_ubyte(handle, i);
+			}
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+		buffer_destroy(handle);
+	}
+
+	void BM_DirectWriteUbyte(benchmark::State &state) {
+		Buffer buffer;
+		for(auto _ : state) {
+			buffer.clear();
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				buffer.writeIntValue<uint8_t>(i);
+			}
+			benchmark::DoNotOptimize(buffer.getData());
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION);
+	}
+
+	void BM_ApiWriteReadInt(benchmark::State &state) {
+		double handle = buffer_create();
+		for(auto _ : state) {
+			buffer_clear(handle);
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				write_int(handle, i);
+			}
+			double sum = 0;
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				sum += read_int(handle);
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetItemsProcessed(state.iterations() * VALUES_PER_ITERATION * 2);
+		buffer_destroy(handle);
+	}
+
+	void BM_ApiBufferCreateDestroy(benchmark::State &state) {
+		for(auto _ : state) {
+			buffer_destroy(buffer_create());
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	void BM_ApiInvalidHandle(benchmark::State &state) {
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(buffer_size(0));
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+
+	/*
+	 * Exported function calls from several threads at once, each on its own
+	 * handles. Nothing is shared between the threads except the handle map,
+	 * so the throughput should scale with the number of cores.
+	 */
+	void BM_ApiThreadedBufferCalls(benchmark::State &state) {
+		double handle = buffer_create();
+		for(auto _ : state) {
+			buffer_clear(handle);
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				write_int(handle, i);
+			}
+			double sum = 0;
+			for(size_t i = 0; i < VALUES_PER_ITERATION; ++i) {
+				sum += read_int(handle);
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetItemsProcessed(state.iterations() * (VALUES_PER_ITERATION * 2 + 1));
+		buffer_destroy(handle);
+	}
+
+	/*
+	 * Socket calls which lock the socket against its IO thread, without
+	 * causing any network traffic.
+	 */
+	void BM_ApiThreadedSocketCalls(benchmark::State &state) {
+		double handle = udp_bind(0);
+		for(auto _ : state) {
+			benchmark::DoNotOptimize(socket_has_error(handle));
+			benchmark::DoNotOptimize(socket_sendbuffer_size(handle));
+			benchmark::DoNotOptimize(socket_receivebuffer_size(handle));
+			benchmark::DoNotOptimize(udp_receive(handle));
+		}
+		state.SetItemsProcessed(state.iterations() * 4);
+		socket_destroy(handle);
+	}
+}
+
+#define BENCHMARK_ENDIAN(...) BENCHMARK(__VA_ARGS__)->ArgName("little")->Arg(0)->Arg(1)
+
+BENCHMARK_ENDIAN(BM_BufferWriteInt<uint8_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteInt<int8_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteInt<uint16_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteInt<int16_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteInt<uint32_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteInt<int32_t>);
+BENCHMARK_ENDIAN(BM_BufferWriteFloat);
+BENCHMARK_ENDIAN(BM_BufferWriteDouble);
+BENCHMARK_ENDIAN(BM_BufferRead<uint8_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<int8_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<uint16_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<int16_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<uint32_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<int32_t>);
+BENCHMARK_ENDIAN(BM_BufferRead<float>);
+BENCHMARK_ENDIAN(BM_BufferRead<double>);
+
+BENCHMARK(BM_HexEncode)->Arg(16)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_HexDecode)->Arg(16)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_Base64Encode)->Arg(16)->Arg(1024)->Arg(65536);
+BENCHMARK(BM_Base64Decode)->Arg(16)->Arg(1024)->Arg(65536);
+
+BENCHMARK(BM_HandleMapAllocateRelease)->ArgName("live")->Arg(0)->Arg(10000);
+BENCHMARK(BM_HandleMapFind)->ArgName("live")->Arg(0)->Arg(10000);
+BENCHMARK(BM_HandleMapFindMissing)->ArgName("live")->Arg(0)->Arg(10000);
+
+BENCHMARK(BM_SendBufferPushCommitPop)->Arg(16)->Arg(1400)->Arg(65536)->Arg(1 << 20);
+
+BENCHMARK(BM_DatagramQueueChurn)->ArgNames({"policy", "senders"})
+		->Args({DROP_OLDEST, 16})->Args({DROP_NEWEST, 16})
+		->Args({DROP_FAIR, 16})->Args({DROP_FAIR, 1024})
+		->Args({DROP_PRIORITY, 16});
+
+BENCHMARK(BM_DelimiterSearch)->Arg(64)->Arg(4096)->Arg(65536);
+
+BENCHMARK(BM_ApiWriteUbyte);
+BENCHMARK(BM_DirectWriteUbyte);
+BENCHMARK(BM_ApiWriteReadInt);
+BENCHMARK(BM_ApiBufferCreateDestroy);
+BENCHMARK(BM_ApiInvalidHandle);
+BENCHMARK(BM_ApiThreadedBufferCalls)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ApiThreadedSocketCalls)->ThreadRange(1, 16)->UseRealTime();
+
+int main(int argc, char **argv) {
+	dllStartup();
+	benchmark::Initialize(&argc, argv);
+	if(benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	dllShutdown();
+	return 0;
+}
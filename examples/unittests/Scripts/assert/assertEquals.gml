@@ -1,3 +1,3 @@
-if(argument0 != argument1) {
-    show_message(string(argument2)+"#Expected: "+string(argument0) + "#Actual: " + string(argument1));
-}
+if(argument0 != argument1) {
+    show_message(string(argument2)+"#Expected: "+string(argument0) + "#Actual: " + string(argument1));
+}
@@ -1,3 +1,3 @@
-if(argument0) {
-    show_message(string(argument1)+"#Expected: false#Actual: true");
-}
+if(argument0) {
+    show_message(string(argument1)+"#Expected: false#Actual: true");
+}
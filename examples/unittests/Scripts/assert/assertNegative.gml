@@ -1,3 +1,3 @@
-if(argument0>=0) {
-    show_message(string(argument1)+"#Expected: negative#Actual: "+string(argument0));
-}
+if(argument0>=0) {
+    show_message(string(argument1)+"#Expected: negative#Actual: "+string(argument0));
+}
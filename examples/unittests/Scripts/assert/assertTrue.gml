@@ -1,3 +1,3 @@
-if(!argument0) {
-    show_message(string(argument1)+"#Expected: true#Actual: false");
-}
+if(!argument0) {
+    show_message(string(argument1)+"#Expected: true#Actual: false");
+}
@@ -1,7 +1,7 @@
-testBufferCreate();
-testBufferDestroy();
-testBufferClear();
-testBufferSize();
-testBufferBytesLeft();
-testBufferSetReadpos();
-testBufferReadWrite();
+testBufferCreate();
+testBufferDestroy();
+testBufferClear();
+testBufferSize();
+testBufferBytesLeft();
+testBufferSetReadpos();
+testBufferReadWrite();
@@ -1,2 +1,2 @@
-test_ip_is_v4();
-test_ip_is_v6();
+test_ip_is_v4();
+test_ip_is_v6();
@@ -1,40 +1,80 @@
-#include <faucet/Asio.hpp>
-#include <stdexcept>
-
-#include <boost/thread.hpp>
-
-void Asio::startup() {
-	if(ioService != 0) {
-		return;
-	}
-	ioService = new boost::asio::io_service();
-	work = new boost::asio::io_service::work(*ioService);
-	butler = new boost::thread([]{ioService->run();});
-}
-
-boost::asio::io_service &Asio::getIoService() {
-	if(ioService == 0) {
-		throw std::runtime_error("Attempted to access io_service before startup or after shutdown.");
-	}
-	return *ioService;
-}
-
-void Asio::shutdown() {
-	if(ioService == 0) {
-		return;
-	}
-	delete work;
-
-	ioService->stop();
-	butler->join();
-	delete butler;
-	delete ioService;
-
-	work = 0;
-	butler = 0;
-	ioService = 0;
-}
-
-boost::asio::io_service *Asio::ioService = 0;
-boost::asio::io_service::work *Asio::work = 0;
-boost::thread *Asio::butler = 0;
+#include <faucet/Asio.hpp>
+#include <faucet/Trace.hpp>
+#include <stdexcept>
+
+#include <boost/thread.hpp>
+
+namespace {
+	boost::mutex shardMutex;
+}
+
+void Asio::startup() {
+	if(ioService != 0) {
+		return;
+	}
+	ioService = new boost::asio::io_service();
+	work = new boost::asio::io_service::work(*ioService);
+	butler = new boost::thread([]{
+		FCT_TRACE_THREAD_NAME("io");
+		ioService->run();
+	});
+}
+
+boost::asio::io_service &Asio::getIoService() {
+	if(ioService == 0) {
+		throw std::runtime_error("Attempted to access io_service before startup or after shutdown.");
+	}
+	return *ioService;
+}
+
+boost::asio::io_service &Asio::getShardIoService(size_t index) {
+	if(ioService == 0) {
+		throw std::runtime_error("Attempted to access io_service before startup or after shutdown.");
+	}
+
+	boost::lock_guard<boost::mutex> guard(shardMutex);
+	index %= MAX_SHARDS;
+	while(shards.size() <= index) {
+		Shard shard;
+		shard.ioService = new boost::asio::io_service();
+		shard.work = new boost::asio::io_service::work(*shard.ioService);
+		boost::asio::io_service *shardService = shard.ioService;
+		shard.thread = new boost::thread([shardService]{
+			FCT_TRACE_THREAD_NAME("io shard");
+			shardService->run();
+		});
+		shards.push_back(shard);
+	}
+	return *shards[index].ioService;
+}
+
+void Asio::shutdown() {
+	if(ioService == 0) {
+		return;
+	}
+	delete work;
+
+	ioService->stop();
+	butler->join();
+	delete butler;
+	delete ioService;
+
+	work = 0;
+	butler = 0;
+	ioService = 0;
+
+	boost::lock_guard<boost::mutex> guard(shardMutex);
+	for(Shard &shard : shards) {
+		delete shard.work;
+		shard.ioService->stop();
+		shard.thread->join();
+		delete shard.thread;
+		delete shard.ioService;
+	}
+	shards.clear();
+}
+
+boost::asio::io_service *Asio::ioService = 0;
+boost::asio::io_service::work *Asio::work = 0;
+boost::thread *Asio::butler = 0;
+std::vector<Asio::Shard> Asio::shards;
@@ -1,17 +1,39 @@
-#pragma once
-#include <boost/asio.hpp>
-
-namespace boost {
-	class thread;
-}
-
-class Asio {
-public:
-	static void startup();
-	static boost::asio::io_service &getIoService();
-	static void shutdown();
-private:
-	static boost::asio::io_service *ioService;
-	static boost::asio::io_service::work *work;
-	static boost::thread *butler;
-};
+#pragma once
+#include <boost/asio.hpp>
+#include <vector>
+
+namespace boost {
+	class thread;
+}
+
+class Asio {
+public:
+	/**
+	 * Maximum number of additional IO threads that can be requested
+	 * with getShardIoService().
+	 */
+	static const size_t MAX_SHARDS = 16;
+
+	static void startup();
+	static boost::asio::io_service &getIoService();
+
+	/**
+	 * Return the io_service of the additional IO thread with the given index
+	 * (modulo MAX_SHARDS), starting the thread if it isn't running yet.
+	 * Objects created on these io_services have all their handlers run on that
+	 * thread, so work can be spread over several threads by distributing objects.
+	 */
+	static boost::asio::io_service &getShardIoService(size_t index);
+	static void shutdown();
+private:
+	struct Shard {
+		boost::asio::io_service *ioService;
+		boost::asio::io_service::work *work;
+		boost::thread *thread;
+	};
+
+	static boost::asio::io_service *ioService;
+	static boost::asio::io_service::work *work;
+	static boost::thread *butler;
+	static std::vector<Shard> shards;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+/*
+ * Marks a function as part of the exported C API of the library.
+ */
+#ifdef _WIN32
+#define DLLEXPORT extern "C" __declspec(dllexport)
+#else
+#define DLLEXPORT extern "C" __attribute__((visibility("default")))
+#endif
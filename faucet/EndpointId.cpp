@@ -0,0 +1,54 @@
+#include "EndpointId.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <map>
+
+using namespace boost::asio::ip;
+
+namespace {
+	const uint64_t FIRST_V6_ENDPOINT_ID = static_cast<uint64_t>(1) << 48;
+
+	/**
+	 * Every datagram from a new IPv6 sender asks for an id, so the ids are kept
+	 * in two generations: When the current one is full, it replaces the previous
+	 * one, and ids which are still in use are moved back from there on lookup.
+	 */
+	const size_t V6_ENDPOINT_GENERATION_SIZE = 32768;
+
+	typedef std::map<std::pair<address_v6, uint16_t>, uint64_t> V6EndpointIds;
+
+	boost::mutex v6EndpointIdsMutex;
+	V6EndpointIds currentV6EndpointIds;
+	V6EndpointIds previousV6EndpointIds;
+	uint64_t nextV6EndpointId = FIRST_V6_ENDPOINT_ID;
+}
+
+uint64_t getEndpointId(const address &address, uint16_t port) {
+	if(address.is_v4()) {
+		return (static_cast<uint64_t>(address.to_v4().to_ulong()) << 16) | port;
+	}
+
+	boost::lock_guard<boost::mutex> guard(v6EndpointIdsMutex);
+	auto key = std::make_pair(address.to_v6(), port);
+	auto entry = currentV6EndpointIds.find(key);
+	if(entry != currentV6EndpointIds.end()) {
+		return entry->second;
+	}
+
+	uint64_t id;
+	entry = previousV6EndpointIds.find(key);
+	if(entry != previousV6EndpointIds.end()) {
+		id = entry->second;
+		previousV6EndpointIds.erase(entry);
+	} else {
+		id = nextV6EndpointId++;
+	}
+
+	if(currentV6EndpointIds.size() >= V6_ENDPOINT_GENERATION_SIZE) {
+		previousV6EndpointIds.swap(currentV6EndpointIds);
+		currentV6EndpointIds.clear();
+	}
+	currentV6EndpointIds[key] = id;
+	return id;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <faucet/Asio.hpp>
+
+#include <boost/integer.hpp>
+
+/**
+ * Return a number which identifies the given remote address and port, so that
+ * the game can tell peers apart without comparing IP strings.
+ *
+ * IPv4 endpoints map directly to (address << 16 | port), which fits into the
+ * 53 bits a double can represent exactly. IPv6 endpoints are numbered in order
+ * of first appearance, starting above that range. Numbers are never reused, and
+ * an endpoint keeps its number as long as it has been seen among at least the last
+ * 32768 distinct IPv6 endpoints. After that, it is forgotten and gets a new number
+ * when it shows up again.
+ */
+uint64_t getEndpointId(const boost::asio::ip::address &address, uint16_t port);
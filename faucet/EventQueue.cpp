@@ -0,0 +1,107 @@
+#include "EventQueue.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <deque>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace {
+	typedef std::pair<std::weak_ptr<Handled>, EventType> Event;
+
+	struct EventOrder {
+		bool operator()(const Event &a, const Event &b) const {
+			std::owner_less<std::weak_ptr<Handled>> sourceOrder;
+			if(sourceOrder(a.first, b.first)) {
+				return true;
+			} else if(sourceOrder(b.first, a.first)) {
+				return false;
+			} else {
+				return a.second < b.second;
+			}
+		}
+	};
+
+	std::atomic<bool> enabled(false);
+	boost::mutex queueMutex;
+	boost::condition_variable queueCondition;
+	std::deque<Event> queue;
+	std::set<Event, EventOrder> pending;
+}
+
+void EventQueue::setEnabled(bool enable) {
+	enabled = enable;
+	if(!enable) {
+		clear();
+	}
+}
+
+bool EventQueue::isEnabled() {
+	return enabled;
+}
+
+void EventQueue::push(std::weak_ptr<Handled> source, EventType type) {
+	if(!enabled) {
+		return;
+	}
+
+	boost::lock_guard<boost::mutex> guard(queueMutex);
+	Event event(source, type);
+	if(pending.insert(event).second) {
+		queue.push_back(event);
+		queueCondition.notify_all();
+	}
+}
+
+EventType EventQueue::pop(uint32_t &handle) {
+	/*
+	 * Declared before the lock, in case we hold the last reference to a source.
+	 * Its destructor might push an event, so it must only run after unlocking.
+	 */
+	std::vector<std::shared_ptr<Handled> > discarded;
+	boost::lock_guard<boost::mutex> guard(queueMutex);
+	while(!queue.empty()) {
+		Event event = queue.front();
+		queue.pop_front();
+		pending.erase(event);
+
+		std::shared_ptr<Handled> source = event.first.lock();
+		if(source && source->getHandle() != 0) {
+			handle = source->getHandle();
+			discarded.push_back(std::move(source));
+			return event.second;
+		}
+		if(source) {
+			discarded.push_back(std::move(source));
+		}
+	}
+
+	handle = 0;
+	return EVENT_NONE;
+}
+
+size_t EventQueue::size() {
+	boost::lock_guard<boost::mutex> guard(queueMutex);
+	return queue.size();
+}
+
+size_t EventQueue::wait(uint32_t timeoutMillis) {
+	boost::unique_lock<boost::mutex> lock(queueMutex);
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeoutMillis);
+	while(queue.empty()) {
+		if(!queueCondition.timed_wait(lock, deadline)) {
+			break;
+		}
+	}
+	return queue.size();
+}
+
+void EventQueue::clear() {
+	std::deque<Event> cleared;
+	boost::lock_guard<boost::mutex> guard(queueMutex);
+	cleared.swap(queue);
+	pending.clear();
+}
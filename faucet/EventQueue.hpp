@@ -0,0 +1,56 @@
+#pragma once
+
+#include <faucet/Handled.hpp>
+
+#include <boost/integer.hpp>
+#include <memory>
+
+/**
+ * The event types reported by event_next(). The values are part of the API.
+ */
+enum EventType {
+	EVENT_NONE = 0,
+	EVENT_READABLE = 1,
+	EVENT_FRAME_READY = 2,
+	EVENT_ACCEPTED = 3,
+	EVENT_CONNECTED = 4,
+	EVENT_ERROR = 5,
+	EVENT_EOF = 6,
+	EVENT_LOOKUP_DONE = 7,
+	EVENT_SENDBUFFER_EMPTY = 8
+};
+
+/**
+ * A process-wide queue of events reported by the IO thread, so that the game
+ * can find out what happened without polling every handle.
+ *
+ * Events refer to their source object with a weak pointer, and the handle is
+ * only determined when the event is taken from the queue. Events of objects that
+ * have no handle (anymore) at that point are dropped. An event is only queued
+ * once until it is taken, so the queue cannot grow beyond a few events per object.
+ *
+ * The queue is disabled by default, in which case push() does nothing.
+ */
+class EventQueue {
+public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	static void push(std::weak_ptr<Handled> source, EventType type);
+
+	/**
+	 * Take the next event from the queue and return its type, or EVENT_NONE
+	 * if the queue is empty. The handle of the source object is stored in handle.
+	 */
+	static EventType pop(uint32_t &handle);
+
+	static size_t size();
+
+	/**
+	 * Block until an event is available or the timeout has passed.
+	 * Returns the number of queued events.
+	 */
+	static size_t wait(uint32_t timeoutMillis);
+
+	static void clear();
+};
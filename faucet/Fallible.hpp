@@ -1,12 +1,12 @@
-#pragma once
-
-#include <faucet/Handled.hpp>
-#include <string>
-
-class Fallible : public Handled {
-public:
-	virtual ~Fallible() {}
-
-	virtual bool hasError() = 0;
-	virtual std::string getErrorMessage() = 0;
-};
+#pragma once
+
+#include <faucet/Handled.hpp>
+#include <string>
+
+class Fallible : public Handled {
+public:
+	virtual ~Fallible() {}
+
+	virtual bool hasError() = 0;
+	virtual std::string getErrorMessage() = 0;
+};
@@ -1,103 +1,379 @@
-#pragma once
-
-#include <faucet/Handled.hpp>
-
-#include <map>
-#include <boost/integer.hpp>
-#include <boost/cast.hpp>
-
-using boost::numeric_cast;
-using boost::numeric::bad_numeric_cast;
-
-/**
- * Provides unique handles to objects and allows access by that handle.
- * The objects must extend the "Handled" class. Objects are handled and
- * stored as shared_ptr references to allow flexible lifecycle management.
- *
- * The handle 0 is never used, so that valid handles always evaluate to
- * true in Game Maker.
- */
-class HandleMap {
-	typedef std::shared_ptr<Handled> HandledPtr;
-public:
-	HandleMap() : nextHandle_(1), content_() {}
-
-	/**
-	 * Associate the element with a unique handle, which is returned.
-	 */
-	uint32_t allocate(HandledPtr element) {
-		while(content_.count(nextHandle_) > 0 || nextHandle_ == 0) {
-			nextHandle_++;
-		}
-		content_[nextHandle_] = element;
-		return nextHandle_++;
-	}
-
-	/**
-	 * Return the element associated with the given handle, or a NULL pointer
-	 * if this Manager does not hold an object with the given handle and of
-	 * the requested type.
-	 *
-	 * Note that you will also get NULL as result if the given handle has
-	 * previously been associated with NULL.
-	 */
-	template<typename RequestedType>
-	std::shared_ptr<RequestedType> find(uint32_t handle) {
-		auto iter = content_.find(handle);
-		if(iter == content_.end()) {
-			return nullptr;
-		} else {
-			return std::dynamic_pointer_cast<RequestedType>(iter->second);
-		}
-	}
-
-	/**
-	 * Convenience method for use from the Game Maker API which uses double for all numbers.
-	 * Returns a NULL pointer if the double value cannot be represented as uint32_t.
-	 */
-	template<typename RequestedType>
-	std::shared_ptr<RequestedType> find(double handle) {
-		if(trunc(handle) != handle) {
-			return std::shared_ptr<RequestedType>();
-		}
-		try {
-			return find<RequestedType>(numeric_cast<uint32_t>(handle));
-		} catch(bad_numeric_cast &e) {
-			return nullptr;
-		}
-	}
-
-	/**
-	 * Release the handle-element association.
-	 */
-	void release(uint32_t handle) {
-		content_.erase(handle);
-	}
-
-	/**
-	 * Convenience method for use from the Game Maker API which uses double for all numbers.
-	 * Does nothing if the double value cannot be represented as uint32_t
-	 */
-	void release(double handle) {
-		if(trunc(handle) != handle) {
-			return;
-		}
-		try {
-			release(numeric_cast<uint32_t>(handle));
-			return;
-		} catch(bad_numeric_cast &e) {
-			return;
-		}
-	}
-
-	void releaseAll() {
-		content_.clear();
-	}
-
-	uint32_t size() {
-		return content_.size();
-	}
-private:
-	uint32_t nextHandle_;
-	std::map<uint32_t, HandledPtr> content_;
-};
+#pragma once
+
+#include <faucet/Handled.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <limits>
+#include <type_traits>
+
+namespace handlemap_detail {
+	typedef void *(*CastFunction)(Handled *);
+
+	template<typename Requested, typename... Types>
+	struct TypeIndex;
+
+	template<typename Requested, typename... Rest>
+	struct TypeIndex<Requested, Requested, Rest...> {
+		static const uint32_t value = 0;
+	};
+
+	template<typename Requested, typename First, typename... Rest>
+	struct TypeIndex<Requested, First, Rest...> {
+		static const uint32_t value = 1 + TypeIndex<Requested, Rest...>::value;
+	};
+
+	/**
+	 * Bit i of the mask is set if Concrete can be used as the i-th type of the list.
+	 */
+	template<typename Concrete, typename... Types>
+	struct TypeMask;
+
+	template<typename Concrete>
+	struct TypeMask<Concrete> {
+		static const uint32_t value = 0;
+	};
+
+	template<typename Concrete, typename First, typename... Rest>
+	struct TypeMask<Concrete, First, Rest...> {
+		static const uint32_t value = (std::is_base_of<First, Concrete>::value ? 1 : 0)
+				| (TypeMask<Concrete, Rest...>::value << 1);
+	};
+
+	template<typename Concrete, typename Target>
+	void *castHandled(Handled *object) {
+		return static_cast<Target *>(static_cast<Concrete *>(object));
+	}
+
+	template<typename Concrete, typename Target>
+	CastFunction castFunction(std::true_type) {
+		return &castHandled<Concrete, Target>;
+	}
+
+	template<typename Concrete, typename Target>
+	CastFunction castFunction(std::false_type) {
+		return nullptr;
+	}
+}
+
+/**
+ * Provides unique handles to objects and allows access by that handle.
+ * The objects must extend the "Handled" class. Objects are handled and
+ * stored as shared_ptr references to allow flexible lifecycle management.
+ *
+ * The handle 0 is never used, so that valid handles always evaluate to
+ * true in Game Maker.
+ *
+ * Handles are indices into a slot array, combined with a generation counter
+ * in the upper bits, so a lookup is an index and a compare. The template
+ * parameters list all types that objects can be requested as. Each slot
+ * carries a bit mask of these types along with the casts to them, which are
+ * determined from the static type of the object when it is allocated.
+ *
+ * All methods are thread safe. Lookups return a shared_ptr which keeps the
+ * object alive, so it can still be used after another thread has released
+ * its handle in the meantime.
+ *
+ * Lookups don't take any lock. Each slot has an atomic state holding the
+ * generation, whether the slot is in use, and the number of readers which
+ * are copying its shared_ptr. A reader only enters a slot in use with the
+ * expected generation. Releasing a slot first marks it unused and then waits
+ * for the readers already inside, so the owner is never reset under them.
+ * Slots are allocated in chunks which stay in place until the map is
+ * destroyed, so readers never see the slot storage move. Allocation and
+ * release are serialized by a mutex.
+ */
+template<typename... Types>
+class HandleMap {
+	typedef std::shared_ptr<Handled> HandledPtr;
+	typedef boost::lock_guard<boost::mutex> MapLock;
+	typedef handlemap_detail::CastFunction CastFunction;
+
+	static_assert(sizeof...(Types) <= 32, "The type mask only has room for 32 types");
+
+	static const uint32_t INDEX_BITS = 20;
+	static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const uint32_t GENERATION_MASK = std::numeric_limits<uint32_t>::max() >> INDEX_BITS;
+
+	/*
+	 * Layout of the slot state. The generation uses the same bits as in the
+	 * handle, below it are the in-use flag and the reader count.
+	 */
+	static const uint32_t STATE_IN_USE = 1u << (INDEX_BITS - 1);
+	static const uint32_t STATE_READER_MASK = STATE_IN_USE - 1;
+
+	static const uint32_t CHUNK_BITS = 10;
+	static const uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+	static const uint32_t CHUNK_COUNT = (INDEX_MASK + 1) / CHUNK_SIZE;
+
+	/**
+	 * Freed slots are only reused once this many are waiting, so that a
+	 * stale handle will not refer to a new object for a long time.
+	 */
+	static const size_t MIN_FREE_SLOTS = 1024;
+
+	/*
+	 * The other fields are only written while the slot is not in use and
+	 * has no readers, and published by the release store of the state.
+	 */
+	struct Slot {
+		Slot() : state(0), typeMask(0), casts(0), owner() {}
+
+		std::atomic<uint32_t> state;
+		uint32_t typeMask;
+		const CastFunction *casts;
+		HandledPtr owner;
+	};
+
+public:
+	/**
+	 * The result of a single lookup, which can be checked for several types.
+	 */
+	class Entry {
+	public:
+		Entry() : typeMask_(0), casts_(0), owner_() {}
+		Entry(const Slot &slot) : typeMask_(slot.typeMask), casts_(slot.casts), owner_(slot.owner) {}
+
+		/**
+		 * The returned pointer shares ownership of the object.
+		 */
+		template<typename RequestedType>
+		std::shared_ptr<RequestedType> as() const {
+			const uint32_t typeIndex = handlemap_detail::TypeIndex<RequestedType, Types...>::value;
+			if(typeMask_ & (1u << typeIndex)) {
+				return std::shared_ptr<RequestedType>(owner_,
+						static_cast<RequestedType *>(casts_[typeIndex](owner_.get())));
+			} else {
+				return std::shared_ptr<RequestedType>();
+			}
+		}
+
+	private:
+		uint32_t typeMask_;
+		const CastFunction *casts_;
+		HandledPtr owner_;
+	};
+
+	HandleMap() : mutex_(), slotCount_(1), freeSlots_(), size_(0) {
+		for(uint32_t i = 0; i < CHUNK_COUNT; ++i) {
+			chunks_[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~HandleMap() {
+		for(uint32_t i = 0; i < CHUNK_COUNT; ++i) {
+			delete[] chunks_[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * Associate the element with a unique handle, which is returned.
+	 * Returns 0 if all handles are in use.
+	 */
+	template<typename Concrete>
+	uint32_t allocate(std::shared_ptr<Concrete> element) {
+		static const CastFunction casts[] = {
+				handlemap_detail::castFunction<Concrete, Types>(std::is_base_of<Types, Concrete>())...
+		};
+
+		MapLock lock(mutex_);
+		uint32_t index;
+		uint32_t slotCount = slotCount_.load(std::memory_order_relaxed);
+		if(freeSlots_.size() > MIN_FREE_SLOTS) {
+			index = freeSlots_.front();
+			freeSlots_.pop_front();
+		} else if(slotCount <= INDEX_MASK) {
+			index = slotCount;
+			if(!chunks_[index >> CHUNK_BITS].load(std::memory_order_relaxed)) {
+				chunks_[index >> CHUNK_BITS].store(new Slot[CHUNK_SIZE], std::memory_order_relaxed);
+			}
+			// Publishes the new chunk along with the slot count
+			slotCount_.store(slotCount + 1, std::memory_order_release);
+		} else if(!freeSlots_.empty()) {
+			index = freeSlots_.front();
+			freeSlots_.pop_front();
+		} else {
+			return 0;
+		}
+
+		Slot &slot = slotAt(index);
+		uint32_t handle = (slot.state.load(std::memory_order_relaxed) & ~INDEX_MASK) | index;
+		element->setHandle(handle);
+		slot.typeMask = handlemap_detail::TypeMask<Concrete, Types...>::value;
+		slot.casts = casts;
+		slot.owner = std::move(element);
+		slot.state.store((handle & ~INDEX_MASK) | STATE_IN_USE, std::memory_order_release);
+		++size_;
+		return handle;
+	}
+
+	/**
+	 * Look up the given handle. The returned entry is empty if the handle
+	 * is not associated with an object.
+	 */
+	Entry lookup(uint32_t handle) {
+		uint32_t index = handle & INDEX_MASK;
+		if(index == 0 || index >= slotCount_.load(std::memory_order_acquire)) {
+			return Entry();
+		}
+
+		Slot &slot = slotAt(index);
+		uint32_t expected = (handle & ~INDEX_MASK) | STATE_IN_USE;
+		uint32_t state = slot.state.load(std::memory_order_relaxed);
+		do {
+			if((state & ~STATE_READER_MASK) != expected) {
+				return Entry();
+			}
+		} while(!slot.state.compare_exchange_weak(state, state + 1,
+				std::memory_order_acquire, std::memory_order_relaxed));
+
+		Entry entry(slot);
+		slot.state.fetch_sub(1, std::memory_order_release);
+		return entry;
+	}
+
+	/**
+	 * Convenience method for use from the Game Maker API which uses double for all numbers.
+	 * Returns an empty entry if the double value cannot be represented as uint32_t.
+	 */
+	Entry lookup(double handle) {
+		uint32_t intHandle;
+		if(toHandle(handle, intHandle)) {
+			return lookup(intHandle);
+		} else {
+			return Entry();
+		}
+	}
+
+	/**
+	 * Return the element associated with the given handle, or a NULL pointer
+	 * if this Manager does not hold an object with the given handle and of
+	 * the requested type.
+	 */
+	template<typename RequestedType>
+	std::shared_ptr<RequestedType> find(uint32_t handle) {
+		return lookup(handle).template as<RequestedType>();
+	}
+
+	template<typename RequestedType>
+	std::shared_ptr<RequestedType> find(double handle) {
+		return lookup(handle).template as<RequestedType>();
+	}
+
+	/**
+	 * Release the handle-element association.
+	 */
+	void release(uint32_t handle) {
+		uint32_t index = handle & INDEX_MASK;
+
+		HandledPtr released;
+		MapLock lock(mutex_);
+		if(index != 0 && index < slotCount_.load(std::memory_order_relaxed) && isHandleInUse(handle)) {
+			// The object is destroyed after the lock is released
+			released = releaseSlot(index);
+		}
+	}
+
+	/**
+	 * Convenience method for use from the Game Maker API which uses double for all numbers.
+	 * Does nothing if the double value cannot be represented as uint32_t
+	 */
+	void release(double handle) {
+		uint32_t intHandle;
+		if(toHandle(handle, intHandle)) {
+			release(intHandle);
+		}
+	}
+
+	void releaseAll() {
+		std::vector<HandledPtr> released;
+		MapLock lock(mutex_);
+		uint32_t slotCount = slotCount_.load(std::memory_order_relaxed);
+		for(uint32_t index = 1; index < slotCount; ++index) {
+			if(slotAt(index).state.load(std::memory_order_relaxed) & STATE_IN_USE) {
+				released.push_back(releaseSlot(index));
+			}
+		}
+	}
+
+	uint32_t size() {
+		MapLock lock(mutex_);
+		return size_;
+	}
+
+	/**
+	 * Call function(handle, element) for every element of the requested type.
+	 * The map is locked during the calls, so the function must not use it.
+	 */
+	template<typename RequestedType, typename Function>
+	void forEach(Function function) {
+		MapLock lock(mutex_);
+		uint32_t slotCount = slotCount_.load(std::memory_order_relaxed);
+		for(uint32_t index = 1; index < slotCount; ++index) {
+			Slot &slot = slotAt(index);
+			uint32_t state = slot.state.load(std::memory_order_relaxed);
+			if(state & STATE_IN_USE) {
+				std::shared_ptr<RequestedType> element = Entry(slot).template as<RequestedType>();
+				if(element) {
+					function((state & ~INDEX_MASK) | index, element.get());
+				}
+			}
+		}
+	}
+
+private:
+	boost::mutex mutex_;
+	std::atomic<Slot *> chunks_[CHUNK_COUNT];
+	std::atomic<uint32_t> slotCount_;
+	std::deque<uint32_t> freeSlots_;
+	uint32_t size_;
+
+	static bool toHandle(double handle, uint32_t &result) {
+		if(!(handle >= 0 && handle <= std::numeric_limits<uint32_t>::max())) {
+			return false;
+		}
+		result = static_cast<uint32_t>(handle);
+		return result == handle;
+	}
+
+	Slot &slotAt(uint32_t index) {
+		return chunks_[index >> CHUNK_BITS].load(std::memory_order_relaxed)[index & (CHUNK_SIZE - 1)];
+	}
+
+	/**
+	 * The mutex must be locked and the index must be valid.
+	 */
+	bool isHandleInUse(uint32_t handle) {
+		uint32_t state = slotAt(handle & INDEX_MASK).state.load(std::memory_order_relaxed);
+		return (state & ~STATE_READER_MASK) == ((handle & ~INDEX_MASK) | STATE_IN_USE);
+	}
+
+	/**
+	 * The mutex must be locked. New readers are turned away once the slot
+	 * is no longer in use, and the ones already inside only copy the owner,
+	 * so the wait for them is short.
+	 */
+	HandledPtr releaseSlot(uint32_t index) {
+		Slot &slot = slotAt(index);
+		uint32_t state = slot.state.fetch_and(~STATE_IN_USE, std::memory_order_relaxed);
+		while(slot.state.load(std::memory_order_acquire) & STATE_READER_MASK) {
+			boost::this_thread::yield();
+		}
+
+		HandledPtr owner = std::move(slot.owner);
+		owner->setHandle(0);
+		slot.typeMask = 0;
+		slot.casts = 0;
+		uint32_t generation = ((state >> INDEX_BITS) + 1) & GENERATION_MASK;
+		slot.state.store(generation << INDEX_BITS, std::memory_order_relaxed);
+		freeSlots_.push_back(index);
+		--size_;
+		return owner;
+	}
+};
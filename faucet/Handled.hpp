@@ -1,6 +1,25 @@
-#pragma once
-
-class Handled {
-public:
-	virtual ~Handled() {}
-};
+#pragma once
+
+#include <boost/integer.hpp>
+#include <atomic>
+
+class Handled {
+public:
+	Handled() : handle_(0) {}
+	virtual ~Handled() {}
+
+	/**
+	 * The handle this object is currently registered under, or 0 if it
+	 * has none. This is maintained by the HandleMap.
+	 */
+	uint32_t getHandle() const {
+		return handle_;
+	}
+
+	void setHandle(uint32_t handle) {
+		handle_ = handle;
+	}
+
+private:
+	std::atomic<uint32_t> handle_;
+};
@@ -0,0 +1,89 @@
+#include "LatencyHistogram.hpp"
+
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram() {
+	for(size_t i = 0; i < BUCKET_COUNT; ++i) {
+		buckets_[i].store(0, std::memory_order_relaxed);
+	}
+	count_.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(LatencyClock::time_point start, LatencyClock::time_point end) {
+	if(end < start) {
+		return;
+	}
+	recordMicros(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+}
+
+void LatencyHistogram::recordMicros(uint64_t micros) {
+	buckets_[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const {
+	return count_.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::add(const LatencyHistogram &other) {
+	for(size_t i = 0; i < BUCKET_COUNT; ++i) {
+		buckets_[i].fetch_add(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	count_.fetch_add(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const {
+	uint64_t count = getCount();
+	if(count == 0) {
+		return 0;
+	}
+
+	if(percentile < 0) {
+		percentile = 0;
+	} else if(percentile > 100) {
+		percentile = 100;
+	}
+	uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100 * count));
+	if(rank == 0) {
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for(size_t i = 0; i < BUCKET_COUNT; ++i) {
+		seen += buckets_[i].load(std::memory_order_relaxed);
+		if(seen >= rank) {
+			return bucketMaxValue(i);
+		}
+	}
+
+	// Recorded concurrently with this call, the buckets may not add up to the count yet
+	return bucketMaxValue(BUCKET_COUNT - 1);
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t micros) {
+	if(micros < SUB_BUCKETS) {
+		return static_cast<size_t>(micros);
+	}
+
+	unsigned int magnitude = SUB_BUCKET_BITS;
+	while(magnitude + 1 < MAX_VALUE_BITS && (micros >> (magnitude + 1)) != 0) {
+		++magnitude;
+	}
+	if((micros >> (magnitude + 1)) != 0) {
+		return BUCKET_COUNT - 1;
+	}
+
+	unsigned int shift = magnitude - SUB_BUCKET_BITS;
+	size_t subBucket = static_cast<size_t>((micros >> shift) - SUB_BUCKETS);
+	return SUB_BUCKETS * (shift + 1) + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketMaxValue(size_t index) {
+	if(index < SUB_BUCKETS) {
+		return index;
+	}
+
+	unsigned int shift = static_cast<unsigned int>(index / SUB_BUCKETS - 1);
+	uint64_t subBucket = index % SUB_BUCKETS;
+	return ((SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
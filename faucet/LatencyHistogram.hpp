@@ -0,0 +1,50 @@
+#pragma once
+
+#include <boost/integer.hpp>
+#include <boost/utility.hpp>
+#include <atomic>
+#include <chrono>
+
+typedef std::chrono::steady_clock LatencyClock;
+
+/**
+ * A histogram of durations in microseconds with log-linear buckets, like an
+ * HDR histogram: durations below 8us have a bucket each, and each power of two
+ * above that is split into 8 buckets, so the error of a reported value is at
+ * most 12.5%. Durations of more than about 71 minutes are counted as that.
+ *
+ * Recording uses relaxed atomics, so it can happen on any thread while another
+ * thread reads percentiles.
+ */
+class LatencyHistogram : boost::noncopyable {
+public:
+	LatencyHistogram();
+
+	void record(LatencyClock::time_point start, LatencyClock::time_point end);
+	void recordMicros(uint64_t micros);
+
+	uint64_t getCount() const;
+
+	/**
+	 * Add the recorded durations of the other histogram to this one.
+	 */
+	void add(const LatencyHistogram &other);
+
+	/**
+	 * The duration in microseconds which the given percentage (0-100) of
+	 * recorded durations did not exceed, or 0 if nothing was recorded.
+	 */
+	uint64_t getPercentile(double percentile) const;
+
+private:
+	static const unsigned int SUB_BUCKET_BITS = 3;
+	static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const unsigned int MAX_VALUE_BITS = 32;
+	static const size_t BUCKET_COUNT = SUB_BUCKETS * (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+	static size_t bucketIndex(uint64_t micros);
+	static uint64_t bucketMaxValue(size_t index);
+
+	std::atomic<uint64_t> buckets_[BUCKET_COUNT];
+	std::atomic<uint64_t> count_;
+};
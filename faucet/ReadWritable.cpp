@@ -1,3 +1,3 @@
-#include "ReadWritable.hpp"
-
-bool ReadWritable::littleEndianDefault_ = false;
+#include "ReadWritable.hpp"
+
+std::atomic<bool> ReadWritable::littleEndianDefault_(false);
@@ -0,0 +1,189 @@
+#include "ResolveCache.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <memory>
+
+using namespace boost::asio::ip;
+
+namespace {
+	typedef std::pair<std::string, fct_lookup_protocol> CacheKey;
+
+	struct CacheEntry {
+		boost::system::error_code error;
+		ResolveCache::AddressList addresses;
+		boost::posix_time::ptime expires;
+	};
+
+	/**
+	 * The handlers waiting for a lookup in progress. This is owned by the completion
+	 * handler of the lookup, so it is cleaned up together with the io_service.
+	 */
+	struct PendingLookup {
+		std::vector<std::pair<ResolveCache::RequestId, ResolveCache::Handler> > waiters;
+	};
+
+	boost::mutex cacheMutex;
+	std::map<CacheKey, CacheEntry> cache;
+	std::map<CacheKey, std::weak_ptr<PendingLookup> > pendingLookups;
+	ResolveCache::RequestId lastRequestId = 0;
+
+	boost::posix_time::time_duration positiveTtl = boost::posix_time::seconds(60);
+	boost::posix_time::time_duration negativeTtl = boost::posix_time::seconds(10);
+	size_t maxEntries = 256;
+
+	boost::posix_time::ptime now() {
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	/**
+	 * Only cache results which say something about the host, not about
+	 * the state of the network or the resolver.
+	 */
+	bool isCacheable(const boost::system::error_code &error) {
+		return !error
+				|| error == boost::asio::error::host_not_found
+				|| error == boost::asio::error::no_data;
+	}
+
+	/**
+	 * Make room for a new entry by removing expired entries, or the entry which expires
+	 * first if none has expired yet. Must be called with the cache mutex held.
+	 */
+	void makeRoom(const boost::posix_time::ptime &currentTime) {
+		for(auto iter = cache.begin(); iter != cache.end();) {
+			if(iter->second.expires <= currentTime) {
+				cache.erase(iter++);
+			} else {
+				++iter;
+			}
+		}
+
+		while(!cache.empty() && cache.size() >= maxEntries) {
+			auto oldest = std::min_element(cache.begin(), cache.end(),
+					[](const std::pair<const CacheKey, CacheEntry> &a, const std::pair<const CacheKey, CacheEntry> &b) {
+				return a.second.expires < b.second.expires;
+			});
+			cache.erase(oldest);
+		}
+	}
+
+	void handleResolve(CacheKey key, std::shared_ptr<PendingLookup> pending,
+			std::shared_ptr<tcp::resolver> resolver,
+			const boost::system::error_code &error, tcp::resolver::iterator endpointIterator) {
+		ResolveCache::AddressList addresses;
+		for(; endpointIterator != tcp::resolver::iterator(); ++endpointIterator) {
+			addresses.push_back(endpointIterator->endpoint().address());
+		}
+
+		std::vector<std::pair<ResolveCache::RequestId, ResolveCache::Handler> > waiters;
+		{
+			boost::lock_guard<boost::mutex> guard(cacheMutex);
+			auto pendingEntry = pendingLookups.find(key);
+			if(pendingEntry != pendingLookups.end() && pendingEntry->second.lock() == pending) {
+				pendingLookups.erase(pendingEntry);
+			}
+
+			boost::posix_time::time_duration ttl = (!error && !addresses.empty()) ? positiveTtl : negativeTtl;
+			if(maxEntries > 0 && isCacheable(error) && ttl > boost::posix_time::seconds(0)) {
+				boost::posix_time::ptime currentTime = now();
+				cache.erase(key);
+				makeRoom(currentTime);
+				CacheEntry &entry = cache[key];
+				entry.error = error;
+				entry.addresses = addresses;
+				entry.expires = currentTime + ttl;
+			}
+			waiters.swap(pending->waiters);
+		}
+
+		for(auto &waiter : waiters) {
+			waiter.second(error, addresses);
+		}
+	}
+}
+
+ResolveCache::RequestId ResolveCache::asyncResolve(const std::string &host, fct_lookup_protocol protocol, Handler handler) {
+	std::string lowercaseHost(host);
+	std::transform(lowercaseHost.begin(), lowercaseHost.end(), lowercaseHost.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	CacheKey key(lowercaseHost, protocol);
+
+	boost::unique_lock<boost::mutex> lock(cacheMutex);
+	auto cached = cache.find(key);
+	if(cached != cache.end()) {
+		if(cached->second.expires > now()) {
+			CacheEntry entry = cached->second;
+			lock.unlock();
+			handler(entry.error, entry.addresses);
+			return 0;
+		} else {
+			cache.erase(cached);
+		}
+	}
+
+	RequestId requestId = ++lastRequestId;
+	std::shared_ptr<PendingLookup> pending = pendingLookups[key].lock();
+	if(pending) {
+		pending->waiters.push_back(std::make_pair(requestId, handler));
+		return requestId;
+	}
+
+	pending = std::make_shared<PendingLookup>();
+	pending->waiters.push_back(std::make_pair(requestId, handler));
+	pendingLookups[key] = pending;
+
+	tcp::resolver::query::flags flags(tcp::resolver::query::numeric_service | tcp::resolver::query::address_configured);
+	tcp::resolver::query query = (protocol == fct_lookup_protocol::ANY)
+			? tcp::resolver::query(host, "0", flags)
+			: tcp::resolver::query((protocol == fct_lookup_protocol::V4) ? tcp::v4() : tcp::v6(), host, "0", flags);
+
+	auto resolver = std::make_shared<tcp::resolver>(Asio::getIoService());
+	resolver->async_resolve(query, boost::bind(&handleResolve, key, pending, resolver,
+			boost::asio::placeholders::error, boost::asio::placeholders::iterator));
+	return requestId;
+}
+
+void ResolveCache::cancel(RequestId requestId) {
+	if(requestId == 0) {
+		return;
+	}
+
+	// The handler may hold the last reference to its owner, so it is destroyed after the lock is released
+	Handler cancelled;
+	boost::lock_guard<boost::mutex> guard(cacheMutex);
+	for(auto &pendingEntry : pendingLookups) {
+		std::shared_ptr<PendingLookup> pending = pendingEntry.second.lock();
+		if(!pending) {
+			continue;
+		}
+		for(auto waiter = pending->waiters.begin(); waiter != pending->waiters.end(); ++waiter) {
+			if(waiter->first == requestId) {
+				cancelled.swap(waiter->second);
+				pending->waiters.erase(waiter);
+				return;
+			}
+		}
+	}
+}
+
+void ResolveCache::configure(uint32_t positiveTtlSeconds, uint32_t negativeTtlSeconds, size_t newMaxEntries) {
+	boost::lock_guard<boost::mutex> guard(cacheMutex);
+	positiveTtl = boost::posix_time::seconds(positiveTtlSeconds);
+	negativeTtl = boost::posix_time::seconds(negativeTtlSeconds);
+	maxEntries = newMaxEntries;
+	if(cache.size() > maxEntries) {
+		cache.clear();
+	}
+}
+
+void ResolveCache::clear() {
+	boost::lock_guard<boost::mutex> guard(cacheMutex);
+	cache.clear();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <faucet/Asio.hpp>
+
+#include <boost/integer.hpp>
+#include <string>
+#include <vector>
+#include <functional>
+
+enum class fct_lookup_protocol {V4, V6, ANY};
+
+/**
+ * A process-wide cache of hostname lookups, shared by all sockets and lookups.
+ *
+ * Successful lookups are cached for the positive TTL, lookups which found no
+ * address for the negative TTL. The system resolver doesn't tell us the actual
+ * DNS TTL, so these are fixed values. Concurrent requests for the same host are
+ * combined into a single lookup.
+ *
+ * All methods are thread safe. Handlers are called from the IO thread, or
+ * synchronously if the result is already cached.
+ */
+class ResolveCache {
+public:
+	typedef std::vector<boost::asio::ip::address> AddressList;
+	typedef std::function<void(const boost::system::error_code&, const AddressList&)> Handler;
+	typedef uint64_t RequestId;
+
+	/**
+	 * Returns an id which can be passed to cancel() while the lookup is in progress,
+	 * or 0 if the handler was already called synchronously.
+	 */
+	static RequestId asyncResolve(const std::string &host, fct_lookup_protocol protocol, Handler handler);
+
+	/**
+	 * Drop the handler of a lookup in progress, so it will not be called and whatever
+	 * it holds on to is released. The lookup itself continues for the other waiters
+	 * and the cache. Unknown or completed ids are ignored.
+	 */
+	static void cancel(RequestId requestId);
+
+	/**
+	 * Set the cache parameters. A maximum of 0 entries disables caching,
+	 * but concurrent lookups are still combined.
+	 */
+	static void configure(uint32_t positiveTtlSeconds, uint32_t negativeTtlSeconds, size_t maxEntries);
+
+	static void clear();
+};
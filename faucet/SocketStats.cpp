@@ -0,0 +1,91 @@
+#include "SocketStats.hpp"
+
+#include <boost/thread/locks.hpp>
+#include <algorithm>
+
+SocketStats::SocketStats() : parent_(&global()), childrenMutex_(), children_() {
+	for(size_t i = 0; i < STAT_COUNT; ++i) {
+		values_[i].store(0, std::memory_order_relaxed);
+	}
+	boost::lock_guard<boost::mutex> guard(parent_->childrenMutex_);
+	parent_->children_.insert(this);
+}
+
+SocketStats::SocketStats(SocketStats *parent) : parent_(parent), childrenMutex_(), children_() {
+	for(size_t i = 0; i < STAT_COUNT; ++i) {
+		values_[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * The totals are handed to the global statistics in the same step as leaving
+ * them, so that a concurrent read sees them exactly once.
+ */
+SocketStats::~SocketStats() {
+	if(parent_) {
+		boost::lock_guard<boost::mutex> guard(parent_->childrenMutex_);
+		parent_->merge(*this);
+		parent_->children_.erase(this);
+	}
+}
+
+void SocketStats::raise(StatId stat, uint64_t value) {
+	uint64_t current = values_[stat].load(std::memory_order_relaxed);
+	while(value > current && !values_[stat].compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+uint64_t SocketStats::get(StatId stat) const {
+	uint64_t value = values_[stat].load(std::memory_order_relaxed);
+	boost::lock_guard<boost::mutex> guard(childrenMutex_);
+	for(const SocketStats *child : children_) {
+		uint64_t childValue = child->values_[stat].load(std::memory_order_relaxed);
+		value = isHighWaterMark(stat) ? std::max(value, childValue) : value + childValue;
+	}
+	return value;
+}
+
+uint64_t SocketStats::getLatencyPercentile(LatencyId latency, double percentile) const {
+	boost::lock_guard<boost::mutex> guard(childrenMutex_);
+	if(children_.empty()) {
+		return latencies_[latency].getPercentile(percentile);
+	}
+
+	LatencyHistogram total;
+	total.add(latencies_[latency]);
+	for(const SocketStats *child : children_) {
+		total.add(child->latencies_[latency]);
+	}
+	return total.getPercentile(percentile);
+}
+
+void SocketStats::detachFromGlobal() {
+	if(parent_) {
+		boost::lock_guard<boost::mutex> guard(parent_->childrenMutex_);
+		parent_->children_.erase(this);
+		parent_ = nullptr;
+	}
+}
+
+void SocketStats::merge(const SocketStats &other) {
+	for(size_t i = 0; i < STAT_COUNT; ++i) {
+		StatId stat = static_cast<StatId>(i);
+		uint64_t value = other.values_[i].load(std::memory_order_relaxed);
+		if(isHighWaterMark(stat)) {
+			raise(stat, value);
+		} else {
+			add(stat, value);
+		}
+	}
+	for(size_t i = 0; i < LATENCY_COUNT; ++i) {
+		latencies_[i].add(other.latencies_[i]);
+	}
+}
+
+/**
+ * Never destroyed, because sockets may still be destroyed during static destruction.
+ */
+SocketStats &SocketStats::global() {
+	static SocketStats *globalStats = new SocketStats(nullptr);
+	return *globalStats;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <faucet/LatencyHistogram.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <atomic>
+#include <chrono>
+#include <set>
+
+/**
+ * The statistics kept for each socket and for the whole process.
+ * The values are part of the API.
+ */
+enum StatId {
+	STAT_BYTES_SENT = 0,
+	STAT_BYTES_RECEIVED = 1,
+	STAT_MESSAGES_SENT = 2,
+	STAT_MESSAGES_RECEIVED = 3,
+	STAT_SEND_SYSCALLS = 4,
+	STAT_RECEIVE_SYSCALLS = 5,
+	STAT_SEND_QUEUE_HIGH_WATER = 6,
+	STAT_RECEIVE_QUEUE_HIGH_WATER = 7,
+	STAT_ERRORS = 8,
+	STAT_SEND_HANDLER_NANOS = 9,
+	STAT_RECEIVE_HANDLER_NANOS = 10,
+
+	STAT_COUNT = 11
+};
+
+/**
+ * The latency histograms kept for each socket and for the whole process.
+ * The values are part of the API.
+ */
+enum LatencyId {
+	/**
+	 * From sending until the data is taken from the send queue. For TCP,
+	 * until the send operation which completes the data is done.
+	 */
+	LATENCY_QUEUE_WAIT = 0,
+
+	/**
+	 * From starting a send until the IO thread has handed the data to the OS.
+	 * For UDP, this starts when the datagram's endpoint is known.
+	 */
+	LATENCY_DISPATCH_DELAY = 1,
+
+	/**
+	 * Hostname lookups of UDP sockets.
+	 */
+	LATENCY_RESOLVE_TIME = 2,
+
+	LATENCY_COUNT = 3
+};
+
+/**
+ * Cumulative counters and latency histograms which can be updated from any
+ * thread. Updates use relaxed atomics, so they are cheap but a set of values
+ * read at the same time may not be consistent with each other.
+ *
+ * Updates only touch the socket's own statistics, so that the IO threads don't
+ * contend on shared counters. The global statistics are the sum of those of all
+ * live sockets, which is computed when they are read, plus the totals of the
+ * sockets which have been destroyed. For the high water marks, the global value
+ * is the highest of any socket.
+ */
+class SocketStats : boost::noncopyable {
+public:
+	SocketStats();
+	~SocketStats();
+
+	void add(StatId stat, uint64_t amount) {
+		values_[stat].fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	void increment(StatId stat) {
+		add(stat, 1);
+	}
+
+	/**
+	 * Raise a high water mark to the given value, if it is higher.
+	 */
+	void raise(StatId stat, uint64_t value);
+
+	uint64_t get(StatId stat) const;
+
+	void recordLatency(LatencyId latency, LatencyClock::time_point start, LatencyClock::time_point end) {
+		latencies_[latency].record(start, end);
+	}
+
+	/**
+	 * The given percentile (0-100) of a latency histogram in microseconds.
+	 */
+	uint64_t getLatencyPercentile(LatencyId latency, double percentile) const;
+
+	/**
+	 * Leave these statistics out of the global ones. Used by sockets which
+	 * are layered on top of another socket, so that their traffic is only
+	 * counted once globally.
+	 */
+	void detachFromGlobal();
+
+	static SocketStats &global();
+
+private:
+	explicit SocketStats(SocketStats *parent);
+
+	static bool isHighWaterMark(StatId stat) {
+		return stat == STAT_SEND_QUEUE_HIGH_WATER || stat == STAT_RECEIVE_QUEUE_HIGH_WATER;
+	}
+
+	/**
+	 * Apply the own values of the other statistics to these.
+	 */
+	void merge(const SocketStats &other);
+
+	std::atomic<uint64_t> values_[STAT_COUNT];
+	LatencyHistogram latencies_[LATENCY_COUNT];
+	SocketStats *parent_;
+
+	/*
+	 * Only used by the global statistics, whose own values are the totals of
+	 * the destroyed sockets.
+	 */
+	mutable boost::mutex childrenMutex_;
+	std::set<const SocketStats *> children_;
+};
+
+/**
+ * Adds the time from construction to destruction to a statistic,
+ * used to measure how long the IO thread spends in a handler.
+ */
+class StatTimer : boost::noncopyable {
+public:
+	StatTimer(SocketStats &stats, StatId stat) :
+			stats_(stats), stat_(stat), start_(std::chrono::steady_clock::now()) {}
+
+	~StatTimer() {
+		auto elapsed = std::chrono::steady_clock::now() - start_;
+		stats_.add(stat_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+private:
+	SocketStats &stats_;
+	StatId stat_;
+	std::chrono::steady_clock::time_point start_;
+};
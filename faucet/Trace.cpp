@@ -0,0 +1,186 @@
+#include "Trace.hpp"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+std::atomic<bool> Trace::enabled_(false);
+
+namespace {
+	const uint32_t DUMP_VERSION = 1;
+
+	/**
+	 * Number of records kept per thread.
+	 */
+	const size_t RING_SIZE = 16384;
+
+	struct TraceRecord {
+		uint64_t timestamp;
+		uint64_t arg;
+		const char *name;
+		uint32_t type;
+	};
+
+	/*
+	 * Only the owning thread writes to a ring. written is the total number
+	 * of records written, so the ring has wrapped if it exceeds RING_SIZE.
+	 */
+	struct ThreadRing {
+		ThreadRing(uint32_t id) : id(id), name("thread"), written(0), records(RING_SIZE) {}
+
+		uint32_t id;
+		const char *name;
+		std::atomic<uint64_t> written;
+		std::vector<TraceRecord> records;
+	};
+
+	/*
+	 * Rings are never freed, because their thread may record
+	 * events at any time until the process ends.
+	 */
+	boost::mutex ringsMutex;
+	std::vector<ThreadRing *> rings;
+	__thread ThreadRing *threadRing = 0;
+
+	const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+	ThreadRing *getThreadRing() {
+		if(!threadRing) {
+			boost::lock_guard<boost::mutex> guard(ringsMutex);
+			threadRing = new ThreadRing(static_cast<uint32_t>(rings.size()));
+			rings.push_back(threadRing);
+		}
+		return threadRing;
+	}
+
+	class DumpWriter {
+	public:
+		DumpWriter(std::FILE *file) : file_(file), ok_(true) {}
+
+		void writeUint32(uint32_t value) {
+			uint8_t bytes[4];
+			for(size_t i = 0; i < 4; ++i) {
+				bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+			}
+			write(bytes, 4);
+		}
+
+		void writeUint64(uint64_t value) {
+			writeUint32(static_cast<uint32_t>(value));
+			writeUint32(static_cast<uint32_t>(value >> 32));
+		}
+
+		void write(const void *data, size_t size) {
+			ok_ = ok_ && std::fwrite(data, 1, size, file_) == size;
+		}
+
+		bool isOk() {
+			return ok_;
+		}
+
+	private:
+		std::FILE *file_;
+		bool ok_;
+	};
+}
+
+void Trace::setEnabled(bool enabled) {
+	enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::record(TraceEventType type, const char *name, uint64_t arg) {
+	ThreadRing *ring = getThreadRing();
+	uint64_t index = ring->written.load(std::memory_order_relaxed);
+	TraceRecord &record = ring->records[index % RING_SIZE];
+	record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - traceEpoch).count();
+	record.arg = arg;
+	record.name = name;
+	record.type = type;
+	ring->written.store(index + 1, std::memory_order_release);
+}
+
+void Trace::setThreadName(const char *name) {
+	getThreadRing()->name = name;
+}
+
+/*
+ * The dump starts with "FCTTRACE" and the format version, followed by the table
+ * of event and thread names, each as length and characters, and then the records
+ * of each thread, oldest first. All numbers are little endian uint32 or uint64.
+ */
+bool Trace::dump(const std::string &filename) {
+	std::vector<ThreadRing *> ringsCopy;
+	{
+		boost::lock_guard<boost::mutex> guard(ringsMutex);
+		ringsCopy = rings;
+	}
+
+	std::map<const char *, uint32_t> nameIndices;
+	std::vector<const char *> names;
+	auto nameIndex = [&](const char *name) -> uint32_t {
+		auto found = nameIndices.find(name);
+		if(found != nameIndices.end()) {
+			return found->second;
+		}
+		uint32_t index = static_cast<uint32_t>(names.size());
+		nameIndices[name] = index;
+		names.push_back(name);
+		return index;
+	};
+
+	// Copy the records first, so that all names are known before the table is written
+	struct ThreadRecords {
+		uint32_t id;
+		uint32_t name;
+		std::vector<TraceRecord> records;
+	};
+	std::vector<ThreadRecords> threads;
+	for(ThreadRing *ring : ringsCopy) {
+		ThreadRecords thread;
+		thread.id = ring->id;
+		thread.name = nameIndex(ring->name);
+		uint64_t written = ring->written.load(std::memory_order_acquire);
+		uint64_t first = written > RING_SIZE ? written - RING_SIZE : 0;
+		for(uint64_t i = first; i < written; ++i) {
+			thread.records.push_back(ring->records[i % RING_SIZE]);
+			nameIndex(thread.records.back().name);
+		}
+		threads.push_back(std::move(thread));
+	}
+
+	std::FILE *file = std::fopen(filename.c_str(), "wb");
+	if(!file) {
+		return false;
+	}
+
+	DumpWriter writer(file);
+	writer.write("FCTTRACE", 8);
+	writer.writeUint32(DUMP_VERSION);
+	writer.writeUint32(static_cast<uint32_t>(names.size()));
+	for(const char *name : names) {
+		uint32_t length = static_cast<uint32_t>(std::strlen(name));
+		writer.writeUint32(length);
+		writer.write(name, length);
+	}
+
+	writer.writeUint32(static_cast<uint32_t>(threads.size()));
+	for(const ThreadRecords &thread : threads) {
+		writer.writeUint32(thread.id);
+		writer.writeUint32(thread.name);
+		writer.writeUint32(static_cast<uint32_t>(thread.records.size()));
+		for(const TraceRecord &record : thread.records) {
+			writer.writeUint64(record.timestamp);
+			writer.writeUint64(record.arg);
+			writer.writeUint32(nameIndices[record.name]);
+			writer.writeUint32(record.type);
+		}
+	}
+
+	bool ok = writer.isOk();
+	return std::fclose(file) == 0 && ok;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <boost/integer.hpp>
+#include <atomic>
+#include <string>
+
+/*
+ * Opt-in tracing of API calls and IO thread activity, for finding out what
+ * the game thread and the IO thread were doing when a session lagged.
+ *
+ * The trace points are only compiled in when FAUCET_TRACE is defined. Even then,
+ * nothing is recorded until tracing is enabled with Trace::setEnabled(). Each
+ * thread records into its own ring of fixed-size records, which only keeps the
+ * most recent events, so recording takes no locks and never allocates after
+ * the first event of a thread.
+ *
+ * Trace::dump() writes all rings to a binary file. tools/trace_to_json.py
+ * converts it to the Trace Event JSON format of chrome://tracing and Perfetto.
+ */
+
+/**
+ * The values are part of the dump format.
+ */
+enum TraceEventType {
+	TRACE_BEGIN = 0,
+	TRACE_END = 1,
+	TRACE_INSTANT = 2
+};
+
+class Trace {
+public:
+	static void setEnabled(bool enabled);
+
+	static bool isEnabled() {
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Record an event of the calling thread. The name must be a string
+	 * literal or otherwise stay valid until the trace has been dumped.
+	 */
+	static void record(TraceEventType type, const char *name, uint64_t arg);
+
+	/**
+	 * Name the calling thread in dumps, like the name of an event.
+	 */
+	static void setThreadName(const char *name);
+
+	/**
+	 * Write the recorded events to the file. Events recorded while the dump
+	 * is written may be missing or garbled, so tracing should be disabled first.
+	 */
+	static bool dump(const std::string &filename);
+
+private:
+	static std::atomic<bool> enabled_;
+};
+
+/**
+ * Records a TRACE_BEGIN event when constructed and a matching TRACE_END
+ * event when destroyed, if tracing is enabled at construction.
+ */
+class TraceScope {
+public:
+	TraceScope(const char *name, uint64_t arg) : name_(Trace::isEnabled() ? name : 0), arg_(arg) {
+		if(name_) {
+			Trace::record(TRACE_BEGIN, name_, arg_);
+		}
+	}
+
+	~TraceScope() {
+		if(name_) {
+			Trace::record(TRACE_END, name_, arg_);
+		}
+	}
+
+private:
+	TraceScope(const TraceScope &);
+	TraceScope &operator=(const TraceScope &);
+
+	const char *name_;
+	uint64_t arg_;
+};
+
+#ifdef FAUCET_TRACE
+#define FCT_TRACE_CONCAT_IMPL(a, b) a##b
+#define FCT_TRACE_CONCAT(a, b) FCT_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * Trace the rest of the enclosing scope.
+ */
+#define FCT_TRACE_SCOPE(name, arg) TraceScope FCT_TRACE_CONCAT(fctTraceScope, __LINE__)((name), (arg))
+
+/**
+ * Trace an exported function, named after the function.
+ */
+#define FCT_TRACE_API() FCT_TRACE_SCOPE(__func__, 0)
+
+#define FCT_TRACE_BEGIN(name, arg) do { if(Trace::isEnabled()) Trace::record(TRACE_BEGIN, (name), (arg)); } while(0)
+#define FCT_TRACE_END(name, arg) do { if(Trace::isEnabled()) Trace::record(TRACE_END, (name), (arg)); } while(0)
+#define FCT_TRACE_EVENT(name, arg) do { if(Trace::isEnabled()) Trace::record(TRACE_INSTANT, (name), (arg)); } while(0)
+#define FCT_TRACE_THREAD_NAME(name) Trace::setThreadName(name)
+#else
+#define FCT_TRACE_SCOPE(name, arg) do {} while(0)
+#define FCT_TRACE_API() do {} while(0)
+#define FCT_TRACE_BEGIN(name, arg) do {} while(0)
+#define FCT_TRACE_END(name, arg) do {} while(0)
+#define FCT_TRACE_EVENT(name, arg) do {} while(0)
+#define FCT_TRACE_THREAD_NAME(name) do {} while(0)
+#endif
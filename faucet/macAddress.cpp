@@ -1,57 +1,113 @@
-#include <winsock2.h>
-#include <Iphlpapi.h>
-#include <Wininet.h>
-#include <cstdlib>
-#include <cstdio>
-
-#include <faucet/GmStringBuffer.hpp>
-
-#define DLLEXPORT extern "C" __declspec(dllexport)
-
-DLLEXPORT const char* mac_addrs() {
-	PIP_ADAPTER_ADDRESSES addrs = NULL;
-	DWORD dwRetVal = 0;
-	ULONG flags = GAA_FLAG_SKIP_UNICAST|GAA_FLAG_SKIP_ANYCAST|GAA_FLAG_SKIP_MULTICAST|GAA_FLAG_SKIP_DNS_SERVER;
-
-	ULONG allocSize = 16384;
-	int iterations = 0;
-
-	do {
-		addrs = (PIP_ADAPTER_ADDRESSES) realloc((void*)addrs, allocSize);
-		if(addrs==NULL) {
-			return "";
-		}
-		dwRetVal = GetAdaptersAddresses(AF_UNSPEC, flags, NULL, addrs, &allocSize);
-	} while((dwRetVal == ERROR_BUFFER_OVERFLOW) && (iterations++ < 5));
-
-	if(dwRetVal!=NO_ERROR) {
-		free((void*)addrs);
-		return "";
-	}
-
-	std::string result;
-	bool firstAddress = true;
-	char hexbuf[3];
-	PIP_ADAPTER_ADDRESSES currAddr = addrs;
-	while (currAddr) {
-		if(currAddr->PhysicalAddressLength != 0 && currAddr->IfType != IF_TYPE_TUNNEL && currAddr->IfType != IF_TYPE_PPP && currAddr->IfType != IF_TYPE_SOFTWARE_LOOPBACK) {
-			if(!firstAddress) {
-				result.append(",");
-			}
-			firstAddress = false;
-			bool firstByte = true;
-            for (int i = 0; i < (int) currAddr->PhysicalAddressLength; i++) {
-                if (!firstByte) {
-                	result.append("-");
-                }
-                firstByte = false;
-				snprintf(hexbuf, 3, "%02X", (int) currAddr->PhysicalAddress[i]);
-				result.append(hexbuf);
-            }
-		}
-		currAddr = currAddr->Next;
-	}
-
-	free((void*)addrs);
-	return replaceStringReturnBuffer(result);
-}
+#ifdef _WIN32
+#include <winsock2.h>
+#include <Iphlpapi.h>
+#include <Wininet.h>
+#else
+#include <ifaddrs.h>
+#include <net/if_arp.h>
+#include <netpacket/packet.h>
+#include <sys/socket.h>
+#endif
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
+#include <faucet/GmStringBuffer.hpp>
+#include <faucet/DllExport.hpp>
+
+namespace {
+	/**
+	 * Append the address to the comma separated list in result, formatted as
+	 * hex bytes separated by dashes, e.g. 00-1A-2B-3C-4D-5E.
+	 */
+	void appendMacAddress(std::string &result, const unsigned char *address, size_t length) {
+		if(!result.empty()) {
+			result.append(",");
+		}
+		char hexbuf[3];
+		for(size_t i = 0; i < length; i++) {
+			if(i > 0) {
+				result.append("-");
+			}
+			snprintf(hexbuf, 3, "%02X", (int) address[i]);
+			result.append(hexbuf);
+		}
+	}
+}
+
+#ifdef _WIN32
+
+DLLEXPORT const char* mac_addrs() {
+	PIP_ADAPTER_ADDRESSES addrs = NULL;
+	DWORD dwRetVal = 0;
+	ULONG flags = GAA_FLAG_SKIP_UNICAST|GAA_FLAG_SKIP_ANYCAST|GAA_FLAG_SKIP_MULTICAST|GAA_FLAG_SKIP_DNS_SERVER;
+
+	ULONG allocSize = 16384;
+	int iterations = 0;
+
+	do {
+		addrs = (PIP_ADAPTER_ADDRESSES) realloc((void*)addrs, allocSize);
+		if(addrs==NULL) {
+			return "";
+		}
+		dwRetVal = GetAdaptersAddresses(AF_UNSPEC, flags, NULL, addrs, &allocSize);
+	} while((dwRetVal == ERROR_BUFFER_OVERFLOW) && (iterations++ < 5));
+
+	if(dwRetVal!=NO_ERROR) {
+		free((void*)addrs);
+		return "";
+	}
+
+	std::string result;
+	PIP_ADAPTER_ADDRESSES currAddr = addrs;
+	while (currAddr) {
+		if(currAddr->PhysicalAddressLength != 0 && currAddr->IfType != IF_TYPE_TUNNEL && currAddr->IfType != IF_TYPE_PPP && currAddr->IfType != IF_TYPE_SOFTWARE_LOOPBACK) {
+			appendMacAddress(result, currAddr->PhysicalAddress, currAddr->PhysicalAddressLength);
+		}
+		currAddr = currAddr->Next;
+	}
+
+	free((void*)addrs);
+	return replaceStringReturnBuffer(result);
+}
+
+#else
+
+/*
+ * Every interface is listed once with an AF_PACKET address that holds its
+ * hardware address. Tunnels, PPP links and loopback are skipped like on
+ * Windows, which also skips interfaces without a hardware address.
+ */
+DLLEXPORT const char* mac_addrs() {
+	struct ifaddrs *addrs = NULL;
+	if(getifaddrs(&addrs) != 0) {
+		return "";
+	}
+
+	std::string result;
+	for(struct ifaddrs *currAddr = addrs; currAddr; currAddr = currAddr->ifa_next) {
+		if(!currAddr->ifa_addr || currAddr->ifa_addr->sa_family != AF_PACKET) {
+			continue;
+		}
+
+		const struct sockaddr_ll *linkAddr = reinterpret_cast<const struct sockaddr_ll *>(currAddr->ifa_addr);
+		switch(linkAddr->sll_hatype) {
+		case ARPHRD_LOOPBACK:
+		case ARPHRD_PPP:
+		case ARPHRD_TUNNEL:
+		case ARPHRD_TUNNEL6:
+		case ARPHRD_SIT:
+		case ARPHRD_IPGRE:
+		case ARPHRD_NONE:
+			continue;
+		}
+		if(linkAddr->sll_halen != 0) {
+			appendMacAddress(result, linkAddr->sll_addr, linkAddr->sll_halen);
+		}
+	}
+
+	freeifaddrs(addrs);
+	return replaceStringReturnBuffer(result);
+}
+
+#endif
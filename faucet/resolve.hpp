@@ -1,43 +1,57 @@
-#pragma once
-
-#include <faucet/Asio.hpp>
-#include <string>
-#include <functional>
-#include <boost/lexical_cast.hpp>
-
-enum class fct_lookup_protocol {V4, V6, ANY};
-
-template <typename InternetProtocol>
-void fct_async_resolve(std::string host, uint16_t port, typename InternetProtocol::resolver &resolver, std::function<void(const boost::system::error_code&, typename InternetProtocol::resolver::iterator)> handleResolve) {
-    fct_async_resolve<InternetProtocol>(host, port, resolver, handleResolve, fct_lookup_protocol::ANY);
-}
-
-/**
- * Wrapper around resolver::async_resolve which will first attempt to interpret the hostname as a literal IP address.
- * If it can be parsed this way, the handler function will be called synchronously.
- */
-template <typename InternetProtocol>
-void fct_async_resolve(std::string host, uint16_t port, typename InternetProtocol::resolver &resolver, std::function<void(const boost::system::error_code&, typename InternetProtocol::resolver::iterator)> handleResolve, fct_lookup_protocol protocol) {
-	boost::system::error_code ec;
-	typename InternetProtocol::endpoint endpoint(boost::asio::ip::address::from_string(host, ec), port);
-
-	if(!ec) {
-        if((protocol == fct_lookup_protocol::V4 && endpoint.address().is_v4()) || (protocol == fct_lookup_protocol::V6 && endpoint.address().is_v6()) || protocol == fct_lookup_protocol::ANY) {
-            handleResolve(ec, InternetProtocol::resolver::iterator::create(endpoint, "", ""));
-        } else {
-            handleResolve(ec, typename InternetProtocol::resolver::iterator());
-        }
-	} else {
-	    std::string portStr(boost::lexical_cast<std::string>(port));
-	    typename InternetProtocol::resolver::query::flags flags(InternetProtocol::resolver::query::numeric_service | InternetProtocol::resolver::query::address_configured);
-	    typename InternetProtocol::resolver::query query([&](){
-	        if(protocol == fct_lookup_protocol::ANY) {
-                return typename InternetProtocol::resolver::query(host, portStr, flags);
-	        } else {
-	            return typename InternetProtocol::resolver::query((protocol == fct_lookup_protocol::V4) ? InternetProtocol::v4() : InternetProtocol::v6(), host, portStr, flags);
-	        }
-	    }());
-
-        resolver.async_resolve(query, handleResolve);
-	}
-}
+#pragma once
+
+#include <faucet/Asio.hpp>
+#include <faucet/ResolveCache.hpp>
+#include <string>
+#include <vector>
+#include <functional>
+#include <boost/lexical_cast.hpp>
+#include <boost/version.hpp>
+
+namespace fct_resolve_detail {
+	/**
+	 * Boost 1.66 moved creating resolver results from the iterator to results_type.
+	 */
+	template <typename InternetProtocol, typename... Args>
+	typename InternetProtocol::resolver::iterator createResults(Args... args) {
+#if BOOST_VERSION >= 106600
+		return InternetProtocol::resolver::results_type::create(args...);
+#else
+		return InternetProtocol::resolver::iterator::create(args...);
+#endif
+	}
+}
+
+template <typename InternetProtocol>
+ResolveCache::RequestId fct_async_resolve(std::string host, uint16_t port, std::function<void(const boost::system::error_code&, typename InternetProtocol::resolver::iterator)> handleResolve) {
+    return fct_async_resolve<InternetProtocol>(host, port, handleResolve, fct_lookup_protocol::ANY);
+}
+
+/**
+ * Resolve the hostname through the ResolveCache, after first attempting to interpret it as a literal IP address.
+ * If it can be parsed this way, or the result is already cached, the handler function will be called synchronously
+ * and 0 is returned. Otherwise, the returned id can be passed to ResolveCache::cancel().
+ */
+template <typename InternetProtocol>
+ResolveCache::RequestId fct_async_resolve(std::string host, uint16_t port, std::function<void(const boost::system::error_code&, typename InternetProtocol::resolver::iterator)> handleResolve, fct_lookup_protocol protocol) {
+	boost::system::error_code ec;
+	typename InternetProtocol::endpoint endpoint(boost::asio::ip::address::from_string(host, ec), port);
+
+	if(!ec) {
+        if((protocol == fct_lookup_protocol::V4 && endpoint.address().is_v4()) || (protocol == fct_lookup_protocol::V6 && endpoint.address().is_v6()) || protocol == fct_lookup_protocol::ANY) {
+            handleResolve(ec, fct_resolve_detail::createResults<InternetProtocol>(endpoint, "", ""));
+        } else {
+            handleResolve(ec, typename InternetProtocol::resolver::iterator());
+        }
+        return 0;
+	} else {
+	    return ResolveCache::asyncResolve(host, protocol, [host, port, handleResolve](const boost::system::error_code &error, const ResolveCache::AddressList &addresses) {
+	        std::vector<typename InternetProtocol::endpoint> endpoints;
+	        for(auto &address : addresses) {
+	            endpoints.push_back(typename InternetProtocol::endpoint(address, port));
+	        }
+	        handleResolve(error, fct_resolve_detail::createResults<InternetProtocol>(endpoints.begin(), endpoints.end(),
+	                host, boost::lexical_cast<std::string>(port)));
+	    });
+	}
+}
@@ -1,967 +1,1702 @@
-#include <faucet/Asio.hpp>
-#include <faucet/HandleMap.hpp>
-#include <faucet/tcp/TcpSocket.hpp>
-#include <faucet/tcp/CombinedTcpAcceptor.hpp>
-#include <faucet/Buffer.hpp>
-#include <faucet/udp/UdpSocket.hpp>
-#include <faucet/clipped_cast.hpp>
-#include <faucet/GmStringBuffer.hpp>
-#include <faucet/IpLookup.hpp>
-#include <faucet/ReadWritable.hpp>
-#include <faucet/HexCodec.hpp>
-#include <faucet/Base64Codec.hpp>
-
-#include <boost/integer.hpp>
-#include <boost/cast.hpp>
-#include <boost/thread.hpp>
-#include <limits>
-#include <algorithm>
-#include <cstdio>
-#include <memory>
-
-#define DLLEXPORT extern "C" __declspec(dllexport)
-
-#define GM8_STRLEN(gm_str) \
-  (*(uint32_t*)(((const char*)gm_str) - sizeof(uint32_t)))
-
-// TODO: Add function fct_clear_returnbuffer()?
-// TODO: split up this file
-// TODO: Add a header file for use from C / C++
-// TODO:
-
-using boost::numeric_cast;
-using boost::numeric::bad_numeric_cast;
-
-typedef boost::lock_guard<boost::recursive_mutex> MutexLock;
-
-HandleMap handles = HandleMap();
-std::shared_ptr<UdpSocket> defaultUdpSocket = std::shared_ptr<UdpSocket>();
-
-HexCodec hexCodec = HexCodec();
-Base64Codec base64Codec = Base64Codec();
-
-static Buffer *getBufferOrReceiveBuffer(double handle)
-{
-    auto buffer = handles.find<Buffer> (handle);
-	auto socket = handles.find<Socket> (handle);
-
-    return
-        buffer ? buffer.get() :
-        socket ? &(socket->getReceiveBuffer()) :
-                 nullptr;
-}
-
-DLLEXPORT double dllStartup() {
-	ReadWritable::setLittleEndianDefault(false);
-	Asio::startup();
-	return 0;
-}
-
-DLLEXPORT double dllShutdown() {
-	defaultUdpSocket.reset();
-	handles.releaseAll();
-	Asio::shutdown();
-	return 0;
-}
-
-// TODO: Make the actual implementation properly thread safe instead of making the API single-threaded
-boost::recursive_mutex *apiMutex = new boost::recursive_mutex;
-
-DLLEXPORT double tcp_connect(char *host, double port) {
-	MutexLock lock(*apiMutex);
-	uint16_t intPort;
-	try {
-		intPort = numeric_cast<uint16_t> (port);
-	} catch (bad_numeric_cast &e) {
-		intPort = 0;
-	}
-	if (intPort == 0) {
-		boost::system::error_code error = boost::asio::error::make_error_code(
-				boost::asio::error::invalid_argument);
-		return handles.allocate(TcpSocket::error(error.message()));
-	} else {
-		return handles.allocate(TcpSocket::connectTo(host, intPort));
-	}
-}
-
-DLLEXPORT double tcp_set_nodelay(double socketHandle, double nodelay) {
-    MutexLock lock(*apiMutex);
-    auto socket = handles.find<TcpSocket> (socketHandle);
-    return (socket && socket->setNoDelay(nodelay >= 0.5)) ? 1 : -1;
-}
-
-DLLEXPORT double udp_bind(double port) {
-	MutexLock lock(*apiMutex);
-	try {
-		return handles.allocate(UdpSocket::bind(numeric_cast<uint16_t> (port)));
-	} catch (bad_numeric_cast &e) {
-	}
-	boost::system::error_code error = boost::asio::error::make_error_code(
-			boost::asio::error::invalid_argument);
-	return handles.allocate(UdpSocket::error(error.message()));
-}
-
-// TODO: rename to tcp_connecting in 2.0
-DLLEXPORT double socket_connecting(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<TcpSocket> (socketHandle);
-	if (socket) {
-		return socket->isConnecting();
-	} else {
-		return false;
-	}
-}
-
-DLLEXPORT double tcp_listen(double port) {
-	MutexLock lock(*apiMutex);
-	try {
-		auto acceptor = std::make_shared<CombinedTcpAcceptor>(numeric_cast<uint16_t> (port));
-		return handles.allocate(acceptor);
-	} catch (bad_numeric_cast &e) {
-	}
-	boost::system::error_code error = boost::asio::error::make_error_code(
-			boost::asio::error::invalid_argument);
-	return handles.allocate(TcpSocket::error(error.message()));
-}
-
-DLLEXPORT double socket_accept(double handle) {
-	MutexLock lock(*apiMutex);
-	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
-	if (acceptor) {
-		auto accepted = acceptor->accept();
-
-		if (accepted) {
-			return handles.allocate(accepted);
-		}
-	}
-	return -1;
-}
-
-DLLEXPORT double tcp_listening_v4(double handle) {
-	MutexLock lock(*apiMutex);
-	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
-	if (acceptor) {
-		return acceptor->isListeningV4();
-	}
-	return false;
-}
-
-DLLEXPORT double tcp_listening_v6(double handle) {
-	MutexLock lock(*apiMutex);
-	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
-	if (acceptor) {
-		return acceptor->isListeningV6();
-	}
-	return false;
-}
-
-DLLEXPORT double socket_has_error(double handle) {
-	MutexLock lock(*apiMutex);
-	auto fallible = handles.find<Fallible> (handle);
-
-	if (fallible) {
-		return fallible->hasError();
-	} else {
-		return true;
-	}
-}
-
-DLLEXPORT const char *socket_error(double handle) {
-	MutexLock lock(*apiMutex);
-	static std::string stringbuf;
-	auto fallible = handles.find<Fallible> (handle);
-
-	if (fallible) {
-		stringbuf = fallible->getErrorMessage();
-		return stringbuf.c_str();
-	} else {
-		return "This handle is invalid.";
-	}
-}
-
-// TODO: Remove in v2
-DLLEXPORT double socket_handle_io() {
-	return 0;
-}
-
-static void destroySocket(double handle, bool hard) {
-	MutexLock lock(*apiMutex);
-	auto tcpSocket = handles.find<TcpSocket> (handle);
-	if (tcpSocket) {
-		if (hard) {
-			tcpSocket->disconnectAbortive();
-		} else {
-			/*
-			 * For a graceful disconnect, it's enough to just let the socket
-			 * object die. However, we want to make sure that everything
-			 * left in the send buffer is committed in case the library user forgot.
-			 */
-			tcpSocket->send();
-		}
-		handles.release(handle);
-		return;
-	}
-
-	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
-	if (acceptor) {
-		handles.release(handle);
-		return;
-	}
-
-	auto udpSocket = handles.find<UdpSocket> (handle);
-	if (udpSocket) {
-		if(hard) {
-			udpSocket->close();
-		}
-		handles.release(handle);
-		return;
-	}
-}
-
-DLLEXPORT double socket_destroy(double handle) {
-	destroySocket(handle, false);
-	return 0;
-}
-
-DLLEXPORT double socket_destroy_abortive(double handle) {
-	destroySocket(handle, true);
-	return 0;
-}
-
-/**
- * Convert a double to the target integer type and write it to the
- * given writable. Fractional numbers are rounded to the nearest integer.
- * Values outside of the target type's range will be clamped to the border
- * values of the type.
- *
- * IntType can be any integer type up to 32 bits, or int64_t, but not uint64_t.
- */
-template<typename IntType>
-static double writeIntValue(double handle, double value) {
-	MutexLock lock(*apiMutex);
-	auto writable = handles.find<ReadWritable> (handle);
-	if (writable) {
-		writable->writeIntValue<IntType> (value);
-	}
-	return 0;
-}
-
-DLLEXPORT double write_ubyte(double handle, double value) {
-	return writeIntValue<uint8_t> (handle, value);
-}
-
-DLLEXPORT double write_byte(double handle, double value) {
-	return writeIntValue<int8_t> (handle, value);
-}
-
-DLLEXPORT double write_ushort(double handle, double value) {
-	return writeIntValue<uint16_t> (handle, value);
-}
-
-DLLEXPORT double write_short(double handle, double value) {
-	return writeIntValue<int16_t> (handle, value);
-}
-
-DLLEXPORT double write_uint(double handle, double value) {
-	return writeIntValue<uint32_t> (handle, value);
-}
-
-DLLEXPORT double write_int(double handle, double value) {
-	return writeIntValue<int32_t> (handle, value);
-}
-
-DLLEXPORT double write_float(double handle, double value) {
-	MutexLock lock(*apiMutex);
-	auto writable = handles.find<ReadWritable> (handle);
-	if (writable) {
-		writable->writeFloat(value);
-	}
-	return 0;
-}
-
-DLLEXPORT double write_double(double handle, double value) {
-	MutexLock lock(*apiMutex);
-	std::shared_ptr<ReadWritable> writable = handles.find<ReadWritable> (
-			handle);
-	if (writable) {
-		writable->writeDouble(value);
-	}
-	return 0;
-}
-
-DLLEXPORT double write_string(double handle, const char *str) {
-	MutexLock lock(*apiMutex);
-	auto writable = handles.find<ReadWritable> (handle);
-	if (writable) {
-		size_t size = strlen(str);
-		writable->write(reinterpret_cast<const uint8_t *> (str), size);
-	}
-	return 0;
-}
-
-/**
- * DO NOT pass the empty string for str, the length prefix of that is broken in GM8!
- */
-DLLEXPORT double _fnet_hidden_write_binary_string(double handle, const char *str) {
-	MutexLock lock(*apiMutex);
-	auto writable = handles.find<ReadWritable> (handle);
-	if (writable) {
-		size_t size = GM8_STRLEN(str);
-		writable->write(reinterpret_cast<const uint8_t *> (str), size);
-	}
-	return 0;
-}
-
-DLLEXPORT double write_buffer_part(double destHandle, double bufferHandle, double ammount) {
-	MutexLock lock(*apiMutex);
-	auto dest = handles.find<ReadWritable> (destHandle);
-	auto source = handles.find<ReadWritable> (bufferHandle);
-
-	size_t intAmmount = clipped_cast<size_t> (ammount);
-
-	if (dest && source) {
-		uint8_t tempBuffer[4096];
-		intAmmount = std::min(intAmmount, source->bytesRemaining());
-		size_t fullBuffers = intAmmount/4096;
-		size_t lastBuffer = intAmmount%4096;
-		for(size_t i=0; i<fullBuffers; i++) {
-			source->read(tempBuffer, 4096);
-			dest->write(tempBuffer, 4096);
-		}
-		source->read(tempBuffer, lastBuffer);
-		dest->write(tempBuffer, lastBuffer);
-		return intAmmount;
-	}
-	return 0;
-}
-
-// Attn: Do not take the shortcut of writing directly from src to dest if they might be the same buffer. vector doesn't like inserting into itself.
-DLLEXPORT double write_buffer(double destHandle, double bufferHandle) {
-	MutexLock lock(*apiMutex);
-	auto dest = handles.find<ReadWritable> (destHandle);
-	auto srcBuffer = handles.find<Buffer> (bufferHandle);
-	auto srcSocket = handles.find<Socket> (bufferHandle);
-
-	if (dest && srcBuffer) {
-		size_t oldReadPos = srcBuffer->size()-srcBuffer->bytesRemaining();
-		srcBuffer->setReadpos(0);
-		write_buffer_part(destHandle, bufferHandle, srcBuffer->size());
-		srcBuffer->setReadpos(oldReadPos);
-	} else if (dest && srcSocket) {
-		dest->write(srcSocket->getReceiveBuffer().getData(),
-				srcSocket->getReceiveBuffer().size());
-	}
-	return 0;
-}
-
-DLLEXPORT double write_hex(double destHandle, const char *hexStr) {
-	MutexLock lock(*apiMutex);
-
-    auto dest = handles.find<ReadWritable> (destHandle);
-
-    if (!dest)
-        return -1;
-
-    return hexCodec.writeHex(hexStr, *dest);
-}
-
-DLLEXPORT double write_base64(double destHandle, const char *hexStr) {
-	MutexLock lock(*apiMutex);
-
-    auto dest = handles.find<ReadWritable> (destHandle);
-
-    if (!dest)
-        return -1;
-
-    return base64Codec.writeBase64(hexStr, *dest);
-}
-
-DLLEXPORT double tcp_receive(double socketHandle, double size) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<TcpSocket> (socketHandle);
-	if (socket) {
-		size_t intSize;
-		try {
-			intSize = numeric_cast<size_t> (size);
-		} catch (bad_numeric_cast &e) {
-			return false;
-		}
-		return socket->receive(intSize);
-	} else {
-		return false;
-	}
-}
-
-DLLEXPORT double tcp_receive_available(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<TcpSocket> (socketHandle);
-	if (socket) {
-		return socket->receive();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double tcp_eof(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<TcpSocket> (socketHandle);
-	if (socket) {
-		return socket->isEof();
-	} else {
-		return true;
-	}
-}
-
-// TODO rename to tcp_send in 2.0
-DLLEXPORT double socket_send(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<TcpSocket> (socketHandle);
-	if (socket) {
-		socket->send();
-	}
-	return 0;
-}
-
-DLLEXPORT double socket_sendbuffer_size(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (socketHandle);
-	if (socket) {
-		return socket->getSendbufferSize();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double socket_receivebuffer_size(double socketHandle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (socketHandle);
-	if (socket) {
-		return socket->getReceivebufferSize();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double socket_sendbuffer_limit(double socketHandle, double sizeLimit) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (socketHandle);
-	if (socket) {
-		size_t intSize = clipped_cast<size_t> (sizeLimit);
-		if (intSize == 0) {
-			intSize = std::numeric_limits<size_t>::max();
-		}
-		socket->setSendbufferLimit(intSize);
-	}
-	return 0;
-}
-
-/*********************************************
- * Buffer functions
- */
-
-DLLEXPORT double buffer_create() {
-	MutexLock lock(*apiMutex);
-	auto newBuffer = std::make_shared<Buffer>();
-	return handles.allocate(newBuffer);
-}
-
-DLLEXPORT double buffer_destroy(double handle) {
-	MutexLock lock(*apiMutex);
-	auto buffer = handles.find<Buffer> (handle);
-	if (buffer) {
-		handles.release(handle);
-	}
-	return 0;
-}
-
-DLLEXPORT double buffer_clear(double handle) {
-	MutexLock lock(*apiMutex);
-	auto buffer = handles.find<Buffer> (handle);
-	if (buffer) {
-		buffer->clear();
-	}
-	return 0;
-}
-
-DLLEXPORT double buffer_size(double handle) {
-	MutexLock lock(*apiMutex);
-	auto buffer = handles.find<Buffer> (handle);
-	if (buffer) {
-		return buffer->size();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double buffer_bytes_left(double handle) {
-	MutexLock lock(*apiMutex);
-	auto readWritable = handles.find<ReadWritable> (handle);
-	if (readWritable) {
-		return readWritable->bytesRemaining();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double buffer_set_readpos(double handle, double newPos) {
-	MutexLock lock(*apiMutex);
-	auto readWritable = handles.find<ReadWritable> (handle);
-	if (readWritable) {
-		readWritable->setReadpos(clipped_cast<size_t> (newPos));
-	}
-	return 0;
-}
-
-template<typename DesiredType>
-static double readValue(double handle) {
-	MutexLock lock(*apiMutex);
-	auto readWritable = handles.find<ReadWritable> (handle);
-	if (readWritable) {
-		return readWritable->readValue<DesiredType> ();
-	} else {
-		return 0;
-	}
-}
-
-DLLEXPORT double read_ubyte(double handle) {
-	return readValue<uint8_t> (handle);
-}
-
-DLLEXPORT double read_byte(double handle) {
-	return readValue<int8_t> (handle);
-}
-
-DLLEXPORT double read_ushort(double handle) {
-	return readValue<uint16_t> (handle);
-}
-
-DLLEXPORT double read_short(double handle) {
-	return readValue<int16_t> (handle);
-}
-
-DLLEXPORT double read_uint(double handle) {
-	return readValue<uint32_t> (handle);
-}
-
-DLLEXPORT double read_int(double handle) {
-	return readValue<int32_t> (handle);
-}
-
-DLLEXPORT double read_float(double handle) {
-	return readValue<float> (handle);
-}
-
-DLLEXPORT double read_double(double handle) {
-	return readValue<double> (handle);
-}
-
-DLLEXPORT const char *read_string(double handle, double len) {
-	MutexLock lock(*apiMutex);
-	auto readWritable = handles.find<ReadWritable> (handle);
-	if (readWritable) {
-		return replaceStringReturnBuffer(readWritable->readString(clipped_cast<size_t> (len)));
-	} else {
-		return "";
-	}
-}
-
-/**
- * Fills the GM-string outstr with the following bytes of the given ReadWritable
- * DO NOT pass the empty string for outstr, the length prefix of that is broken in GM8!
- */
-DLLEXPORT double _fnet_hidden_read_binary_string(double handle, char *outstr) {
-	MutexLock lock(*apiMutex);
-	Buffer *buffer = getBufferOrReceiveBuffer(handle);
-	if (buffer) {
-		return buffer->read(reinterpret_cast<uint8_t*>(outstr), GM8_STRLEN(outstr));
-	}
-
-    return 0;
-}
-
-/**
- * Skips as many bytes of the given ReadWritable as the length of skip.
- * DO NOT pass the empty string for skip, the length prefix of that is broken in GM8!
- */
-DLLEXPORT double _fnet_hidden_skip_length_of_string(double handle, char *skip) {
-    MutexLock lock(*apiMutex);
-	Buffer *buffer = getBufferOrReceiveBuffer(handle);
-	if (buffer) {
-        buffer->setReadpos(buffer->getReadpos() + GM8_STRLEN(skip));
-	}
-
-    return 0;
-}
-
-static double bytesBeforeDelimiter(Buffer *buffer, const char *delimStart, const char *delimEnd) {
-	if(buffer) {
-        const char* bufStart = reinterpret_cast<const char*>(buffer->getData());
-        const char* bufReadPtr = bufStart + buffer->getReadpos();
-        const char* bufEnd = bufStart + buffer->size();
-
-        const char* delimInBuf = std::search(bufReadPtr, bufEnd, delimStart, delimEnd);
-        if(delimInBuf != bufEnd) {
-            return delimInBuf-bufReadPtr;
-        }
-	}
-
-	return -1;
-}
-
-DLLEXPORT double _fnet_hidden_bytes_before_delimiter(double handle, const char *needle) {
-    MutexLock lock(*apiMutex);
-    Buffer *buffer = getBufferOrReceiveBuffer(handle);
-    return bytesBeforeDelimiter(buffer, needle, needle+GM8_STRLEN(needle));
-}
-
-static const char *readDelimitedString(double handle, const char *delimStart, const char *delimEnd) {
-    Buffer *buffer = getBufferOrReceiveBuffer(handle);
-    double length = bytesBeforeDelimiter(buffer, delimStart, delimEnd);
-    if(length >= 0) {
-        const char *result = replaceStringReturnBuffer(buffer->readString(length));
-        size_t delimLen = delimEnd-delimStart;
-        buffer->setReadpos(buffer->getReadpos() + delimLen);
-        return result;
-    }
-
-    return "";
-}
-
-DLLEXPORT const char *_fnet_hidden_read_delimited_string(double handle, const char *delimiter) {
-	MutexLock lock(*apiMutex);
-	return readDelimitedString(handle, delimiter, delimiter+strlen(delimiter));
-}
-
-DLLEXPORT const char *_fnet_hidden_read_cstring(double handle) {
-	MutexLock lock(*apiMutex);
-	const char delimiter = 0;
-	return readDelimitedString(handle, &delimiter, (&delimiter)+1);
-}
-
-DLLEXPORT const char *read_hex(double srcHandle, double dLen) {
-	MutexLock lock(*apiMutex);
-
-    auto src = getBufferOrReceiveBuffer(srcHandle);
-    size_t len = clipped_cast<size_t>(dLen);
-    if(src)
-        return replaceStringReturnBuffer(hexCodec.readHex(*src, len));
-    return "";
-}
-
-DLLEXPORT const char *read_base64(double srcHandle, double dLen) {
-	MutexLock lock(*apiMutex);
-
-	auto src = getBufferOrReceiveBuffer(srcHandle);
-    size_t len = clipped_cast<size_t>(dLen);
-	if (src)
-        return replaceStringReturnBuffer(base64Codec.readBase64(*src, len));
-    return "";
-}
-
-// Read the entire file, appending it to the end of the buffer
-DLLEXPORT double append_file_to_buffer(double handle, const char *filename) {
-	MutexLock lock(*apiMutex);
-	auto readWritable = handles.find<ReadWritable> (handle);
-	if (!readWritable) {
-		return -10;
-	}
-
-	FILE *f = fopen(filename, "rb");
-	if(f == NULL) {
-		return -1;	// File not found
-	}
-	fseek(f, 0, SEEK_END);
-	long signedSize = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	if(signedSize < 0) {
-		fclose(f);
-		return -2;	// File too large
-	}
-
-	size_t size = signedSize;
-	uint8_t *tempBuffer = (uint8_t*)malloc(size);
-	if(tempBuffer == 0) {
-		fclose(f);
-		return -3; // Not enough memory
-	}
-
-	if(fread(tempBuffer, sizeof(uint8_t), size, f) != size) {
-		free(tempBuffer);
-		fclose(f);
-		return -4; // Read error
-	}
-
-	readWritable->write(tempBuffer, size);
-
-	free(tempBuffer);
-	fclose(f);
-	return 1;	// Success
-}
-
-// Overwrite or create the file provided with the contents of the buffer
-DLLEXPORT double write_buffer_to_file(double handle, const char *filename) {
-	MutexLock lock(*apiMutex);
-	auto src = getBufferOrReceiveBuffer(handle);
-
-	if(!src) {
-		return -10;
-	}
-
-	Buffer &srcBuffer = *src;
-
-	FILE *f = fopen(filename, "wb");
-	if(f == NULL) {
-		return -1;	// Cannot open file
-	}
-
-	if(fwrite(srcBuffer.getData(), sizeof(uint8_t), srcBuffer.size(), f) != srcBuffer.size()) {
-		fclose(f);
-		return -2;	// I/O-Error writing to the file
-	} else {
-		fclose(f);
-		return 1; // Success
-	}
-}
-
-/**
- * UDP
- */
-
-static std::shared_ptr<UdpSocket> getDefaultUdpSocket() {
-	if(!defaultUdpSocket) {
-		defaultUdpSocket = UdpSocket::bind(0);
-	}
-	return defaultUdpSocket;
-}
-
-static std::shared_ptr<UdpSocket> getUdpSocketOrPrepareDefaultSocket(double handle) {
-	auto buffer = handles.find<Buffer> (handle);
-	if(buffer) {
-		auto defaultSocket = getDefaultUdpSocket();
-		defaultSocket->write(buffer->getData(), buffer->size());
-		return defaultSocket;
-	}
-
-	return handles.find<UdpSocket>(handle);
-}
-
-DLLEXPORT double udp_send(double handle, const char *host, double port) {
-	MutexLock lock(*apiMutex);
-	uint16_t intPort;
-	try {
-		intPort = numeric_cast<uint16_t> (port);
-	} catch (bad_numeric_cast &e) {
-		intPort = 0;
-	}
-
-	if (intPort == 0) {
-		return false;
-	}
-
-	auto sock = getUdpSocketOrPrepareDefaultSocket(handle);
-	if(sock) {
-		return sock->send(host, intPort);
-	}
-	return false;
-}
-
-DLLEXPORT double udp_broadcast(double handle, double port) {
-	MutexLock lock(*apiMutex);
-	uint16_t intPort;
-	try {
-		intPort = numeric_cast<uint16_t> (port);
-	} catch (bad_numeric_cast &e) {
-		intPort = 0;
-	}
-
-	if (intPort == 0) {
-		return false;
-	}
-
-	auto sock = getUdpSocketOrPrepareDefaultSocket(handle);
-	if(sock) {
-		return sock->broadcast(intPort);
-	}
-	return false;
-}
-
-DLLEXPORT double udp_receive(double handle) {
-	MutexLock lock(*apiMutex);
-	auto sock = handles.find<UdpSocket>(handle);
-	if(sock) {
-		return sock->receive();
-	}
-	return false;
-}
-
-/**
- * Generic functions
- */
-
-DLLEXPORT double debug_handles() {
-	MutexLock lock(*apiMutex);
-	return handles.size();
-}
-
-DLLEXPORT double set_little_endian_global(double littleEndian) {
-	MutexLock lock(*apiMutex);
-	ReadWritable::setLittleEndianDefault(littleEndian);
-	return 0;
-}
-
-DLLEXPORT double set_little_endian(double handle, double littleEndian) {
-	MutexLock lock(*apiMutex);
-	auto writable = handles.find<ReadWritable> (handle);
-	if (writable) {
-		writable->setLittleEndian(littleEndian);
-	}
-	return 0;
-}
-
-DLLEXPORT const char* socket_remote_ip(double handle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (handle);
-	if (socket) {
-		return replaceStringReturnBuffer(socket->getRemoteIp());
-	}
-	return "";
-}
-
-DLLEXPORT double socket_local_port(double handle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (handle);
-	if (socket) {
-		return socket->getLocalPort();
-	}
-
-	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
-	if(acceptor) {
-		return acceptor->getLocalPort();
-	}
-
-	return 0;
-}
-
-DLLEXPORT double socket_remote_port(double handle) {
-	MutexLock lock(*apiMutex);
-	auto socket = handles.find<Socket> (handle);
-	if (socket) {
-		return socket->getRemotePort();
-	}
-	return 0;
-}
-
-DLLEXPORT double ip_lookup_create(const char *host) {
-	MutexLock lock(*apiMutex);
-	return handles.allocate(IpLookup::lookup(host));
-}
-
-DLLEXPORT double ipv4_lookup_create(const char *host) {
-	MutexLock lock(*apiMutex);
-	return handles.allocate(IpLookup::lookup(host, fct_lookup_protocol::V4));
-}
-
-DLLEXPORT double ipv6_lookup_create(const char *host) {
-	MutexLock lock(*apiMutex);
-	return handles.allocate(IpLookup::lookup(host, fct_lookup_protocol::V6));
-}
-
-DLLEXPORT double ip_lookup_ready(double lookupHandle) {
-	MutexLock lock(*apiMutex);
-	auto lookup = handles.find<IpLookup>(lookupHandle);
-	if(lookup) {
-		return lookup->ready();
-	} else {
-		/*
-		 * We return true here to prevent a lockup in infinite loops waiting for
-		 * the lookup to finish.
-		 */
-		return true;
-	}
-}
-
-DLLEXPORT double ip_lookup_has_next(double lookupHandle) {
-	MutexLock lock(*apiMutex);
-	auto lookup = handles.find<IpLookup>(lookupHandle);
-	if(lookup) {
-		return lookup->hasNext();
-	}
-	return false;
-}
-
-DLLEXPORT const char *ip_lookup_next_result(double lookupHandle) {
-	MutexLock lock(*apiMutex);
-	auto lookup = handles.find<IpLookup>(lookupHandle);
-	if(lookup) {
-		return replaceStringReturnBuffer(lookup->nextResult());
-	}
-	return "";
-}
-
-DLLEXPORT double ip_lookup_destroy(double lookupHandle) {
-	MutexLock lock(*apiMutex);
-	auto lookup = handles.find<IpLookup>(lookupHandle);
-	if(lookup) {
-		handles.release(lookupHandle);
-	}
-	return 0;
-}
-
-DLLEXPORT double ip_is_v4(const char *ip) {
-	MutexLock lock(*apiMutex);
-	boost::system::error_code ec;
-	boost::asio::ip::address_v4::from_string(ip, ec);
-
-	if(!ec) {
-		return true;
-	} else {
-		return false;
-	}
-}
-
-DLLEXPORT double ip_is_v6(const char *ip) {
-	MutexLock lock(*apiMutex);
-	boost::system::error_code ec;
-	boost::asio::ip::address_v6::from_string(ip, ec);
-
-	if(!ec) {
-		return true;
-	} else {
-		return false;
-	}
-}
-
-/**
- * Some bit manipulation functions. They are pure functions, so no locking is required.
- */
-DLLEXPORT double bit_get(double source, double bitnum) {
-	int8_t intbitnum = clipped_cast<int8_t>(bitnum);
-	if(intbitnum < 0 || intbitnum > 63) {
-		return 0;
-	}
-
-	int64_t intsource = clipped_cast<int64_t>(source);
-	return (intsource & ((static_cast<int64_t>(1))<<intbitnum)) != 0 ? 1 : 0;
-}
-
-DLLEXPORT double bit_set(double source, double bitnum, double value) {
-	int8_t intbitnum = clipped_cast<int8_t>(bitnum);
-	if(intbitnum < 0 || intbitnum > 63) {
-		return source;
-	}
-
-	int64_t intsource = clipped_cast<int64_t>(source);
-	if(value>=0.5) {
-		return intsource |= (static_cast<int64_t>(1) << intbitnum);
-	} else {
-		return intsource &= ~(static_cast<int64_t>(1) << intbitnum);
-	}
-}
-
-static uint8_t build_bit(double in, uint8_t place) {
-	return in>=0.5 ? (1<<place) : 0;
-}
-
-DLLEXPORT double build_ubyte(double b7, double b6, double b5, double b4, double b3, double b2, double b1, double b0) {
-	return build_bit(b7,7) | build_bit(b6,6) | build_bit(b5,5) | build_bit(b4,4) | build_bit(b3,3) | build_bit(b2,2) | build_bit(b1,1) | build_bit(b0,0);
-}
+#include <faucet/Asio.hpp>
+#include <faucet/HandleMap.hpp>
+#include <faucet/tcp/TcpSocket.hpp>
+#include <faucet/tcp/CombinedTcpAcceptor.hpp>
+#include <faucet/Buffer.hpp>
+#include <faucet/udp/UdpSocket.hpp>
+#include <faucet/udp/UdpPeer.hpp>
+#include <faucet/udp/ReliableUdpConnection.hpp>
+#include <faucet/clipped_cast.hpp>
+#include <faucet/GmStringBuffer.hpp>
+#include <faucet/IpLookup.hpp>
+#include <faucet/ReadWritable.hpp>
+#include <faucet/HexCodec.hpp>
+#include <faucet/Base64Codec.hpp>
+#include <faucet/EventQueue.hpp>
+#include <faucet/ResolveCache.hpp>
+#include <faucet/EndpointId.hpp>
+#include <faucet/Trace.hpp>
+#include <faucet/DllExport.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/cast.hpp>
+#include <boost/thread.hpp>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#define GM8_STRLEN(gm_str) \
+  (*(uint32_t*)(((const char*)gm_str) - sizeof(uint32_t)))
+
+// TODO: Add function fct_clear_returnbuffer()?
+// TODO: split up this file
+// TODO: Add a header file for use from C / C++
+// TODO:
+
+using boost::numeric_cast;
+using boost::numeric::bad_numeric_cast;
+
+/*
+ * The API can be called from several threads at once. The handle map is thread safe, and
+ * sockets synchronize internally with the IO thread. Buffers (including the receive buffers
+ * of sockets) are not locked, so each one should only be used by one thread at a time.
+ * Lookups return shared_ptrs, so destroying a handle while another thread is still using
+ * it only destroys the object once that thread is done.
+ */
+typedef HandleMap<Fallible, ReadWritable, Socket, Buffer, TcpSocket, UdpSocket,
+		CombinedTcpAcceptor, IpLookup, ReliableUdpConnection, UdpPeer> ApiHandleMap;
+ApiHandleMap handles;
+
+typedef boost::unique_lock<boost::mutex> DefaultUdpSocketLock;
+boost::mutex defaultUdpSocketMutex;
+std::shared_ptr<UdpSocket> defaultUdpSocket = std::shared_ptr<UdpSocket>();
+
+HexCodec hexCodec = HexCodec();
+Base64Codec base64Codec = Base64Codec();
+
+/**
+ * The receive buffer of a socket is returned as a shared_ptr aliasing the socket.
+ */
+static std::shared_ptr<Buffer> getBufferOrReceiveBuffer(double handle)
+{
+    auto entry = handles.lookup(handle);
+    auto buffer = entry.as<Buffer>();
+	auto socket = entry.as<Socket>();
+
+    return
+        buffer ? buffer :
+        socket ? std::shared_ptr<Buffer>(socket, &(socket->getReceiveBuffer())) :
+                 nullptr;
+}
+
+DLLEXPORT double dllStartup() {
+	FCT_TRACE_API();
+	ReadWritable::setLittleEndianDefault(false);
+	Asio::startup();
+	return 0;
+}
+
+DLLEXPORT double dllShutdown() {
+	FCT_TRACE_API();
+	EventQueue::setEnabled(false);
+	{
+		DefaultUdpSocketLock lock(defaultUdpSocketMutex);
+		defaultUdpSocket.reset();
+	}
+	// Peers which have not been accepted would keep their socket alive
+	handles.forEach<UdpSocket>([](uint32_t handle, UdpSocket *socket) {
+		socket->setDemultiplexing(0);
+	});
+	handles.releaseAll();
+	Asio::shutdown();
+	ResolveCache::clear();
+	return 0;
+}
+
+DLLEXPORT double tcp_connect(char *host, double port) {
+	FCT_TRACE_API();
+	uint16_t intPort;
+	try {
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+	if (intPort == 0) {
+		boost::system::error_code error = boost::asio::error::make_error_code(
+				boost::asio::error::invalid_argument);
+		return handles.allocate(TcpSocket::error(error.message()));
+	} else {
+		return handles.allocate(TcpSocket::connectTo(host, intPort));
+	}
+}
+
+DLLEXPORT double tcp_set_nodelay(double socketHandle, double nodelay) {
+	FCT_TRACE_API();
+    auto socket = handles.find<TcpSocket> (socketHandle);
+    return (socket && socket->setNoDelay(nodelay >= 0.5)) ? 1 : -1;
+}
+
+DLLEXPORT double udp_bind(double port) {
+	FCT_TRACE_API();
+	try {
+		return handles.allocate(UdpSocket::bind(numeric_cast<uint16_t> (port)));
+	} catch (bad_numeric_cast &e) {
+	}
+	boost::system::error_code error = boost::asio::error::make_error_code(
+			boost::asio::error::invalid_argument);
+	return handles.allocate(UdpSocket::error(error.message()));
+}
+
+// TODO: rename to tcp_connecting in 2.0
+DLLEXPORT double socket_connecting(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<TcpSocket> (socketHandle);
+	if (socket) {
+		return socket->isConnecting();
+	} else {
+		return false;
+	}
+}
+
+DLLEXPORT double tcp_listen(double port) {
+	FCT_TRACE_API();
+	try {
+		auto acceptor = CombinedTcpAcceptor::listen(numeric_cast<uint16_t> (port));
+		return handles.allocate(acceptor);
+	} catch (bad_numeric_cast &e) {
+	}
+	boost::system::error_code error = boost::asio::error::make_error_code(
+			boost::asio::error::invalid_argument);
+	return handles.allocate(TcpSocket::error(error.message()));
+}
+
+DLLEXPORT double socket_accept(double handle) {
+	FCT_TRACE_API();
+	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
+	if (acceptor) {
+		auto accepted = acceptor->accept();
+
+		if (accepted) {
+			return handles.allocate(accepted);
+		}
+	}
+	return -1;
+}
+
+static double listenTcp(double port, double backlog, double shards) {
+	try {
+		int intBacklog = clipped_cast<int>(backlog);
+		if(intBacklog <= 0) {
+			intBacklog = boost::asio::socket_base::max_connections;
+		}
+		auto acceptor = CombinedTcpAcceptor::listen(numeric_cast<uint16_t> (port), intBacklog,
+				clipped_cast<size_t>(shards));
+		return handles.allocate(acceptor);
+	} catch (bad_numeric_cast &e) {
+	}
+	boost::system::error_code error = boost::asio::error::make_error_code(
+			boost::asio::error::invalid_argument);
+	return handles.allocate(TcpSocket::error(error.message()));
+}
+
+/**
+ * Like tcp_listen, but with the given number of connections the OS holds
+ * per protocol until they are accepted. 0 selects the system maximum.
+ */
+DLLEXPORT double tcp_listen_backlog(double port, double backlog) {
+	FCT_TRACE_API();
+	return listenTcp(port, backlog, 1);
+}
+
+/**
+ * Like tcp_listen_backlog, but opens the given number of listeners per protocol
+ * on the same port, each served by its own IO thread. Only supported on systems
+ * with SO_REUSEPORT, elsewhere this behaves like tcp_listen_backlog.
+ */
+DLLEXPORT double tcp_listen_sharded(double port, double backlog, double shards) {
+	FCT_TRACE_API();
+	return listenTcp(port, backlog, shards);
+}
+
+/**
+ * Accept up to maxCount waiting connections at once. The handles of the new
+ * sockets are appended to the buffer as uint32 values, and their number is
+ * returned. Returns -1 if the handle is not an acceptor or the buffer is invalid.
+ */
+DLLEXPORT double socket_accept_batch(double handle, double bufferHandle, double maxCount) {
+	FCT_TRACE_API();
+	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
+	auto buffer = handles.find<Buffer> (bufferHandle);
+	if (!acceptor || !buffer) {
+		return -1;
+	}
+
+	uint32_t max = clipped_cast<uint32_t>(maxCount);
+	uint32_t count = 0;
+	while (count < max) {
+		auto accepted = acceptor->accept();
+		if (!accepted) {
+			break;
+		}
+		uint32_t acceptedHandle = handles.allocate(accepted);
+		if (acceptedHandle == 0) {
+			// Out of handles, the connection is closed again
+			break;
+		}
+		buffer->writeIntValue<uint32_t> (acceptedHandle);
+		++count;
+	}
+	return count;
+}
+
+DLLEXPORT double tcp_listening_v4(double handle) {
+	FCT_TRACE_API();
+	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
+	if (acceptor) {
+		return acceptor->isListeningV4();
+	}
+	return false;
+}
+
+DLLEXPORT double tcp_listening_v6(double handle) {
+	FCT_TRACE_API();
+	auto acceptor = handles.find<CombinedTcpAcceptor> (handle);
+	if (acceptor) {
+		return acceptor->isListeningV6();
+	}
+	return false;
+}
+
+DLLEXPORT double socket_has_error(double handle) {
+	FCT_TRACE_API();
+	auto fallible = handles.find<Fallible> (handle);
+
+	if (fallible) {
+		return fallible->hasError();
+	} else {
+		return true;
+	}
+}
+
+DLLEXPORT const char *socket_error(double handle) {
+	FCT_TRACE_API();
+	auto fallible = handles.find<Fallible> (handle);
+
+	if (fallible) {
+		return replaceStringReturnBuffer(fallible->getErrorMessage());
+	} else {
+		return "This handle is invalid.";
+	}
+}
+
+// TODO: Remove in v2
+DLLEXPORT double socket_handle_io() {
+	FCT_TRACE_API();
+	return 0;
+}
+
+static void destroySocket(double handle, bool hard) {
+	auto entry = handles.lookup(handle);
+	auto tcpSocket = entry.as<TcpSocket>();
+	if (tcpSocket) {
+		if (hard) {
+			tcpSocket->disconnectAbortive();
+		} else {
+			/*
+			 * For a graceful disconnect, it's enough to just let the socket
+			 * object die. However, we want to make sure that everything
+			 * left in the send buffer is committed in case the library user forgot.
+			 */
+			tcpSocket->send();
+		}
+		handles.release(handle);
+		return;
+	}
+
+	auto acceptor = entry.as<CombinedTcpAcceptor>();
+	if (acceptor) {
+		handles.release(handle);
+		return;
+	}
+
+	auto udpSocket = entry.as<UdpSocket>();
+	if (udpSocket) {
+		if(hard) {
+			udpSocket->close();
+		}
+		// Peers which have not been accepted would keep the socket alive
+		udpSocket->setDemultiplexing(0);
+		handles.release(handle);
+		return;
+	}
+
+	auto udpPeer = entry.as<UdpPeer>();
+	if (udpPeer) {
+		handles.release(handle);
+		return;
+	}
+
+	/*
+	 * Without a hard close, unacknowledged reliable messages are still
+	 * retransmitted in the background until the peer has received them.
+	 */
+	auto connection = entry.as<ReliableUdpConnection>();
+	if (connection) {
+		if(hard) {
+			connection->close();
+		} else {
+			connection->stopReceiving();
+		}
+		handles.release(handle);
+		return;
+	}
+}
+
+DLLEXPORT double socket_destroy(double handle) {
+	FCT_TRACE_API();
+	destroySocket(handle, false);
+	return 0;
+}
+
+DLLEXPORT double socket_destroy_abortive(double handle) {
+	FCT_TRACE_API();
+	destroySocket(handle, true);
+	return 0;
+}
+
+/**
+ * Convert a double to the target integer type and write it to the
+ * given writable. Fractional numbers are rounded to the nearest integer.
+ * Values outside of the target type's range will be clamped to the border
+ * values of the type.
+ *
+ * IntType can be any integer type up to 32 bits, or int64_t, but not uint64_t.
+ */
+template<typename IntType>
+static double writeIntValue(double handle, double value) {
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		writable->writeIntValue<IntType> (value);
+	}
+	return 0;
+}
+
+DLLEXPORT double write_ubyte(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<uint8_t> (handle, value);
+}
+
+DLLEXPORT double write_byte(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<int8_t> (handle, value);
+}
+
+DLLEXPORT double write_ushort(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<uint16_t> (handle, value);
+}
+
+DLLEXPORT double write_short(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<int16_t> (handle, value);
+}
+
+DLLEXPORT double write_uint(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<uint32_t> (handle, value);
+}
+
+DLLEXPORT double write_int(double handle, double value) {
+	FCT_TRACE_API();
+	return writeIntValue<int32_t> (handle, value);
+}
+
+DLLEXPORT double write_float(double handle, double value) {
+	FCT_TRACE_API();
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		writable->writeFloat(value);
+	}
+	return 0;
+}
+
+DLLEXPORT double write_double(double handle, double value) {
+	FCT_TRACE_API();
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		writable->writeDouble(value);
+	}
+	return 0;
+}
+
+DLLEXPORT double write_string(double handle, const char *str) {
+	FCT_TRACE_API();
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		size_t size = strlen(str);
+		writable->write(reinterpret_cast<const uint8_t *> (str), size);
+	}
+	return 0;
+}
+
+/**
+ * DO NOT pass the empty string for str, the length prefix of that is broken in GM8!
+ */
+DLLEXPORT double _fnet_hidden_write_binary_string(double handle, const char *str) {
+	FCT_TRACE_API();
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		size_t size = GM8_STRLEN(str);
+		writable->write(reinterpret_cast<const uint8_t *> (str), size);
+	}
+	return 0;
+}
+
+DLLEXPORT double write_buffer_part(double destHandle, double bufferHandle, double ammount) {
+	FCT_TRACE_API();
+	auto dest = handles.find<ReadWritable> (destHandle);
+	auto source = handles.find<ReadWritable> (bufferHandle);
+
+	size_t intAmmount = clipped_cast<size_t> (ammount);
+
+	if (dest && source) {
+		uint8_t tempBuffer[4096];
+		intAmmount = std::min(intAmmount, source->bytesRemaining());
+		size_t fullBuffers = intAmmount/4096;
+		size_t lastBuffer = intAmmount%4096;
+		for(size_t i=0; i<fullBuffers; i++) {
+			source->read(tempBuffer, 4096);
+			dest->write(tempBuffer, 4096);
+		}
+		source->read(tempBuffer, lastBuffer);
+		dest->write(tempBuffer, lastBuffer);
+		return intAmmount;
+	}
+	return 0;
+}
+
+// Attn: Do not take the shortcut of writing directly from src to dest if they might be the same buffer. vector doesn't like inserting into itself.
+DLLEXPORT double write_buffer(double destHandle, double bufferHandle) {
+	FCT_TRACE_API();
+	auto dest = handles.find<ReadWritable> (destHandle);
+	auto src = handles.lookup(bufferHandle);
+	auto srcBuffer = src.as<Buffer>();
+	auto srcSocket = src.as<Socket>();
+
+	if (dest && srcBuffer) {
+		size_t oldReadPos = srcBuffer->size()-srcBuffer->bytesRemaining();
+		srcBuffer->setReadpos(0);
+		write_buffer_part(destHandle, bufferHandle, srcBuffer->size());
+		srcBuffer->setReadpos(oldReadPos);
+	} else if (dest && srcSocket) {
+		dest->write(srcSocket->getReceiveBuffer().getData(),
+				srcSocket->getReceiveBuffer().size());
+	}
+	return 0;
+}
+
+DLLEXPORT double write_hex(double destHandle, const char *hexStr) {
+	FCT_TRACE_API();
+
+    auto dest = handles.find<ReadWritable> (destHandle);
+
+    if (!dest)
+        return -1;
+
+    return hexCodec.writeHex(hexStr, *dest);
+}
+
+DLLEXPORT double write_base64(double destHandle, const char *hexStr) {
+	FCT_TRACE_API();
+
+    auto dest = handles.find<ReadWritable> (destHandle);
+
+    if (!dest)
+        return -1;
+
+    return base64Codec.writeBase64(hexStr, *dest);
+}
+
+DLLEXPORT double tcp_receive(double socketHandle, double size) {
+	FCT_TRACE_API();
+	auto socket = handles.find<TcpSocket> (socketHandle);
+	if (socket) {
+		size_t intSize;
+		try {
+			intSize = numeric_cast<size_t> (size);
+		} catch (bad_numeric_cast &e) {
+			return false;
+		}
+		return socket->receive(intSize);
+	} else {
+		return false;
+	}
+}
+
+DLLEXPORT double tcp_receive_available(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<TcpSocket> (socketHandle);
+	if (socket) {
+		return socket->receive();
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double tcp_eof(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<TcpSocket> (socketHandle);
+	if (socket) {
+		return socket->isEof();
+	} else {
+		return true;
+	}
+}
+
+// TODO rename to tcp_send in 2.0
+DLLEXPORT double socket_send(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<TcpSocket> (socketHandle);
+	if (socket) {
+		socket->send();
+	}
+	return 0;
+}
+
+DLLEXPORT double socket_sendbuffer_size(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (socketHandle);
+	if (socket) {
+		return socket->getSendbufferSize();
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double socket_receivebuffer_size(double socketHandle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (socketHandle);
+	if (socket) {
+		return socket->getReceivebufferSize();
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * Read one of the cumulative statistics of a socket, or the global statistics
+ * of all sockets if the handle is 0. The stat ids are those of StatId in SocketStats.hpp.
+ */
+DLLEXPORT double socket_stats(double socketHandle, double stat) {
+	FCT_TRACE_API();
+	if(!(stat >= 0 && stat < STAT_COUNT)) {
+		return 0;
+	}
+	StatId statId = static_cast<StatId>(static_cast<int>(stat));
+	if(socketHandle == 0) {
+		return SocketStats::global().get(statId);
+	}
+
+	auto socket = handles.find<Socket> (socketHandle);
+	if (socket) {
+		return socket->getStats().get(statId);
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * Return the given percentile (0-100) of a latency histogram of a socket in
+ * microseconds, or of all sockets if the handle is 0. The histograms are
+ * 0 for the time data waits in the send queue, 1 for the time from starting
+ * a send until the data is handed to the OS, and 2 for UDP hostname lookups.
+ */
+DLLEXPORT double socket_latency(double socketHandle, double latency, double percentile) {
+	FCT_TRACE_API();
+	if(!(latency >= 0 && latency < LATENCY_COUNT)) {
+		return 0;
+	}
+	LatencyId latencyId = static_cast<LatencyId>(static_cast<int>(latency));
+	if(socketHandle == 0) {
+		return SocketStats::global().getLatencyPercentile(latencyId, percentile);
+	}
+
+	auto socket = handles.find<Socket> (socketHandle);
+	if (socket) {
+		return socket->getStats().getLatencyPercentile(latencyId, percentile);
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double socket_sendbuffer_limit(double socketHandle, double sizeLimit) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (socketHandle);
+	if (socket) {
+		size_t intSize = clipped_cast<size_t> (sizeLimit);
+		if (intSize == 0) {
+			intSize = std::numeric_limits<size_t>::max();
+		}
+		socket->setSendbufferLimit(intSize);
+	}
+	return 0;
+}
+
+/*********************************************
+ * Reliable UDP connection functions
+ */
+
+/**
+ * Create a reliable connection to the host, using a new UDP socket bound to
+ * localPort (0 for any). The peer has to create a connection as well.
+ */
+DLLEXPORT double rudp_connect(double localPort, const char *host, double port) {
+	FCT_TRACE_API();
+	uint16_t intLocalPort, intPort;
+	try {
+		intLocalPort = numeric_cast<uint16_t> (localPort);
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+
+	if (intPort == 0) {
+		boost::system::error_code error = boost::asio::error::make_error_code(
+				boost::asio::error::invalid_argument);
+		return handles.allocate(ReliableUdpConnection::error(error.message()));
+	} else {
+		return handles.allocate(ReliableUdpConnection::connect(intLocalPort, host, intPort));
+	}
+}
+
+/**
+ * Set how messages sent on the channel are delivered: 0 for reliable and ordered,
+ * 1 for reliable in any order, 2 for unreliable, dropping messages which arrive
+ * after a newer one.
+ */
+DLLEXPORT double rudp_channel_mode(double handle, double channel, double mode) {
+	FCT_TRACE_API();
+	auto connection = handles.find<ReliableUdpConnection>(handle);
+	if (connection && (mode == ReliableUdpConnection::RELIABLE_ORDERED
+			|| mode == ReliableUdpConnection::RELIABLE_UNORDERED
+			|| mode == ReliableUdpConnection::UNRELIABLE_SEQUENCED)) {
+		return connection->setChannelMode(clipped_cast<size_t>(channel),
+				static_cast<ReliableUdpConnection::ChannelMode>(static_cast<int>(mode)));
+	}
+	return false;
+}
+
+/**
+ * Send the content of the send buffer as one message on the channel. Returns false
+ * if the message is too large, the channel is invalid or the send buffer limit has
+ * been reached.
+ */
+DLLEXPORT double rudp_send(double handle, double channel) {
+	FCT_TRACE_API();
+	auto connection = handles.find<ReliableUdpConnection>(handle);
+	if (connection) {
+		return connection->send(clipped_cast<size_t>(channel));
+	}
+	return false;
+}
+
+DLLEXPORT double rudp_receive(double handle) {
+	FCT_TRACE_API();
+	auto connection = handles.find<ReliableUdpConnection>(handle);
+	if (connection) {
+		return connection->receive();
+	}
+	return false;
+}
+
+DLLEXPORT double rudp_receive_channel(double handle) {
+	FCT_TRACE_API();
+	auto connection = handles.find<ReliableUdpConnection>(handle);
+	if (connection) {
+		return connection->getReceiveChannel();
+	}
+	return 0;
+}
+
+DLLEXPORT double rudp_rtt(double handle) {
+	FCT_TRACE_API();
+	auto connection = handles.find<ReliableUdpConnection>(handle);
+	if (connection) {
+		return connection->getRoundTripTime();
+	}
+	return 0;
+}
+
+/*********************************************
+ * Buffer functions
+ */
+
+DLLEXPORT double buffer_create() {
+	FCT_TRACE_API();
+	auto newBuffer = std::make_shared<Buffer>();
+	return handles.allocate(newBuffer);
+}
+
+DLLEXPORT double buffer_destroy(double handle) {
+	FCT_TRACE_API();
+	auto buffer = handles.find<Buffer> (handle);
+	if (buffer) {
+		handles.release(handle);
+	}
+	return 0;
+}
+
+DLLEXPORT double buffer_clear(double handle) {
+	FCT_TRACE_API();
+	auto buffer = handles.find<Buffer> (handle);
+	if (buffer) {
+		buffer->clear();
+	}
+	return 0;
+}
+
+DLLEXPORT double buffer_size(double handle) {
+	FCT_TRACE_API();
+	auto buffer = handles.find<Buffer> (handle);
+	if (buffer) {
+		return buffer->size();
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double buffer_bytes_left(double handle) {
+	FCT_TRACE_API();
+	auto readWritable = handles.find<ReadWritable> (handle);
+	if (readWritable) {
+		return readWritable->bytesRemaining();
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double buffer_set_readpos(double handle, double newPos) {
+	FCT_TRACE_API();
+	auto readWritable = handles.find<ReadWritable> (handle);
+	if (readWritable) {
+		readWritable->setReadpos(clipped_cast<size_t> (newPos));
+	}
+	return 0;
+}
+
+template<typename DesiredType>
+static double readValue(double handle) {
+	auto readWritable = handles.find<ReadWritable> (handle);
+	if (readWritable) {
+		return readWritable->readValue<DesiredType> ();
+	} else {
+		return 0;
+	}
+}
+
+DLLEXPORT double read_ubyte(double handle) {
+	FCT_TRACE_API();
+	return readValue<uint8_t> (handle);
+}
+
+DLLEXPORT double read_byte(double handle) {
+	FCT_TRACE_API();
+	return readValue<int8_t> (handle);
+}
+
+DLLEXPORT double read_ushort(double handle) {
+	FCT_TRACE_API();
+	return readValue<uint16_t> (handle);
+}
+
+DLLEXPORT double read_short(double handle) {
+	FCT_TRACE_API();
+	return readValue<int16_t> (handle);
+}
+
+DLLEXPORT double read_uint(double handle) {
+	FCT_TRACE_API();
+	return readValue<uint32_t> (handle);
+}
+
+DLLEXPORT double read_int(double handle) {
+	FCT_TRACE_API();
+	return readValue<int32_t> (handle);
+}
+
+DLLEXPORT double read_float(double handle) {
+	FCT_TRACE_API();
+	return readValue<float> (handle);
+}
+
+DLLEXPORT double read_double(double handle) {
+	FCT_TRACE_API();
+	return readValue<double> (handle);
+}
+
+DLLEXPORT const char *read_string(double handle, double len) {
+	FCT_TRACE_API();
+	auto readWritable = handles.find<ReadWritable> (handle);
+	if (readWritable) {
+		return replaceStringReturnBuffer(readWritable->readString(clipped_cast<size_t> (len)));
+	} else {
+		return "";
+	}
+}
+
+/**
+ * Fills the GM-string outstr with the following bytes of the given ReadWritable
+ * DO NOT pass the empty string for outstr, the length prefix of that is broken in GM8!
+ */
+DLLEXPORT double _fnet_hidden_read_binary_string(double handle, char *outstr) {
+	FCT_TRACE_API();
+	auto buffer = getBufferOrReceiveBuffer(handle);
+	if (buffer) {
+		return buffer->read(reinterpret_cast<uint8_t*>(outstr), GM8_STRLEN(outstr));
+	}
+
+    return 0;
+}
+
+/**
+ * Skips as many bytes of the given ReadWritable as the length of skip.
+ * DO NOT pass the empty string for skip, the length prefix of that is broken in GM8!
+ */
+DLLEXPORT double _fnet_hidden_skip_length_of_string(double handle, char *skip) {
+	FCT_TRACE_API();
+	auto buffer = getBufferOrReceiveBuffer(handle);
+	if (buffer) {
+        buffer->setReadpos(buffer->getReadpos() + GM8_STRLEN(skip));
+	}
+
+    return 0;
+}
+
+static double bytesBeforeDelimiter(Buffer *buffer, const char *delimStart, const char *delimEnd) {
+	if(buffer) {
+        const char* bufStart = reinterpret_cast<const char*>(buffer->getData());
+        const char* bufReadPtr = bufStart + buffer->getReadpos();
+        const char* bufEnd = bufStart + buffer->size();
+
+        const char* delimInBuf = std::search(bufReadPtr, bufEnd, delimStart, delimEnd);
+        if(delimInBuf != bufEnd) {
+            return delimInBuf-bufReadPtr;
+        }
+	}
+
+	return -1;
+}
+
+DLLEXPORT double _fnet_hidden_bytes_before_delimiter(double handle, const char *needle) {
+	FCT_TRACE_API();
+    auto buffer = getBufferOrReceiveBuffer(handle);
+    return bytesBeforeDelimiter(buffer.get(), needle, needle+GM8_STRLEN(needle));
+}
+
+static const char *readDelimitedString(double handle, const char *delimStart, const char *delimEnd) {
+    auto buffer = getBufferOrReceiveBuffer(handle);
+    double length = bytesBeforeDelimiter(buffer.get(), delimStart, delimEnd);
+    if(length >= 0) {
+        const char *result = replaceStringReturnBuffer(buffer->readString(length));
+        size_t delimLen = delimEnd-delimStart;
+        buffer->setReadpos(buffer->getReadpos() + delimLen);
+        return result;
+    }
+
+    return "";
+}
+
+DLLEXPORT const char *_fnet_hidden_read_delimited_string(double handle, const char *delimiter) {
+	FCT_TRACE_API();
+	return readDelimitedString(handle, delimiter, delimiter+strlen(delimiter));
+}
+
+DLLEXPORT const char *_fnet_hidden_read_cstring(double handle) {
+	FCT_TRACE_API();
+	const char delimiter = 0;
+	return readDelimitedString(handle, &delimiter, (&delimiter)+1);
+}
+
+DLLEXPORT const char *read_hex(double srcHandle, double dLen) {
+	FCT_TRACE_API();
+
+    auto src = getBufferOrReceiveBuffer(srcHandle);
+    size_t len = clipped_cast<size_t>(dLen);
+    if(src)
+        return replaceStringReturnBuffer(hexCodec.readHex(*src, len));
+    return "";
+}
+
+DLLEXPORT const char *read_base64(double srcHandle, double dLen) {
+	FCT_TRACE_API();
+
+	auto src = getBufferOrReceiveBuffer(srcHandle);
+    size_t len = clipped_cast<size_t>(dLen);
+	if (src)
+        return replaceStringReturnBuffer(base64Codec.readBase64(*src, len));
+    return "";
+}
+
+// Read the entire file, appending it to the end of the buffer
+DLLEXPORT double append_file_to_buffer(double handle, const char *filename) {
+	FCT_TRACE_API();
+	auto readWritable = handles.find<ReadWritable> (handle);
+	if (!readWritable) {
+		return -10;
+	}
+
+	FILE *f = fopen(filename, "rb");
+	if(f == NULL) {
+		return -1;	// File not found
+	}
+	fseek(f, 0, SEEK_END);
+	long signedSize = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if(signedSize < 0) {
+		fclose(f);
+		return -2;	// File too large
+	}
+
+	size_t size = signedSize;
+	uint8_t *tempBuffer = (uint8_t*)malloc(size);
+	if(tempBuffer == 0) {
+		fclose(f);
+		return -3; // Not enough memory
+	}
+
+	if(fread(tempBuffer, sizeof(uint8_t), size, f) != size) {
+		free(tempBuffer);
+		fclose(f);
+		return -4; // Read error
+	}
+
+	readWritable->write(tempBuffer, size);
+
+	free(tempBuffer);
+	fclose(f);
+	return 1;	// Success
+}
+
+// Overwrite or create the file provided with the contents of the buffer
+DLLEXPORT double write_buffer_to_file(double handle, const char *filename) {
+	FCT_TRACE_API();
+	auto src = getBufferOrReceiveBuffer(handle);
+
+	if(!src) {
+		return -10;
+	}
+
+	Buffer &srcBuffer = *src;
+
+	FILE *f = fopen(filename, "wb");
+	if(f == NULL) {
+		return -1;	// Cannot open file
+	}
+
+	if(fwrite(srcBuffer.getData(), sizeof(uint8_t), srcBuffer.size(), f) != srcBuffer.size()) {
+		fclose(f);
+		return -2;	// I/O-Error writing to the file
+	} else {
+		fclose(f);
+		return 1; // Success
+	}
+}
+
+/**
+ * UDP
+ */
+
+// defaultUdpSocketMutex must be locked
+static std::shared_ptr<UdpSocket> getDefaultUdpSocket() {
+	if(!defaultUdpSocket) {
+		defaultUdpSocket = UdpSocket::bind(0);
+	}
+	return defaultUdpSocket;
+}
+
+/**
+ * If the handle refers to a buffer, its contents are written to the default UDP socket
+ * and that socket is returned. The lock is then held until the caller is done with the
+ * socket, so that datagrams from different threads are not mixed up.
+ */
+static std::shared_ptr<UdpSocket> getUdpSocketOrPrepareDefaultSocket(double handle, DefaultUdpSocketLock &lock) {
+	auto buffer = handles.find<Buffer> (handle);
+	if(buffer) {
+		lock.lock();
+		auto defaultSocket = getDefaultUdpSocket();
+		defaultSocket->write(buffer->getData(), buffer->size());
+		return defaultSocket;
+	}
+
+	return handles.find<UdpSocket>(handle);
+}
+
+DLLEXPORT double udp_send(double handle, const char *host, double port) {
+	FCT_TRACE_API();
+	uint16_t intPort;
+	try {
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+
+	if (intPort == 0) {
+		return false;
+	}
+
+	DefaultUdpSocketLock lock(defaultUdpSocketMutex, boost::defer_lock);
+	auto sock = getUdpSocketOrPrepareDefaultSocket(handle, lock);
+	if(sock) {
+		return sock->send(host, intPort);
+	}
+	return false;
+}
+
+DLLEXPORT double udp_broadcast(double handle, double port) {
+	FCT_TRACE_API();
+	uint16_t intPort;
+	try {
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+
+	if (intPort == 0) {
+		return false;
+	}
+
+	DefaultUdpSocketLock lock(defaultUdpSocketMutex, boost::defer_lock);
+	auto sock = getUdpSocketOrPrepareDefaultSocket(handle, lock);
+	if(sock) {
+		return sock->broadcast(intPort);
+	}
+	return false;
+}
+
+/**
+ * Connect the UDP socket to a single peer. The host is resolved once, and afterwards
+ * udp_send_connected sends to it without any lookup. The OS discards datagrams from
+ * other senders. Sending to other destinations with udp_send or udp_broadcast may
+ * fail on some platforms while the socket is connected.
+ */
+DLLEXPORT double udp_connect(double handle, const char *host, double port) {
+	FCT_TRACE_API();
+	uint16_t intPort;
+	try {
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock && intPort != 0) {
+		sock->connect(host, intPort);
+		return true;
+	}
+	return false;
+}
+
+DLLEXPORT double udp_send_connected(double handle) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->sendToPeer();
+	}
+	return false;
+}
+
+/**
+ * Return 1 if the socket is connected to its peer, 0 while the peer is being
+ * resolved and -1 if the socket is not connected.
+ */
+DLLEXPORT double udp_connected(double handle) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		switch(sock->getPeerState()) {
+		case UdpSocket::PEER_CONNECTED:
+			return 1;
+		case UdpSocket::PEER_RESOLVING:
+			return 0;
+		default:
+			break;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Split messages larger than maxDatagramSize into several datagrams and reassemble
+ * them on the receiving side, or disable this with 0. Both sides need to enable it,
+ * since it adds a header to every datagram.
+ */
+DLLEXPORT double udp_fragmentation(double handle, double maxDatagramSize) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		sock->setFragmentation(clipped_cast<size_t>(maxDatagramSize));
+		return true;
+	}
+	return false;
+}
+
+/**
+ * The path MTU to the peer of a connected socket, or 0 if it is not known.
+ */
+DLLEXPORT double udp_path_mtu(double handle) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->getPathMtu();
+	}
+	return 0;
+}
+
+/**
+ * Join an IPv4 or IPv6 multicast group, given as IP address. To receive the group's
+ * datagrams, the socket has to be bound to the port they are sent to.
+ */
+DLLEXPORT double udp_join_group(double handle, const char *group) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->joinGroup(group);
+	}
+	return false;
+}
+
+DLLEXPORT double udp_leave_group(double handle, const char *group) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->leaveGroup(group);
+	}
+	return false;
+}
+
+DLLEXPORT double udp_send_group(double handle, const char *group, double port) {
+	FCT_TRACE_API();
+	uint16_t intPort;
+	try {
+		intPort = numeric_cast<uint16_t> (port);
+	} catch (bad_numeric_cast &e) {
+		intPort = 0;
+	}
+
+	if (intPort == 0) {
+		return false;
+	}
+
+	DefaultUdpSocketLock lock(defaultUdpSocketMutex, boost::defer_lock);
+	auto sock = getUdpSocketOrPrepareDefaultSocket(handle, lock);
+	if(sock) {
+		return sock->sendGroup(group, intPort);
+	}
+	return false;
+}
+
+/**
+ * Set the TTL / hop limit of multicast datagrams sent from the socket. The default
+ * of 1 keeps them on the local network.
+ */
+DLLEXPORT double udp_multicast_ttl(double handle, double ttl) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->setMulticastHops(clipped_cast<uint8_t>(ttl));
+	}
+	return false;
+}
+
+/**
+ * Set whether multicast datagrams sent from the socket are also delivered
+ * to sockets on the same host which joined the group. Enabled by default.
+ */
+DLLEXPORT double udp_multicast_loopback(double handle, double enabled) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		return sock->setMulticastLoopback(enabled != 0);
+	}
+	return false;
+}
+
+/**
+ * While a socket is corked, datagrams are queued without sending them. Uncorking
+ * sends them in batches, which is cheaper when sending many datagrams at once.
+ */
+DLLEXPORT double udp_cork(double handle, double corked) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		sock->setCorked(corked != 0);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Set what is discarded when a UDP socket's send or receive queue is full:
+ * 0 drops the oldest datagrams, 1 the new one, 2 the oldest datagram of the
+ * endpoint with the most queued data, and 3 the oldest datagram with the
+ * lowest priority set by udp_send_priority.
+ */
+DLLEXPORT double udp_drop_policy(double handle, double policy) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock && policy >= DROP_OLDEST && policy <= DROP_PRIORITY) {
+		sock->setDropPolicy(static_cast<DropPolicy>(static_cast<int>(policy)));
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Set the priority (0-255) of datagrams sent from the socket from now on.
+ * Only used with drop policy 3, where higher priorities are kept longer.
+ */
+DLLEXPORT double udp_send_priority(double handle, double priority) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		sock->setSendPriority(clipped_cast<uint8_t>(priority));
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Read a cumulative counter of a UDP socket's queues:
+ * 0/1: datagrams/bytes received into the receive queue
+ * 2/3: datagrams/bytes dropped from the receive queue
+ * 4: largest amount of memory held by the receive queue
+ * 5/6: datagrams/bytes sent into the send queue
+ * 7/8: datagrams/bytes dropped from the send queue
+ * 9: largest amount of memory held by the send queue
+ * 10: endpoint id of the sender of the last dropped received datagram
+ */
+DLLEXPORT double udp_queue_stat(double handle, double stat) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(!sock) {
+		return 0;
+	}
+
+	DatagramQueueCounters receive = sock->getReceiveQueueCounters();
+	DatagramQueueCounters send = sock->getSendQueueCounters();
+	switch(static_cast<int>(stat)) {
+	case 0: return receive.pushedDatagrams;
+	case 1: return receive.pushedBytes;
+	case 2: return receive.droppedDatagrams;
+	case 3: return receive.droppedBytes;
+	case 4: return receive.highWaterMark;
+	case 5: return send.pushedDatagrams;
+	case 6: return send.pushedBytes;
+	case 7: return send.droppedDatagrams;
+	case 8: return send.droppedBytes;
+	case 9: return send.highWaterMark;
+	case 10:
+		if(receive.droppedDatagrams == 0) {
+			return 0;
+		}
+		return getEndpointId(receive.lastDropped.address(), receive.lastDropped.port());
+	default:
+		return 0;
+	}
+}
+
+DLLEXPORT double udp_receive(double handle) {
+	FCT_TRACE_API();
+	auto entry = handles.lookup(handle);
+	auto sock = entry.as<UdpSocket>();
+	if(sock) {
+		return sock->receive();
+	}
+	auto peer = entry.as<UdpPeer>();
+	if(peer) {
+		return peer->receive();
+	}
+	return false;
+}
+
+/**
+ * Give every sender its own receive queue, limited to peerQueueLimit bytes,
+ * or disable this with 0. Datagrams from a new sender create a peer handle,
+ * which is taken with udp_accept_peer, and an EVENT_ACCEPTED event for the socket.
+ */
+DLLEXPORT double udp_demultiplex(double handle, double peerQueueLimit) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		sock->setDemultiplexing(clipped_cast<size_t>(peerQueueLimit));
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Return the handle of the next new peer, or -1 if there is none. Datagrams from
+ * the peer are read with udp_receive on the peer handle, which should be called
+ * right after accepting since datagrams may already be waiting. Datagrams written
+ * to the peer are sent to it with udp_send_peer. They go through the send queue of
+ * the socket, so socket_sendbuffer_limit has no effect on peer handles; set the
+ * limit on the socket instead.
+ */
+DLLEXPORT double udp_accept_peer(double handle) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	if(sock) {
+		auto peer = sock->acceptPeer();
+		if(peer) {
+			return handles.allocate(peer);
+		}
+	}
+	return -1;
+}
+
+DLLEXPORT double udp_send_peer(double handle) {
+	FCT_TRACE_API();
+	auto peer = handles.find<UdpPeer>(handle);
+	if(peer) {
+		return peer->send();
+	}
+	return false;
+}
+
+DLLEXPORT double udp_peer_received(double handle) {
+	FCT_TRACE_API();
+	auto peer = handles.find<UdpPeer>(handle);
+	if(peer) {
+		return peer->getReceivedCount();
+	}
+	return 0;
+}
+
+/**
+ * The number of datagrams from the peer which were dropped because its queue was full.
+ */
+DLLEXPORT double udp_peer_dropped(double handle) {
+	FCT_TRACE_API();
+	auto peer = handles.find<UdpPeer>(handle);
+	if(peer) {
+		return peer->getDroppedCount();
+	}
+	return 0;
+}
+
+/**
+ * Append up to maxCount received datagrams to the buffer and return how many were
+ * appended. Each datagram is written as its size (uint32, read it with read_uint),
+ * the id of its sender as returned by socket_remote_endpoint_id (double) and the
+ * sender's port (uint16), followed by the data. The socket's receive buffer is not
+ * changed.
+ */
+DLLEXPORT double udp_receive_batch(double handle, double bufferHandle, double maxCount) {
+	FCT_TRACE_API();
+	auto sock = handles.find<UdpSocket>(handle);
+	auto buffer = handles.find<Buffer>(bufferHandle);
+	if(sock && buffer) {
+		return sock->receiveBatch(*buffer, clipped_cast<size_t>(maxCount));
+	}
+	return 0;
+}
+
+/**
+ * Generic functions
+ */
+
+DLLEXPORT double debug_handles() {
+	FCT_TRACE_API();
+	return handles.size();
+}
+
+/**
+ * Append all statistics to the buffer and return the number of records written.
+ * The data starts with the number of stats per record (uint16). Each record is a
+ * handle (uint32) followed by the values (double each). The first record has the
+ * handle 0 and holds the global statistics, followed by one record per socket.
+ */
+DLLEXPORT double stats_dump(double bufferHandle) {
+	FCT_TRACE_API();
+	auto buffer = handles.find<Buffer>(bufferHandle);
+	if(!buffer) {
+		return 0;
+	}
+
+	buffer->writeIntValue<uint16_t>(STAT_COUNT);
+	auto writeRecord = [buffer](uint32_t handle, const SocketStats &stats) {
+		buffer->writeIntValue<uint32_t>(handle);
+		for(size_t i = 0; i < STAT_COUNT; ++i) {
+			buffer->writeDouble(stats.get(static_cast<StatId>(i)));
+		}
+	};
+
+	writeRecord(0, SocketStats::global());
+	size_t records = 1;
+	handles.forEach<Socket>([&](uint32_t handle, Socket *socket) {
+		writeRecord(handle, socket->getStats());
+		++records;
+	});
+	return records;
+}
+
+/**
+ * Start or stop recording trace events. Returns false if the extension was
+ * built without FAUCET_TRACE, in which case no events are ever recorded.
+ */
+DLLEXPORT double trace_enable(double enabled) {
+#ifdef FAUCET_TRACE
+	Trace::setEnabled(enabled != 0);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Write the recorded trace events to a file, see Trace.hpp.
+ */
+DLLEXPORT double trace_dump(const char *filename) {
+#ifdef FAUCET_TRACE
+	return Trace::dump(filename);
+#else
+	return false;
+#endif
+}
+
+DLLEXPORT double set_little_endian_global(double littleEndian) {
+	FCT_TRACE_API();
+	ReadWritable::setLittleEndianDefault(littleEndian);
+	return 0;
+}
+
+DLLEXPORT double set_little_endian(double handle, double littleEndian) {
+	FCT_TRACE_API();
+	auto writable = handles.find<ReadWritable> (handle);
+	if (writable) {
+		writable->setLittleEndian(littleEndian);
+	}
+	return 0;
+}
+
+DLLEXPORT const char* socket_remote_ip(double handle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (handle);
+	if (socket) {
+		return replaceStringReturnBuffer(socket->getRemoteIp());
+	}
+	return "";
+}
+
+DLLEXPORT double socket_local_port(double handle) {
+	FCT_TRACE_API();
+	auto entry = handles.lookup(handle);
+	auto socket = entry.as<Socket>();
+	if (socket) {
+		return socket->getLocalPort();
+	}
+
+	auto acceptor = entry.as<CombinedTcpAcceptor>();
+	if(acceptor) {
+		return acceptor->getLocalPort();
+	}
+
+	return 0;
+}
+
+DLLEXPORT double socket_remote_port(double handle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (handle);
+	if (socket) {
+		return socket->getRemotePort();
+	}
+	return 0;
+}
+
+/**
+ * Return a number which identifies the remote address and port of the socket,
+ * or of the sender of the last datagram received on a UDP socket. Use this
+ * to tell peers apart instead of comparing IP strings. 0 if there is no
+ * remote endpoint.
+ */
+DLLEXPORT double socket_remote_endpoint_id(double handle) {
+	FCT_TRACE_API();
+	auto socket = handles.find<Socket> (handle);
+	if (socket) {
+		return socket->getRemoteEndpointId();
+	}
+	return 0;
+}
+
+DLLEXPORT double ip_lookup_create(const char *host) {
+	FCT_TRACE_API();
+	return handles.allocate(IpLookup::lookup(host));
+}
+
+DLLEXPORT double ipv4_lookup_create(const char *host) {
+	FCT_TRACE_API();
+	return handles.allocate(IpLookup::lookup(host, fct_lookup_protocol::V4));
+}
+
+DLLEXPORT double ipv6_lookup_create(const char *host) {
+	FCT_TRACE_API();
+	return handles.allocate(IpLookup::lookup(host, fct_lookup_protocol::V6));
+}
+
+/**
+ * Configure the cache for hostname lookups, which is used for connecting, sending
+ * and lookups alike. Found addresses are kept for positiveTtl seconds, failed
+ * lookups for negativeTtl seconds. A maxEntries value of 0 disables the cache.
+ */
+DLLEXPORT double dns_cache_configure(double positiveTtl, double negativeTtl, double maxEntries) {
+	FCT_TRACE_API();
+	ResolveCache::configure(clipped_cast<uint32_t>(positiveTtl), clipped_cast<uint32_t>(negativeTtl),
+			clipped_cast<size_t>(maxEntries));
+	return 0;
+}
+
+DLLEXPORT double dns_cache_clear() {
+	FCT_TRACE_API();
+	ResolveCache::clear();
+	return 0;
+}
+
+DLLEXPORT double ip_lookup_ready(double lookupHandle) {
+	FCT_TRACE_API();
+	auto lookup = handles.find<IpLookup>(lookupHandle);
+	if(lookup) {
+		return lookup->ready();
+	} else {
+		/*
+		 * We return true here to prevent a lockup in infinite loops waiting for
+		 * the lookup to finish.
+		 */
+		return true;
+	}
+}
+
+DLLEXPORT double ip_lookup_has_next(double lookupHandle) {
+	FCT_TRACE_API();
+	auto lookup = handles.find<IpLookup>(lookupHandle);
+	if(lookup) {
+		return lookup->hasNext();
+	}
+	return false;
+}
+
+DLLEXPORT const char *ip_lookup_next_result(double lookupHandle) {
+	FCT_TRACE_API();
+	auto lookup = handles.find<IpLookup>(lookupHandle);
+	if(lookup) {
+		return replaceStringReturnBuffer(lookup->nextResult());
+	}
+	return "";
+}
+
+DLLEXPORT double ip_lookup_destroy(double lookupHandle) {
+	FCT_TRACE_API();
+	auto lookup = handles.find<IpLookup>(lookupHandle);
+	if(lookup) {
+		handles.release(lookupHandle);
+	}
+	return 0;
+}
+
+DLLEXPORT double ip_is_v4(const char *ip) {
+	FCT_TRACE_API();
+	boost::system::error_code ec;
+	boost::asio::ip::address_v4::from_string(ip, ec);
+
+	if(!ec) {
+		return true;
+	} else {
+		return false;
+	}
+}
+
+DLLEXPORT double ip_is_v6(const char *ip) {
+	FCT_TRACE_API();
+	boost::system::error_code ec;
+	boost::asio::ip::address_v6::from_string(ip, ec);
+
+	if(!ec) {
+		return true;
+	} else {
+		return false;
+	}
+}
+
+/**
+ * Events
+ *
+ * Once enabled, the IO thread reports what happens on sockets, acceptors and lookups
+ * to a single queue, so the game doesn't need to poll every handle. Readable events
+ * are only repeated after the socket has been read from, so keep receiving until
+ * nothing is left. Sockets created before the queue was enabled only start
+ * reporting readable events after they have been read from once.
+ */
+
+boost::thread_specific_ptr<uint32_t> lastEventHandle;
+
+DLLEXPORT double event_enable(double enable) {
+	FCT_TRACE_API();
+	EventQueue::setEnabled(enable >= 0.5);
+	return 0;
+}
+
+/**
+ * Take the next event from the queue and return its type, or 0 if the queue is empty.
+ * The handle the event refers to can then be retrieved with event_handle().
+ */
+DLLEXPORT double event_next() {
+	FCT_TRACE_API();
+	uint32_t handle;
+	EventType type = EventQueue::pop(handle);
+	if(!lastEventHandle.get()) {
+		lastEventHandle.reset(new uint32_t);
+	}
+	*lastEventHandle = handle;
+	return type;
+}
+
+DLLEXPORT double event_handle() {
+	FCT_TRACE_API();
+	if(lastEventHandle.get()) {
+		return *lastEventHandle;
+	}
+	return 0;
+}
+
+DLLEXPORT double event_count() {
+	FCT_TRACE_API();
+	return EventQueue::size();
+}
+
+/**
+ * Block until an event is available or the timeout (in milliseconds) has passed,
+ * and return the number of available events. Not useful from Game Maker, since
+ * the game would freeze, but native hosts can sleep on it.
+ */
+DLLEXPORT double event_wait(double timeout) {
+	FCT_TRACE_API();
+	return EventQueue::wait(clipped_cast<uint32_t>(timeout));
+}
+
+/**
+ * Some bit manipulation functions. They are pure functions, so no locking is required.
+ */
+DLLEXPORT double bit_get(double source, double bitnum) {
+	FCT_TRACE_API();
+	int8_t intbitnum = clipped_cast<int8_t>(bitnum);
+	if(intbitnum < 0 || intbitnum > 63) {
+		return 0;
+	}
+
+	int64_t intsource = clipped_cast<int64_t>(source);
+	return (intsource & ((static_cast<int64_t>(1))<<intbitnum)) != 0 ? 1 : 0;
+}
+
+DLLEXPORT double bit_set(double source, double bitnum, double value) {
+	FCT_TRACE_API();
+	int8_t intbitnum = clipped_cast<int8_t>(bitnum);
+	if(intbitnum < 0 || intbitnum > 63) {
+		return source;
+	}
+
+	int64_t intsource = clipped_cast<int64_t>(source);
+	if(value>=0.5) {
+		return intsource |= (static_cast<int64_t>(1) << intbitnum);
+	} else {
+		return intsource &= ~(static_cast<int64_t>(1) << intbitnum);
+	}
+}
+
+static uint8_t build_bit(double in, uint8_t place) {
+	return in>=0.5 ? (1<<place) : 0;
+}
+
+DLLEXPORT double build_ubyte(double b7, double b6, double b5, double b4, double b3, double b2, double b1, double b0) {
+	FCT_TRACE_API();
+	return build_bit(b7,7) | build_bit(b6,6) | build_bit(b5,5) | build_bit(b4,4) | build_bit(b3,3) | build_bit(b2,2) | build_bit(b1,1) | build_bit(b0,0);
+}
@@ -1,106 +1,163 @@
-#include "CombinedTcpAcceptor.hpp"
-#include <faucet/tcp/TcpAcceptor.hpp>
-
-using namespace boost::asio::ip;
-
-CombinedTcpAcceptor::CombinedTcpAcceptor(uint16_t port) :
-		v4Acceptor_(),
-		v6Acceptor_(),
-		checkV6First_(false),
-		localPort_(port) {
-
-	auto v4acceptor = std::make_shared<tcp::acceptor>(Asio::getIoService());
-	auto v6acceptor = std::make_shared<tcp::acceptor>(Asio::getIoService());
-	boost::system::error_code ignoredError, v4Error, v6Error;
-
-	if (localPort_ == 0) {
-		try {
-			tcp::acceptor dualstack_placeholder(Asio::getIoService());
-			dualstack_placeholder.open(tcp::v6());
-			dualstack_placeholder.set_option(v6_only(false));
-			dualstack_placeholder.bind(tcp::endpoint(tcp::v6(), localPort_));
-			dualstack_placeholder.listen();
-			localPort_ = dualstack_placeholder.local_endpoint().port();
-			dualstack_placeholder.close(ignoredError);
-		} catch (boost::system::system_error &e) {
-			// Error -> Probably no dual stack support or no v6 support at all
-		}
-	}
-
-	try {
-		v4acceptor->open(tcp::v4());
-		v4acceptor->bind(tcp::endpoint(tcp::v4(), localPort_));
-		v4acceptor->listen();
-		localPort_ = v4acceptor->local_endpoint().port();
-	} catch (boost::system::system_error &e) {
-		// Error -> IPv4 port is probably in use
-		v4Error = e.code();
-		v4acceptor->close(ignoredError);
-	}
-
-	try {
-		v6acceptor->open(tcp::v6());
-		v6acceptor->set_option(v6_only(true), ignoredError);
-		v6acceptor->bind(tcp::endpoint(tcp::v6(), localPort_));
-		v6acceptor->listen();
-		localPort_ = v6acceptor->local_endpoint().port();
-	} catch (boost::system::system_error &e) {
-		v6Error = e.code();
-		v6acceptor->close(ignoredError);
-	}
-
-	if(v4acceptor->is_open()) {
-		v4Acceptor_ = TcpAcceptor::listen(v4acceptor);
-	} else {
-		v4Acceptor_ = TcpAcceptor::error(v4Error.message());
-	}
-
-	if(v6acceptor->is_open()) {
-		v6Acceptor_ = TcpAcceptor::listen(v6acceptor);
-	} else {
-		v6Acceptor_ = TcpAcceptor::error(v6Error.message());
-	}
-}
-
-CombinedTcpAcceptor::~CombinedTcpAcceptor() {
-	v4Acceptor_->close();
-	v6Acceptor_->close();
-}
-
-std::string CombinedTcpAcceptor::getErrorMessage() {
-	return "IPv4: "+v4Acceptor_->getErrorMessage()+"; IPv6: "+v6Acceptor_->getErrorMessage();
-}
-
-bool CombinedTcpAcceptor::hasError() {
-	return v4Acceptor_->hasError() && v6Acceptor_->hasError();
-}
-
-std::shared_ptr<TcpSocket> CombinedTcpAcceptor::accept() {
-	std::shared_ptr<TcpSocket> acceptedSocket;
-	if(checkV6First_) {
-		acceptedSocket = v6Acceptor_->accept();
-		if(!acceptedSocket) {
-			acceptedSocket = v4Acceptor_->accept();
-		}
-	} else {
-		acceptedSocket = v4Acceptor_->accept();
-		if(!acceptedSocket) {
-			acceptedSocket = v6Acceptor_->accept();
-		}
-	}
-
-	checkV6First_ = !checkV6First_;
-	return acceptedSocket;
-}
-
-uint16_t CombinedTcpAcceptor::getLocalPort() {
-	return localPort_;
-}
-
-bool CombinedTcpAcceptor::isListeningV4() {
-	return !v4Acceptor_->hasError();
-}
-
-bool CombinedTcpAcceptor::isListeningV6() {
-	return !v6Acceptor_->hasError();
-}
+#include "CombinedTcpAcceptor.hpp"
+#include <faucet/tcp/TcpAcceptor.hpp>
+
+#include <algorithm>
+
+using namespace boost::asio::ip;
+
+#ifdef SO_REUSEPORT
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
+/**
+ * Open, bind and listen with the given acceptor. Returns the error, if any.
+ * The acceptor is closed again on error.
+ */
+static boost::system::error_code openAcceptor(tcp::acceptor &acceptor, const tcp::endpoint &endpoint,
+		int backlog, bool reusePort) {
+	boost::system::error_code ignoredError;
+	try {
+		acceptor.open(endpoint.protocol());
+		if(endpoint.protocol() == tcp::v6()) {
+			acceptor.set_option(v6_only(true), ignoredError);
+		}
+#ifdef SO_REUSEPORT
+		if(reusePort) {
+			acceptor.set_option(reuse_port(true));
+		}
+#endif
+		acceptor.bind(endpoint);
+		acceptor.listen(backlog);
+	} catch (boost::system::system_error &e) {
+		acceptor.close(ignoredError);
+		return e.code();
+	}
+	return boost::system::error_code();
+}
+
+CombinedTcpAcceptor::CombinedTcpAcceptor(uint16_t port, int backlog, size_t shards) :
+		v4Acceptor_(),
+		v6Acceptor_(),
+		acceptors_(),
+		acceptMutex_(),
+		nextAcceptor_(0),
+		localPort_(port) {
+
+#ifdef SO_REUSEPORT
+	shards = std::min(std::max<size_t>(shards, 1), Asio::MAX_SHARDS + 1);
+#else
+	shards = 1;
+#endif
+	bool reusePort = (shards > 1);
+
+	auto v4acceptor = std::make_shared<tcp::acceptor>(Asio::getIoService());
+	auto v6acceptor = std::make_shared<tcp::acceptor>(Asio::getIoService());
+	boost::system::error_code ignoredError, v4Error, v6Error;
+
+	if (localPort_ == 0) {
+		try {
+			tcp::acceptor dualstack_placeholder(Asio::getIoService());
+			dualstack_placeholder.open(tcp::v6());
+			dualstack_placeholder.set_option(v6_only(false));
+			dualstack_placeholder.bind(tcp::endpoint(tcp::v6(), localPort_));
+			dualstack_placeholder.listen();
+			localPort_ = dualstack_placeholder.local_endpoint().port();
+			dualstack_placeholder.close(ignoredError);
+		} catch (boost::system::system_error &e) {
+			// Error -> Probably no dual stack support or no v6 support at all
+		}
+	}
+
+	v4Error = openAcceptor(*v4acceptor, tcp::endpoint(tcp::v4(), localPort_), backlog, reusePort);
+	if(!v4Error) {
+		localPort_ = v4acceptor->local_endpoint().port();
+	} // Error -> IPv4 port is probably in use
+
+	v6Error = openAcceptor(*v6acceptor, tcp::endpoint(tcp::v6(), localPort_), backlog, reusePort);
+	if(!v6Error) {
+		localPort_ = v6acceptor->local_endpoint().port();
+	}
+
+	if(v4acceptor->is_open()) {
+		v4Acceptor_ = TcpAcceptor::listen(v4acceptor);
+		acceptors_.push_back(v4Acceptor_);
+	} else {
+		v4Acceptor_ = TcpAcceptor::error(v4Error.message());
+	}
+
+	if(v6acceptor->is_open()) {
+		v6Acceptor_ = TcpAcceptor::listen(v6acceptor);
+		acceptors_.push_back(v6Acceptor_);
+	} else {
+		v6Acceptor_ = TcpAcceptor::error(v6Error.message());
+	}
+
+	/*
+	 * The additional shards are a pure optimization, so if one of them can't
+	 * be opened we just go on with the listeners we have.
+	 */
+	for(size_t shard = 1; shard < shards; ++shard) {
+		boost::asio::io_service &ioService = Asio::getShardIoService(shard - 1);
+		if(v4acceptor->is_open()) {
+			auto acceptor = std::make_shared<tcp::acceptor>(ioService);
+			if(!openAcceptor(*acceptor, tcp::endpoint(tcp::v4(), localPort_), backlog, true)) {
+				acceptors_.push_back(TcpAcceptor::listen(acceptor));
+			}
+		}
+		if(v6acceptor->is_open()) {
+			auto acceptor = std::make_shared<tcp::acceptor>(ioService);
+			if(!openAcceptor(*acceptor, tcp::endpoint(tcp::v6(), localPort_), backlog, true)) {
+				acceptors_.push_back(TcpAcceptor::listen(acceptor));
+			}
+		}
+	}
+}
+
+std::shared_ptr<CombinedTcpAcceptor> CombinedTcpAcceptor::listen(uint16_t port, int backlog, size_t shards) {
+	std::shared_ptr<CombinedTcpAcceptor> result(new CombinedTcpAcceptor(port, backlog, shards));
+	for(auto &acceptor : result->acceptors_) {
+		acceptor->setEventSource(result);
+	}
+	return result;
+}
+
+CombinedTcpAcceptor::~CombinedTcpAcceptor() {
+	for(auto &acceptor : acceptors_) {
+		acceptor->close();
+	}
+}
+
+std::string CombinedTcpAcceptor::getErrorMessage() {
+	return "IPv4: "+v4Acceptor_->getErrorMessage()+"; IPv6: "+v6Acceptor_->getErrorMessage();
+}
+
+bool CombinedTcpAcceptor::hasError() {
+	return v4Acceptor_->hasError() && v6Acceptor_->hasError();
+}
+
+std::shared_ptr<TcpSocket> CombinedTcpAcceptor::accept() {
+	boost::lock_guard<boost::mutex> guard(acceptMutex_);
+	std::shared_ptr<TcpSocket> acceptedSocket;
+	size_t count = acceptors_.size();
+	for(size_t i = 0; i < count && !acceptedSocket; ++i) {
+		acceptedSocket = acceptors_[(nextAcceptor_ + i) % count]->accept();
+	}
+
+	// Take turns, so that no listener can starve the others
+	if(count > 0) {
+		nextAcceptor_ = (nextAcceptor_ + 1) % count;
+	}
+	return acceptedSocket;
+}
+
+uint16_t CombinedTcpAcceptor::getLocalPort() {
+	return localPort_;
+}
+
+bool CombinedTcpAcceptor::isListeningV4() {
+	return !v4Acceptor_->hasError();
+}
+
+bool CombinedTcpAcceptor::isListeningV6() {
+	return !v6Acceptor_->hasError();
+}
@@ -1,39 +1,63 @@
-#pragma once
-
-#include <faucet/Fallible.hpp>
-#include <boost/integer.hpp>
-#include <memory>
-
-class TcpAcceptor;
-class TcpSocket;
-
-/**
- * This class combines two TcpAcceptors, one for IPv4 and one for IPv6.
- * Both will listen on the same port, but on top their respective protocol.
- * The intention is to hide IPv4/IPv6 differences from the library user
- * and allow dual stack operation.
- */
-class CombinedTcpAcceptor : public Fallible {
-public:
-	CombinedTcpAcceptor(uint16_t port);
-	virtual ~CombinedTcpAcceptor();
-
-	virtual std::string getErrorMessage();
-	virtual bool hasError();
-
-	/**
-	 * If a connection is waiting to be accepted, a socket to this
-	 * connection is returned. Otherwise a NULL pointer is returned.
-	 */
-	std::shared_ptr<TcpSocket> accept();
-
-	uint16_t getLocalPort();
-
-	bool isListeningV4();
-	bool isListeningV6();
-
-private:
-	std::shared_ptr<TcpAcceptor> v4Acceptor_, v6Acceptor_;
-	bool checkV6First_;
-	uint16_t localPort_;
-};
+#pragma once
+
+#include <faucet/Fallible.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/integer.hpp>
+#include <boost/thread/mutex.hpp>
+#include <memory>
+#include <vector>
+
+class TcpAcceptor;
+class TcpSocket;
+
+/**
+ * This class combines two TcpAcceptors, one for IPv4 and one for IPv6.
+ * Both will listen on the same port, but on top their respective protocol.
+ * The intention is to hide IPv4/IPv6 differences from the library user
+ * and allow dual stack operation.
+ */
+class CombinedTcpAcceptor : public Fallible {
+public:
+	/**
+	 * Listen on the given port. The backlog is the number of connections the
+	 * OS will hold for each protocol until they are accepted.
+	 *
+	 * With more than one shard, that many listeners are opened per protocol
+	 * with SO_REUSEPORT, each on its own IO thread. The OS distributes new
+	 * connections between them, and accepted sockets stay on the IO thread
+	 * of the listener that accepted them. Where SO_REUSEPORT is not available
+	 * (e.g. Windows), only a single listener is opened.
+	 */
+	static std::shared_ptr<CombinedTcpAcceptor> listen(uint16_t port,
+			int backlog = boost::asio::socket_base::max_connections,
+			size_t shards = 1);
+	virtual ~CombinedTcpAcceptor();
+
+	virtual std::string getErrorMessage();
+	virtual bool hasError();
+
+	/**
+	 * If a connection is waiting to be accepted, a socket to this
+	 * connection is returned. Otherwise a NULL pointer is returned.
+	 */
+	std::shared_ptr<TcpSocket> accept();
+
+	uint16_t getLocalPort();
+
+	bool isListeningV4();
+	bool isListeningV6();
+
+private:
+	CombinedTcpAcceptor(uint16_t port, int backlog, size_t shards);
+
+	std::shared_ptr<TcpAcceptor> v4Acceptor_, v6Acceptor_;
+
+	/**
+	 * All listening acceptors, including the additional shards.
+	 * accept() takes turns between them.
+	 */
+	std::vector<std::shared_ptr<TcpAcceptor> > acceptors_;
+	boost::mutex acceptMutex_;
+	size_t nextAcceptor_;
+	uint16_t localPort_;
+};
@@ -1,84 +1,118 @@
-#include "TcpAcceptor.hpp"
-
-#include <faucet/tcp/TcpSocket.hpp>
-#include <boost/bind.hpp>
+#include "TcpAcceptor.hpp"
 
-TcpAcceptor::TcpAcceptor() :
-        socket_(),
-		acceptor_(),
-		hasError_(false),
-		errorMessage_(),
-		socketMutex_(),
-		errorMutex_() {
-}
-
-std::shared_ptr<TcpAcceptor> TcpAcceptor::listen(std::shared_ptr<tcp::acceptor> acceptor) {
-    std::shared_ptr<TcpAcceptor> result(new TcpAcceptor());
-	result->acceptor_ = acceptor;
-	result->startAsyncAccept();
-	return result;
-}
-
-std::shared_ptr<TcpAcceptor> TcpAcceptor::error(std::string message) {
-	std::shared_ptr<TcpAcceptor> result(new TcpAcceptor());
-	result->hasError_ = true;
-	result->errorMessage_ = message;
-	return result;
-}
-
-TcpAcceptor::~TcpAcceptor() {}
-
-std::string TcpAcceptor::getErrorMessage() {
-	boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
-	return errorMessage_;
-}
-
-bool TcpAcceptor::hasError() {
-	boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
-	return hasError_;
-}
-
-std::shared_ptr<TcpSocket> TcpAcceptor::accept() {
-	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
-	if(socket_) {
-		// Ownership of the socket transfers to the TcpSocket
-		auto tcpSocket = TcpSocket::fromConnectedSocket(socket_);
-		socket_.reset();
-		startAsyncAccept();
-		return tcpSocket;
-	} else {
-		return nullptr;
-	}
-}
-
-void TcpAcceptor::close() {
-	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
-	boost::system::error_code error;
-	if(acceptor_) {
-		acceptor_->close(error);
-	}
-}
-
-void TcpAcceptor::startAsyncAccept() {
-	auto socket = std::make_shared<tcp::socket>(Asio::getIoService());
-	acceptor_->async_accept(*socket, boost::bind(
-			&TcpAcceptor::handleAccept,
-			shared_from_this(),
-			boost::asio::placeholders::error,
-			socket));
-}
-
-void TcpAcceptor::handleAccept(const boost::system::error_code &error, std::shared_ptr<tcp::socket> socket) {
-	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
-	if(!error) {
-		socket_ = socket;
-	} else {
-		if(acceptor_->is_open()) {
-			startAsyncAccept();
-		} else {
-			boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
-			hasError_ = true;
-			errorMessage_ = error.message();
-		}
-	}
-}
+#include <faucet/tcp/TcpSocket.hpp>
+#include <faucet/EventQueue.hpp>
+#include <boost/bind.hpp>
+
+TcpAcceptor::TcpAcceptor() :
+		queuedSockets_(),
+		acceptsInProgress_(0),
+		acceptor_(),
+		eventSource_(),
+		hasError_(false),
+		errorMessage_(),
+		socketMutex_(),
+		errorMutex_() {
+}
+
+std::shared_ptr<TcpAcceptor> TcpAcceptor::listen(std::shared_ptr<tcp::acceptor> acceptor) {
+    std::shared_ptr<TcpAcceptor> result(new TcpAcceptor());
+	result->acceptor_ = acceptor;
+	boost::lock_guard<boost::recursive_mutex> guard(result->socketMutex_);
+	result->startAsyncAccepts();
+	return result;
+}
+
+std::shared_ptr<TcpAcceptor> TcpAcceptor::error(std::string message) {
+	std::shared_ptr<TcpAcceptor> result(new TcpAcceptor());
+	result->hasError_ = true;
+	result->errorMessage_ = message;
+	return result;
+}
+
+TcpAcceptor::~TcpAcceptor() {}
+
+std::string TcpAcceptor::getErrorMessage() {
+	boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
+	return errorMessage_;
+}
+
+bool TcpAcceptor::hasError() {
+	boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
+	return hasError_;
+}
+
+std::shared_ptr<TcpSocket> TcpAcceptor::accept() {
+	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
+	if(!queuedSockets_.empty()) {
+		// Ownership of the socket transfers to the TcpSocket
+		auto tcpSocket = TcpSocket::fromConnectedSocket(queuedSockets_.front());
+		queuedSockets_.pop_front();
+		startAsyncAccepts();
+		return tcpSocket;
+	} else {
+		return nullptr;
+	}
+}
+
+size_t TcpAcceptor::getQueuedCount() {
+	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
+	return queuedSockets_.size();
+}
+
+void TcpAcceptor::close() {
+	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
+	boost::system::error_code error;
+	if(acceptor_) {
+		acceptor_->close(error);
+	}
+}
+
+void TcpAcceptor::setEventSource(std::weak_ptr<Handled> eventSource) {
+	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
+	eventSource_ = eventSource;
+	if(!queuedSockets_.empty()) {
+		EventQueue::push(eventSource_, EVENT_ACCEPTED);
+	}
+}
+
+/**
+ * Keep up to ACCEPTS_IN_FLIGHT accepts running, as long as the accepted
+ * connections would still fit into the queue. Must be called with socketMutex_ held.
+ */
+void TcpAcceptor::startAsyncAccepts() {
+	while(acceptsInProgress_ < ACCEPTS_IN_FLIGHT
+			&& queuedSockets_.size() + acceptsInProgress_ < MAX_QUEUED_SOCKETS
+			&& acceptor_->is_open()) {
+#if BOOST_VERSION >= 107000
+		auto socket = std::make_shared<tcp::socket>(acceptor_->get_executor());
+#else
+		auto socket = std::make_shared<tcp::socket>(acceptor_->get_io_service());
+#endif
+		acceptor_->async_accept(*socket, boost::bind(
+				&TcpAcceptor::handleAccept,
+				shared_from_this(),
+				boost::asio::placeholders::error,
+				socket));
+		++acceptsInProgress_;
+	}
+}
+
+void TcpAcceptor::handleAccept(const boost::system::error_code &error, std::shared_ptr<tcp::socket> socket) {
+	boost::lock_guard<boost::recursive_mutex> guard(socketMutex_);
+	--acceptsInProgress_;
+	if(!error) {
+		queuedSockets_.push_back(socket);
+		EventQueue::push(eventSource_, EVENT_ACCEPTED);
+		startAsyncAccepts();
+	} else {
+		if(acceptor_->is_open()) {
+			startAsyncAccepts();
+		} else {
+			boost::lock_guard<boost::recursive_mutex> guard(errorMutex_);
+			hasError_ = true;
+			errorMessage_ = error.message();
+			EventQueue::push(eventSource_, EVENT_ERROR);
+		}
+	}
+}
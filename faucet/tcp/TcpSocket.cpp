@@ -1,176 +1,215 @@
-#include "TcpSocket.hpp"
-
-#include <boost/thread/locks.hpp>
-#include <limits>
-
-using namespace boost::asio::ip;
-
-TcpSocket::~TcpSocket() {
-	// Ensure graceful close
-	if (socket_ && socket_->is_open()) {
-		boost::system::error_code newError;
-		socket_->shutdown(tcp::socket::shutdown_both, newError);
-		socket_->close();
-	}
-}
-
-bool TcpSocket::isConnecting() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return state_->isConnecting();
-}
-
-std::string TcpSocket::getErrorMessage() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return state_->getErrorMessage();
-}
-
-bool TcpSocket::hasError() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return state_->isErrorState();
-}
-
-void TcpSocket::write(const uint8_t *in, size_t size) {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	if (state_->allowWrite()) {
-		if (sendbuffer_.totalSize() + size > sendbufferSizeLimit_) {
-			enterErrorState("The send buffer size limit was exceeded.");
-			return;
-		} else {
-			sendbuffer_.push(in, size);
-		}
-	}
-}
-
-size_t TcpSocket::read(uint8_t *out, size_t size) {
-	return receiveBuffer_.read(out, size);
-}
-
-std::string TcpSocket::readString(size_t size) {
-	return receiveBuffer_.readString(size);
-}
-
-size_t TcpSocket::bytesRemaining() const {
-	return receiveBuffer_.bytesRemaining();
-}
-
-void TcpSocket::setReadpos(size_t pos) {
-	receiveBuffer_.setReadpos(pos);
-}
-
-Buffer &TcpSocket::getReceiveBuffer() {
-	return receiveBuffer_;
-}
-
-size_t TcpSocket::getSendbufferSize() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return sendbuffer_.totalSize();
-}
-
-size_t TcpSocket::getReceivebufferSize() {
-	return receiveBuffer_.size();
-}
-
-void TcpSocket::setSendbufferLimit(size_t maxSize) {
-	sendbufferSizeLimit_ = maxSize;
-}
-
-void TcpSocket::send() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	sendbuffer_.commit();
-	state_->startAsyncSend();
-}
-
-bool TcpSocket::receive(size_t ammount) {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	receiveBuffer_.clear();
-	return state_->receive(ammount);
-}
-
-size_t TcpSocket::receive() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	receiveBuffer_.clear();
-	state_->receive();
-	return receiveBuffer_.size();
-}
-
-bool TcpSocket::isEof() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return state_->isEof();
-}
-
-void TcpSocket::disconnectAbortive() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	enterClosedState();
-}
-
-bool TcpSocket::setNoDelay(bool noDelay) {
-    boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-    return state_->setNoDelay(noDelay);
-}
-
-std::string TcpSocket::getRemoteIp() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return remoteIp_;
-}
-
-uint16_t TcpSocket::getRemotePort() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return remotePort_;
-}
-
-uint16_t TcpSocket::getLocalPort() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return localPort_;
-}
-
-std::shared_ptr<TcpSocket> TcpSocket::connectTo(const char *host,
-		uint16_t port) {
-    auto asioSocket = std::make_shared<tcp::socket>(Asio::getIoService());
-	std::shared_ptr<TcpSocket> result(new TcpSocket(asioSocket));
-	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
-	result->state_ = &(result->tcpConnecting_);
-	result->tcpConnecting_.enter(host, port);
-	return result;
-}
-
-std::shared_ptr<TcpSocket> TcpSocket::error(const std::string &message) {
-    auto asioSocket = std::make_shared<tcp::socket>(Asio::getIoService());
-    std::shared_ptr<TcpSocket> result(new TcpSocket(asioSocket));
-	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
-	result->state_ = &(result->tcpClosed_);
-	result->tcpClosed_.enterError(message);
-	return result;
-}
-
-std::shared_ptr<TcpSocket> TcpSocket::fromConnectedSocket(
-		std::shared_ptr<tcp::socket> connectedSocket) {
-	std::shared_ptr<TcpSocket> result(new TcpSocket(connectedSocket));
-	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
-	result->state_ = &(result->tcpConnected_);
-	result->tcpConnected_.enter(DEFAULT_TCP_NODELAY);
-	return result;
-}
-
-TcpSocket::TcpSocket(std::shared_ptr<tcp::socket> socket) :
-		commonMutex_(), socket_(socket), tcpConnecting_(*this), tcpConnected_(
-				*this), tcpClosed_(*this), state_(0), sendbuffer_(), remoteIp_(), remotePort_(
-				0), localPort_(0), receiveBuffer_(), sendbufferSizeLimit_(
-				std::numeric_limits<size_t>::max()) {
-}
-
-void TcpSocket::enterConnectedState(bool noDelay) {
-	state_ = &tcpConnected_;
-	tcpConnected_.enter(noDelay);
-}
-
-void TcpSocket::enterErrorState(const std::string &message) {
-	state_->abort();
-	state_ = &tcpClosed_;
-	tcpClosed_.enterError(message);
-}
-
-void TcpSocket::enterClosedState() {
-	state_->abort();
-	state_ = &tcpClosed_;
-	tcpClosed_.enterClosed();
-}
+#include "TcpSocket.hpp"
+
+#include <faucet/EventQueue.hpp>
+#include <faucet/EndpointId.hpp>
+#include <faucet/Trace.hpp>
+
+#include <boost/thread/locks.hpp>
+#include <limits>
+
+using namespace boost::asio::ip;
+
+TcpSocket::~TcpSocket() {
+	// Ensure graceful close
+	if (socket_ && socket_->is_open()) {
+		boost::system::error_code newError;
+		socket_->shutdown(tcp::socket::shutdown_both, newError);
+		socket_->close();
+	}
+}
+
+bool TcpSocket::isConnecting() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return state_->isConnecting();
+}
+
+std::string TcpSocket::getErrorMessage() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return state_->getErrorMessage();
+}
+
+bool TcpSocket::hasError() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return state_->isErrorState();
+}
+
+void TcpSocket::write(const uint8_t *in, size_t size) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (state_->allowWrite()) {
+		if (sendbuffer_.totalSize() + size > sendbufferSizeLimit_) {
+			enterErrorState("The send buffer size limit was exceeded.");
+			return;
+		} else {
+			sendbuffer_.push(in, size);
+			getStats().raise(STAT_SEND_QUEUE_HIGH_WATER, sendbuffer_.totalSize());
+		}
+	}
+}
+
+size_t TcpSocket::read(uint8_t *out, size_t size) {
+	return receiveBuffer_.read(out, size);
+}
+
+std::string TcpSocket::readString(size_t size) {
+	return receiveBuffer_.readString(size);
+}
+
+size_t TcpSocket::bytesRemaining() const {
+	return receiveBuffer_.bytesRemaining();
+}
+
+void TcpSocket::setReadpos(size_t pos) {
+	receiveBuffer_.setReadpos(pos);
+}
+
+Buffer &TcpSocket::getReceiveBuffer() {
+	return receiveBuffer_;
+}
+
+size_t TcpSocket::getSendbufferSize() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return sendbuffer_.totalSize();
+}
+
+size_t TcpSocket::getReceivebufferSize() {
+	return receiveBuffer_.size();
+}
+
+void TcpSocket::setSendbufferLimit(size_t maxSize) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendbufferSizeLimit_ = maxSize;
+}
+
+void TcpSocket::send() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (sendbuffer_.totalSize() > sendbuffer_.committedSize()) {
+		getStats().increment(STAT_MESSAGES_SENT);
+		sendTimes_.push_back(std::make_pair(bytesSent_ + sendbuffer_.totalSize(), LatencyClock::now()));
+	}
+	sendbuffer_.commit();
+	state_->startAsyncSend();
+}
+
+bool TcpSocket::receive(size_t ammount) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	receiveBuffer_.clear();
+	return state_->receive(ammount);
+}
+
+size_t TcpSocket::receive() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	receiveBuffer_.clear();
+	state_->receive();
+	return receiveBuffer_.size();
+}
+
+bool TcpSocket::isEof() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return state_->isEof();
+}
+
+void TcpSocket::disconnectAbortive() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	enterClosedState();
+}
+
+bool TcpSocket::setNoDelay(bool noDelay) {
+    boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+    return state_->setNoDelay(noDelay);
+}
+
+std::string TcpSocket::getRemoteIp() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return remoteIp_;
+}
+
+uint16_t TcpSocket::getRemotePort() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return remotePort_;
+}
+
+uint64_t TcpSocket::getRemoteEndpointId() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	boost::system::error_code ec;
+	address remoteAddress = address::from_string(remoteIp_, ec);
+	if (ec) {
+		return 0;
+	}
+	return getEndpointId(remoteAddress, remotePort_);
+}
+
+uint16_t TcpSocket::getLocalPort() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return localPort_;
+}
+
+std::shared_ptr<TcpSocket> TcpSocket::connectTo(const char *host,
+		uint16_t port) {
+    auto asioSocket = std::make_shared<tcp::socket>(Asio::getIoService());
+	std::shared_ptr<TcpSocket> result(new TcpSocket(asioSocket));
+	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
+	result->state_ = &(result->tcpConnecting_);
+	result->tcpConnecting_.enter(host, port);
+	return result;
+}
+
+std::shared_ptr<TcpSocket> TcpSocket::error(const std::string &message) {
+    auto asioSocket = std::make_shared<tcp::socket>(Asio::getIoService());
+    std::shared_ptr<TcpSocket> result(new TcpSocket(asioSocket));
+	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
+	result->state_ = &(result->tcpClosed_);
+	result->tcpClosed_.enterError(message);
+	return result;
+}
+
+std::shared_ptr<TcpSocket> TcpSocket::fromConnectedSocket(
+		std::shared_ptr<tcp::socket> connectedSocket) {
+	std::shared_ptr<TcpSocket> result(new TcpSocket(connectedSocket));
+	boost::lock_guard<boost::recursive_mutex> guard(result->commonMutex_);
+	result->state_ = &(result->tcpConnected_);
+	result->tcpConnected_.enter(DEFAULT_TCP_NODELAY);
+	return result;
+}
+
+TcpSocket::TcpSocket(std::shared_ptr<tcp::socket> socket) :
+		commonMutex_(), socket_(socket), tcpConnecting_(*this), tcpConnected_(
+				*this), tcpClosed_(*this), state_(0), sendbuffer_(), remoteIp_(), remotePort_(
+				0), localPort_(0), receiveBuffer_(), sendbufferSizeLimit_(
+				std::numeric_limits<size_t>::max()), sendTimes_(), bytesSent_(0) {
+}
+
+void TcpSocket::enterConnectedState(bool noDelay) {
+	FCT_TRACE_EVENT("tcp connected", getHandle());
+	state_ = &tcpConnected_;
+	EventQueue::push(shared_from_this(), EVENT_CONNECTED);
+	tcpConnected_.enter(noDelay);
+}
+
+void TcpSocket::enterErrorState(const std::string &message) {
+	FCT_TRACE_EVENT("tcp error", getHandle());
+	if (!state_->isErrorState()) {
+		EventQueue::push(shared_from_this(), EVENT_ERROR);
+		getStats().increment(STAT_ERRORS);
+	}
+	state_->abort();
+	state_ = &tcpClosed_;
+	tcpClosed_.enterError(message);
+}
+
+/**
+ * Record how long the data of each send() waited until it was completely sent.
+ */
+void TcpSocket::sendCompleted(size_t bytesSent) {
+	bytesSent_ += bytesSent;
+	LatencyClock::time_point now = LatencyClock::now();
+	while (!sendTimes_.empty() && sendTimes_.front().first <= bytesSent_) {
+		getStats().recordLatency(LATENCY_QUEUE_WAIT, sendTimes_.front().second, now);
+		sendTimes_.pop_front();
+	}
+}
+
+void TcpSocket::enterClosedState() {
+	state_->abort();
+	state_ = &tcpClosed_;
+	tcpClosed_.enterClosed();
+}
@@ -1,37 +1,49 @@
-#include "ConnectionState.hpp"
-
-#include <faucet/tcp/TcpSocket.hpp>
-
-ConnectionState::ConnectionState(TcpSocket &tcpSocket) :
-	socket(&tcpSocket) {
-}
-
-void ConnectionState::enterErrorState(const std::string &message) {
-	socket->enterErrorState(message);
-}
-
-void ConnectionState::enterConnectedState(bool noDelay) {
-	socket->enterConnectedState(noDelay);
-}
-
-void ConnectionState::setEndpointInfo(std::string remoteIp, uint16_t remotePort, uint16_t localPort) {
-	socket->remoteIp_ = remoteIp;
-	socket->remotePort_ = remotePort;
-	socket->localPort_ = localPort;
-}
-
-boost::asio::ip::tcp::socket &ConnectionState::getSocket() {
-	return *(socket->socket_);
-}
-
-boost::recursive_mutex &ConnectionState::getCommonMutex() {
-	return socket->commonMutex_;
-}
-
-SendBuffer &ConnectionState::getSendBuffer() {
-	return socket->sendbuffer_;
-}
-
-Buffer &ConnectionState::getReceiveBuffer() {
-	return socket->receiveBuffer_;
-}
+#include "ConnectionState.hpp"
+
+#include <faucet/tcp/TcpSocket.hpp>
+
+ConnectionState::ConnectionState(TcpSocket &tcpSocket) :
+	socket(&tcpSocket) {
+}
+
+void ConnectionState::enterErrorState(const std::string &message) {
+	socket->enterErrorState(message);
+}
+
+void ConnectionState::enterConnectedState(bool noDelay) {
+	socket->enterConnectedState(noDelay);
+}
+
+void ConnectionState::setEndpointInfo(std::string remoteIp, uint16_t remotePort, uint16_t localPort) {
+	socket->remoteIp_ = remoteIp;
+	socket->remotePort_ = remotePort;
+	socket->localPort_ = localPort;
+}
+
+boost::asio::ip::tcp::socket &ConnectionState::getSocket() {
+	return *(socket->socket_);
+}
+
+void ConnectionState::setSocket(std::shared_ptr<boost::asio::ip::tcp::socket> newSocket) {
+	socket->socket_ = newSocket;
+}
+
+boost::recursive_mutex &ConnectionState::getCommonMutex() {
+	return socket->commonMutex_;
+}
+
+SendBuffer &ConnectionState::getSendBuffer() {
+	return socket->sendbuffer_;
+}
+
+void ConnectionState::sendCompleted(size_t bytesSent) {
+	socket->sendCompleted(bytesSent);
+}
+
+Buffer &ConnectionState::getReceiveBuffer() {
+	return socket->receiveBuffer_;
+}
+
+void ConnectionState::pushEvent(EventType type) {
+	EventQueue::push(socket->shared_from_this(), type);
+}
@@ -1,40 +1,55 @@
-#pragma once
-
-#include "ConnectionState.hpp"
-
-#include <memory>
-
-class TcpConnected: public ConnectionState {
-public:
-	TcpConnected(TcpSocket &tcpSocket);
-	virtual ~TcpConnected() {}
-
-	void enter(bool noDelay);
-
-	virtual void abort();
-
-	virtual bool allowWrite() {
-		return true;
-	}
-	virtual void startAsyncSend();
-	virtual bool isEof();
-	virtual bool receive(size_t ammount);
-	virtual void receive();
-    virtual bool setNoDelay(bool noDelay);
-
-private:
-	bool asyncSendInProgress;
-	bool abortRequested;
-
-	std::vector<uint8_t> partialReceiveBuffer;
-	bool asyncReceiveInProgress;
-
-	void nonblockReceive(size_t maxData);
-
-	void handleSend(std::shared_ptr<TcpSocket> socket,
-			const boost::system::error_code &err, size_t bytesTransferred);
-
-	void startAsyncReceive(size_t ammount);
-	void handleReceive(std::shared_ptr<TcpSocket> socket,
-			const boost::system::error_code &error);
-};
+#pragma once
+
+#include "ConnectionState.hpp"
+
+#include <faucet/LatencyHistogram.hpp>
+
+#include <memory>
+
+class TcpConnected: public ConnectionState {
+public:
+	TcpConnected(TcpSocket &tcpSocket);
+	virtual ~TcpConnected() {}
+
+	void enter(bool noDelay);
+
+	virtual void abort();
+
+	virtual bool allowWrite() {
+		return true;
+	}
+	virtual void startAsyncSend();
+	virtual bool isEof();
+	virtual bool receive(size_t ammount);
+	virtual void receive();
+    virtual bool setNoDelay(bool noDelay);
+
+private:
+	bool asyncSendInProgress;
+	LatencyClock::time_point asyncSendStarted;
+	bool abortRequested;
+
+	std::vector<uint8_t> partialReceiveBuffer;
+	bool asyncReceiveInProgress;
+
+	bool asyncWaitInProgress;
+	bool eofReported;
+
+	void nonblockReceive(size_t maxData);
+	void countReceived(size_t ammount);
+
+	void handleSend(std::shared_ptr<TcpSocket> socket,
+			const boost::system::error_code &err, size_t bytesTransferred);
+
+	void startAsyncReceive(size_t ammount);
+	void handleReceive(std::shared_ptr<TcpSocket> socket,
+			const boost::system::error_code &error);
+
+	/*
+	 * Wait for incoming data in order to report it to the event queue.
+	 * The wait is restarted whenever the client has read from the socket.
+	 */
+	void startAsyncWait();
+	void handleWait(std::shared_ptr<TcpSocket> socket,
+			const boost::system::error_code &error);
+};
@@ -1,91 +1,211 @@
-#include "TcpConnecting.hpp"
-
-#include <faucet/tcp/TcpSocket.hpp>
-
-#include <boost/lexical_cast.hpp>
-#include <boost/bind.hpp>
-#include <boost/thread/locks.hpp>
-
-#include <faucet/resolve.hpp>
-
-using namespace boost::asio::ip;
-
-TcpConnecting::TcpConnecting(TcpSocket &socket) :
-	ConnectionState(socket),
-	resolver(Asio::getIoService()),
-	abortRequested(false),
-	noDelay_(TcpSocket::DEFAULT_TCP_NODELAY) {
-}
-
-void TcpConnecting::enter(const char *host, uint16_t port) {
-    fct_async_resolve<tcp>(host, port, resolver, boost::bind(&TcpConnecting::handleResolve,
-			this, socket->shared_from_this(), boost::asio::placeholders::error,
-			boost::asio::placeholders::iterator));
-}
-
-void TcpConnecting::abort() {
-	resolver.cancel();
-	abortRequested = true;
-}
-
-bool TcpConnecting::setNoDelay(bool noDelay) {
-    noDelay_ = noDelay;
-    return true;
-}
-
-void TcpConnecting::handleResolve(std::shared_ptr<TcpSocket> socket,
-		const boost::system::error_code &error,
-		tcp::resolver::iterator endpointIterator) {
-	boost::lock_guard<boost::recursive_mutex> guard(getCommonMutex());
-
-	if (abortRequested) {
-		return;
-	}
-
-	if (error) {
-		enterErrorState(error.message());
-		return;
-	}
-
-	V4FirstIterator<tcp> endpoints(endpointIterator);
-	boost::system::error_code ec;
-	if(startConnectionAttempt(socket, endpoints, ec)) {
-		enterErrorState(ec.message());
-		return;
-	}
-}
-
-boost::system::error_code TcpConnecting::startConnectionAttempt(std::shared_ptr<TcpSocket> socket,
-		V4FirstIterator<tcp> endpoints, boost::system::error_code &ec) {
-	if (getSocket().close(ec)) {
-		return ec;
-	}
-	tcp::endpoint endpoint = endpoints.next();
-	getSocket().async_connect(endpoint, boost::bind(
-			&TcpConnecting::handleConnect, this, socket,
-			boost::asio::placeholders::error, endpoints));
-	return ec;
-}
-
-void TcpConnecting::handleConnect(std::shared_ptr<TcpSocket> socket,
-		const boost::system::error_code &error,
-		V4FirstIterator<tcp> endpoints) {
-	boost::lock_guard<boost::recursive_mutex> guard(getCommonMutex());
-
-	if (abortRequested) {
-		return;
-	}
-
-	if (!error) {
-		enterConnectedState(noDelay_);
-	} else if (endpoints.hasNext()) {
-		boost::system::error_code ec;
-		if(startConnectionAttempt(socket, endpoints, ec)) {
-			enterErrorState(ec.message());
-			return;
-		}
-	} else {
-		enterErrorState(error.message());
-		return;
-	}
-}
+#include "TcpConnecting.hpp"
+
+#include <faucet/tcp/TcpSocket.hpp>
+#include <faucet/Trace.hpp>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+
+#include <faucet/resolve.hpp>
+
+using namespace boost::asio::ip;
+
+namespace {
+	const size_t MAX_HISTORY_ENTRIES = 1024;
+
+	/**
+	 * Whether the last completed connection attempt to an address succeeded.
+	 * Shared by all sockets. If it grows too large it is simply cleared.
+	 */
+	std::map<address, bool> connectHistory;
+	boost::mutex connectHistoryMutex;
+
+	void rememberOutcome(const address &addr, bool success) {
+		boost::lock_guard<boost::mutex> guard(connectHistoryMutex);
+		if(connectHistory.size() >= MAX_HISTORY_ENTRIES && connectHistory.count(addr) == 0) {
+			connectHistory.clear();
+		}
+		connectHistory[addr] = success;
+	}
+
+	/**
+	 * 0 for addresses which worked last time, 1 for unknown ones, 2 for those which failed.
+	 */
+	int historyRank(const address &addr) {
+		auto entry = connectHistory.find(addr);
+		if(entry == connectHistory.end()) {
+			return 1;
+		}
+		return entry->second ? 0 : 2;
+	}
+
+	/**
+	 * Order the endpoints for connecting: Alternate between IPv4 and IPv6,
+	 * starting with IPv4, then move known good addresses to the front and
+	 * known bad ones to the back.
+	 */
+	std::vector<tcp::endpoint> orderEndpoints(tcp::resolver::iterator iter) {
+		std::vector<tcp::endpoint> v4Endpoints, v6Endpoints, result;
+		for(; iter != tcp::resolver::iterator(); ++iter) {
+			tcp::endpoint endpoint = iter->endpoint();
+			if(endpoint.protocol() == tcp::v4()) {
+				v4Endpoints.push_back(endpoint);
+			} else {
+				v6Endpoints.push_back(endpoint);
+			}
+		}
+
+		for(size_t i = 0; i < std::max(v4Endpoints.size(), v6Endpoints.size()); ++i) {
+			if(i < v4Endpoints.size()) {
+				result.push_back(v4Endpoints[i]);
+			}
+			if(i < v6Endpoints.size()) {
+				result.push_back(v6Endpoints[i]);
+			}
+		}
+
+		boost::lock_guard<boost::mutex> guard(connectHistoryMutex);
+		std::stable_sort(result.begin(), result.end(), [](const tcp::endpoint &a, const tcp::endpoint &b) {
+			return historyRank(a.address()) < historyRank(b.address());
+		});
+		return result;
+	}
+}
+
+const long TcpConnecting::ATTEMPT_DELAY_MILLIS;
+
+TcpConnecting::TcpConnecting(TcpSocket &socket) :
+	ConnectionState(socket),
+	attemptTimer_(Asio::getIoService()),
+	endpoints_(),
+	nextEndpoint_(0),
+	attempts_(),
+	finished_(false),
+	noDelay_(TcpSocket::DEFAULT_TCP_NODELAY),
+	resolveRequest_(0) {
+}
+
+void TcpConnecting::enter(const char *host, uint16_t port) {
+    resolveRequest_ = fct_async_resolve<tcp>(host, port, boost::bind(&TcpConnecting::handleResolve,
+			this, socket->shared_from_this(), boost::asio::placeholders::error,
+			boost::asio::placeholders::iterator));
+}
+
+void TcpConnecting::abort() {
+	ResolveCache::cancel(resolveRequest_);
+	resolveRequest_ = 0;
+	closeAttempts();
+	finished_ = true;
+}
+
+bool TcpConnecting::setNoDelay(bool noDelay) {
+    noDelay_ = noDelay;
+    return true;
+}
+
+void TcpConnecting::handleResolve(std::shared_ptr<TcpSocket> socket,
+		const boost::system::error_code &error,
+		tcp::resolver::iterator endpointIterator) {
+	FCT_TRACE_SCOPE("tcp resolve done", socket->getHandle());
+	FCT_TRACE_BEGIN("mutex wait", socket->getHandle());
+	boost::lock_guard<boost::recursive_mutex> guard(getCommonMutex());
+	FCT_TRACE_END("mutex wait", socket->getHandle());
+
+	if (finished_) {
+		return;
+	}
+
+	if (error) {
+		enterErrorState(error.message());
+		return;
+	}
+
+	endpoints_ = orderEndpoints(endpointIterator);
+	if (endpoints_.empty()) {
+		enterErrorState(boost::system::error_code(boost::asio::error::host_not_found).message());
+		return;
+	}
+	startConnectionAttempt(socket);
+}
+
+/**
+ * Start connecting to the next endpoint, and schedule the attempt after that.
+ */
+void TcpConnecting::startConnectionAttempt(std::shared_ptr<TcpSocket> socket) {
+	tcp::endpoint endpoint = endpoints_[nextEndpoint_++];
+	AttemptSocket attempt = std::make_shared<tcp::socket>(Asio::getIoService());
+	attempts_.push_back(attempt);
+	FCT_TRACE_EVENT("tcp connect start", socket->getHandle());
+	attempt->async_connect(endpoint, boost::bind(
+			&TcpConnecting::handleConnect, this, socket,
+			boost::asio::placeholders::error, attempt, endpoint));
+
+	if (nextEndpoint_ < endpoints_.size()) {
+		attemptTimer_.expires_from_now(boost::posix_time::milliseconds(ATTEMPT_DELAY_MILLIS));
+		attemptTimer_.async_wait(boost::bind(
+				&TcpConnecting::handleAttemptTimer, this, socket,
+				boost::asio::placeholders::error));
+	}
+}
+
+void TcpConnecting::handleAttemptTimer(std::shared_ptr<TcpSocket> socket,
+		const boost::system::error_code &error) {
+	boost::lock_guard<boost::recursive_mutex> guard(getCommonMutex());
+
+	// The timer may have been restarted by a failed attempt after this handler was queued
+	if (finished_ || error || attemptTimer_.expires_from_now() > boost::posix_time::seconds(0)) {
+		return;
+	}
+
+	if (nextEndpoint_ < endpoints_.size()) {
+		startConnectionAttempt(socket);
+	}
+}
+
+void TcpConnecting::handleConnect(std::shared_ptr<TcpSocket> socket,
+		const boost::system::error_code &error,
+		AttemptSocket attempt,
+		tcp::endpoint endpoint) {
+	FCT_TRACE_SCOPE("tcp connect done", socket->getHandle());
+	FCT_TRACE_BEGIN("mutex wait", socket->getHandle());
+	boost::lock_guard<boost::recursive_mutex> guard(getCommonMutex());
+	FCT_TRACE_END("mutex wait", socket->getHandle());
+
+	auto attemptPos = std::find(attempts_.begin(), attempts_.end(), attempt);
+	if (finished_ || attemptPos == attempts_.end()) {
+		return;
+	}
+	attempts_.erase(attemptPos);
+
+	if (!error) {
+		rememberOutcome(endpoint.address(), true);
+		closeAttempts();
+		finished_ = true;
+		setSocket(attempt);
+		enterConnectedState(noDelay_);
+		return;
+	}
+
+	rememberOutcome(endpoint.address(), false);
+	if (nextEndpoint_ < endpoints_.size()) {
+		// Don't wait for the timer if we already know this attempt won't win
+		boost::system::error_code ignored;
+		attemptTimer_.cancel(ignored);
+		startConnectionAttempt(socket);
+	} else if (attempts_.empty()) {
+		enterErrorState(error.message());
+	}
+}
+
+void TcpConnecting::closeAttempts() {
+	boost::system::error_code ignored;
+	attemptTimer_.cancel(ignored);
+	for (auto &attempt : attempts_) {
+		attempt->close(ignored);
+	}
+	attempts_.clear();
+}
@@ -1,43 +1,77 @@
-#pragma once
-
-#include <faucet/Asio.hpp>
-#include <faucet/V4FirstIterator.hpp>
-#include "ConnectionState.hpp"
-
-#include <string>
-#include <memory>
-
-class TcpConnecting: public ConnectionState {
-public:
-	TcpConnecting(TcpSocket &socket);
-	virtual ~TcpConnecting() {}
-
-	void enter(const char *host, uint16_t port);
-	virtual void abort();
-	virtual bool isConnecting() {
-		return true;
-	}
-	virtual bool allowWrite() {
-		return true;
-	}
-	virtual bool isEof() {
-		return false;
-	}
-	virtual bool setNoDelay(bool noDelay);
-private:
-	boost::asio::ip::tcp::resolver resolver;
-	bool abortRequested;
-	bool noDelay_;
-
-	typedef boost::asio::ip::tcp::resolver::protocol_type protocol_type;
-	void handleResolve(std::shared_ptr<TcpSocket> tcpSocket,
-			const boost::system::error_code &err,
-			boost::asio::ip::tcp::resolver::iterator endpointIterator);
-
-	boost::system::error_code startConnectionAttempt(std::shared_ptr<TcpSocket> tcpSocket,
-			V4FirstIterator<boost::asio::ip::tcp> endpoints, boost::system::error_code &ec);
-
-	void handleConnect(std::shared_ptr<TcpSocket> tcpSocket,
-			const boost::system::error_code &err,
-			V4FirstIterator<boost::asio::ip::tcp> endpoints);
-};
+#pragma once
+
+#include <faucet/Asio.hpp>
+#include <faucet/ResolveCache.hpp>
+#include "ConnectionState.hpp"
+
+#include <string>
+#include <memory>
+#include <vector>
+
+/**
+ * Connects using the "Happy Eyeballs" algorithm (RFC 8305): The resolved addresses
+ * are tried in order, alternating between IPv4 and IPv6, but a new attempt is started
+ * whenever the previous one has neither succeeded nor failed after ATTEMPT_DELAY.
+ * The first attempt to succeed wins and the others are closed, so a dead route for
+ * one protocol or address doesn't hold up the connection for a full OS timeout.
+ *
+ * The outcome of each attempt is remembered per address, so that addresses which
+ * worked before are tried first and addresses which failed are tried last.
+ */
+class TcpConnecting: public ConnectionState {
+public:
+	TcpConnecting(TcpSocket &socket);
+	virtual ~TcpConnecting() {}
+
+	void enter(const char *host, uint16_t port);
+	virtual void abort();
+	virtual bool isConnecting() {
+		return true;
+	}
+	virtual bool allowWrite() {
+		return true;
+	}
+	virtual bool isEof() {
+		return false;
+	}
+	virtual bool setNoDelay(bool noDelay);
+private:
+	static const long ATTEMPT_DELAY_MILLIS = 250;
+
+	typedef std::shared_ptr<boost::asio::ip::tcp::socket> AttemptSocket;
+
+	boost::asio::deadline_timer attemptTimer_;
+	std::vector<boost::asio::ip::tcp::endpoint> endpoints_;
+	size_t nextEndpoint_;
+	std::vector<AttemptSocket> attempts_;
+
+	/**
+	 * Set once the connection is established or aborted, after which
+	 * all pending handlers must leave the socket alone.
+	 */
+	bool finished_;
+	bool noDelay_;
+
+	/**
+	 * The lookup in progress, which has to be cancelled on abort so that its
+	 * handler doesn't keep the socket alive until the lookup completes.
+	 */
+	ResolveCache::RequestId resolveRequest_;
+
+	typedef boost::asio::ip::tcp::resolver::protocol_type protocol_type;
+	void handleResolve(std::shared_ptr<TcpSocket> tcpSocket,
+			const boost::system::error_code &err,
+			boost::asio::ip::tcp::resolver::iterator endpointIterator);
+
+	void startConnectionAttempt(std::shared_ptr<TcpSocket> tcpSocket);
+
+	void handleAttemptTimer(std::shared_ptr<TcpSocket> tcpSocket,
+			const boost::system::error_code &err);
+
+	void handleConnect(std::shared_ptr<TcpSocket> tcpSocket,
+			const boost::system::error_code &err,
+			AttemptSocket attempt,
+			boost::asio::ip::tcp::endpoint endpoint);
+
+	void closeAttempts();
+};
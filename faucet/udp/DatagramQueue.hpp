@@ -1,83 +1,463 @@
-#pragma once
-
-#include <faucet/Buffer.hpp>
-
-#include <memory>
-#include <string>
-#include <deque>
-
-struct QueueItem {
-	QueueItem(std::shared_ptr<Buffer> buffer,
-			std::string hostname, uint16_t port) :
-			memSize(sizeof(QueueItem)+buffer->size()), buffer(buffer), remoteHost(hostname), remotePort(port) {
-	}
-
-	const size_t memSize;
-	std::shared_ptr<Buffer> buffer;
-	std::string remoteHost;
-	uint16_t remotePort;
-};
-
-// TODO check how much copying goes on here, how move semantics might help
-class DatagramQueue {
-private:
-	static const size_t DEFAULT_MEM_LIMIT = 2*1024*1024;
-	size_t memSize_;
-	size_t memSizeLimit_;
-	std::deque<QueueItem> queue_;
-
-public:
-	DatagramQueue() : memSize_(0), memSizeLimit_(DEFAULT_MEM_LIMIT), queue_() {}
-
-	bool push(const QueueItem& item) {
-		bool datagramsDiscarded = false;
-		/*
-		 * The idea here is quite simple: We throw away the new datagram if it can't
-		 * possibly fit into the queue, otherwise we discard the oldest datagrams
-		 * from the queue to make space for the new one.
-		 */
-		if(memSizeLimit_ < item.memSize) {
-			return true;
-		}
-
-		while(memSize_ > memSizeLimit_ || memSizeLimit_ - memSize_ < item.memSize) {
-			pop();
-			datagramsDiscarded = true;
-		}
-
-		queue_.push_back(item);
-		memSize_ += item.memSize;
-		return datagramsDiscarded;
-	}
-
-	QueueItem& peek() {
-		return queue_.front();
-	}
-
-	void pop() {
-		if(!queue_.empty()) {
-			memSize_ -= queue_.front().memSize;
-			queue_.pop_front();
-		}
-	}
-
-	bool isEmpty() {
-		return queue_.empty();
-	}
-
-	void clear() {
-		queue_.clear();
-		memSize_ = 0;
-	}
-
-	size_t getMemSize() {
-		return memSize_;
-	}
-
-	void setMemSizeLimit(size_t limit) {
-		memSizeLimit_ = limit;
-		while(memSize_ > memSizeLimit_) {
-			pop();
-		}
-	}
-};
+#pragma once
+
+#include <faucet/Buffer.hpp>
+#include <faucet/Asio.hpp>
+#include <faucet/LatencyHistogram.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <map>
+#include <set>
+#include <deque>
+#include <algorithm>
+
+/**
+ * A datagram along with its remote endpoint. Items own their buffer and can
+ * only be moved, so queueing a datagram never copies its data.
+ */
+struct QueueItem {
+	QueueItem() : buffer(), endpoint(), remoteHost(), toPeer(false), priority(0), queuedAt() {}
+
+	QueueItem(std::unique_ptr<Buffer> buffer,
+			const boost::asio::ip::udp::endpoint &endpoint) :
+			buffer(std::move(buffer)), endpoint(endpoint), remoteHost(), toPeer(false), priority(0), queuedAt() {
+	}
+
+	/**
+	 * Create an item for the peer the socket is connected to.
+	 */
+	explicit QueueItem(std::unique_ptr<Buffer> buffer) :
+			buffer(std::move(buffer)), endpoint(), remoteHost(), toPeer(true), priority(0), queuedAt() {
+	}
+
+	/**
+	 * Create an item for a hostname which still needs to be resolved.
+	 */
+	QueueItem(std::unique_ptr<Buffer> buffer,
+			std::string hostname, uint16_t port) :
+			buffer(std::move(buffer)), endpoint(boost::asio::ip::address(), port), remoteHost(hostname), toPeer(false), priority(0), queuedAt() {
+	}
+
+	QueueItem(QueueItem &&other) :
+			buffer(std::move(other.buffer)), endpoint(other.endpoint), remoteHost(std::move(other.remoteHost)),
+			toPeer(other.toPeer), priority(other.priority), queuedAt(other.queuedAt) {
+	}
+
+	QueueItem &operator=(QueueItem &&other) {
+		buffer = std::move(other.buffer);
+		endpoint = other.endpoint;
+		remoteHost = std::move(other.remoteHost);
+		toPeer = other.toPeer;
+		priority = other.priority;
+		queuedAt = other.queuedAt;
+		return *this;
+	}
+
+	/**
+	 * The number of bytes of memory this item occupies, including its buffer.
+	 */
+	size_t memSize() const {
+		return sizeof(QueueItem) + (buffer ? sizeof(Buffer) + buffer->capacity() : 0) + remoteHost.capacity();
+	}
+
+	std::unique_ptr<Buffer> buffer;
+
+	/**
+	 * The remote endpoint. If remoteHost is set, only the port is valid.
+	 */
+	boost::asio::ip::udp::endpoint endpoint;
+	std::string remoteHost;
+	bool toPeer;
+
+	/**
+	 * Only used by the DROP_PRIORITY policy, higher values are kept longer.
+	 */
+	uint8_t priority;
+
+	/**
+	 * When the datagram was added to the send queue.
+	 */
+	LatencyClock::time_point queuedAt;
+};
+
+/**
+ * What DatagramQueue::push() discards when the memory limit is reached.
+ * The values are part of the API.
+ */
+enum DropPolicy {
+	/**
+	 * Discard the oldest datagrams in the queue.
+	 */
+	DROP_OLDEST = 0,
+
+	/**
+	 * Discard the new datagram.
+	 */
+	DROP_NEWEST = 1,
+
+	/**
+	 * Discard the oldest datagram of the endpoint which has the most bytes
+	 * queued, so that a single flooding sender can't push out everyone else.
+	 */
+	DROP_FAIR = 2,
+
+	/**
+	 * Discard the oldest datagram of the lowest priority, or the new one
+	 * if its priority is lower than that of all queued datagrams.
+	 */
+	DROP_PRIORITY = 3
+};
+
+/**
+ * Cumulative statistics of a DatagramQueue. Bytes are counted as the size
+ * of the datagrams, while the high water mark is the largest amount of memory
+ * the queue has held.
+ */
+struct DatagramQueueCounters {
+	DatagramQueueCounters() : pushedDatagrams(0), pushedBytes(0), droppedDatagrams(0),
+			droppedBytes(0), highWaterMark(0), lastDropped() {}
+
+	uint64_t pushedDatagrams;
+	uint64_t pushedBytes;
+	uint64_t droppedDatagrams;
+	uint64_t droppedBytes;
+	size_t highWaterMark;
+
+	/**
+	 * The endpoint of the most recently dropped datagram.
+	 */
+	boost::asio::ip::udp::endpoint lastDropped;
+};
+
+/**
+ * A FIFO queue of datagrams with a limit on the memory used. The items are
+ * kept in a ring buffer which only grows, so pushing and popping don't allocate
+ * once the queue has reached its working size.
+ *
+ * Datagrams dropped from the middle of the queue leave a gap in the ring, which
+ * is skipped once it reaches the head. To find victims without scanning the queue,
+ * DROP_FAIR and DROP_PRIORITY keep the positions of the queued datagrams per
+ * endpoint or priority. A victim is always the oldest of its endpoint or priority,
+ * so these only ever lose their first position.
+ */
+class DatagramQueue {
+private:
+	static const size_t DEFAULT_MEM_LIMIT = 2*1024*1024;
+	static const size_t INITIAL_CAPACITY = 16;
+
+	/**
+	 * Returned by findVictim() if the new item should be dropped.
+	 */
+	static const size_t NEW_ITEM = static_cast<size_t>(-1);
+
+	/**
+	 * Positions count up from the first item ever queued, so they stay valid
+	 * while the head moves. The offset of a position is position - headPosition_.
+	 */
+	typedef uint64_t Position;
+
+	struct EndpointItems {
+		EndpointItems() : memSize(0), positions() {}
+
+		size_t memSize;
+		std::deque<Position> positions;
+	};
+
+	size_t memSize_;
+	size_t memSizeLimit_;
+
+	/*
+	 * The ring holds count_ slots from head_ on, of which liveCount_ are queued
+	 * items. Gaps have an item size of 0. The slot at the head is never a gap.
+	 */
+	std::vector<QueueItem> ring_;
+	std::vector<size_t> itemSizes_;
+	size_t head_;
+	size_t count_;
+	size_t liveCount_;
+	Position headPosition_;
+
+	DropPolicy dropPolicy_;
+	DatagramQueueCounters counters_;
+
+	/*
+	 * Only maintained with DROP_FAIR, the endpoints are also ordered by memory used.
+	 */
+	typedef std::map<boost::asio::ip::udp::endpoint, EndpointItems> EndpointItemsMap;
+	EndpointItemsMap endpointItems_;
+	std::set<std::pair<size_t, EndpointItems*> > endpointsBySize_;
+
+	/*
+	 * Only maintained with DROP_PRIORITY.
+	 */
+	std::map<uint8_t, std::deque<Position> > priorityItems_;
+
+	size_t indexAt(size_t offset) const {
+		return (head_ + offset) % ring_.size();
+	}
+
+	/**
+	 * Make room in the full ring by closing the gaps, and double its size
+	 * if it would still be more than half full.
+	 */
+	void compact() {
+		size_t newCapacity = ring_.size();
+		if(ring_.empty()) {
+			newCapacity = INITIAL_CAPACITY;
+		} else if(liveCount_ * 2 > ring_.size()) {
+			newCapacity = ring_.size() * 2;
+		}
+		std::vector<QueueItem> newRing(newCapacity);
+		std::vector<size_t> newItemSizes(newCapacity);
+		size_t newCount = 0;
+		for(size_t i = 0; i < count_; ++i) {
+			size_t index = indexAt(i);
+			if(itemSizes_[index] != 0) {
+				newRing[newCount] = std::move(ring_[index]);
+				newItemSizes[newCount] = itemSizes_[index];
+				++newCount;
+			}
+		}
+		ring_.swap(newRing);
+		itemSizes_.swap(newItemSizes);
+		head_ = 0;
+		count_ = newCount;
+		rebuildIndex();
+	}
+
+	static size_t dataSize(const QueueItem &item) {
+		return item.buffer ? item.buffer->size() : 0;
+	}
+
+	void countDrop(const QueueItem &item) {
+		++counters_.droppedDatagrams;
+		counters_.droppedBytes += dataSize(item);
+		counters_.lastDropped = item.endpoint;
+	}
+
+	void changeEndpointSize(EndpointItems &items, size_t newSize) {
+		if(items.memSize != 0) {
+			endpointsBySize_.erase(std::make_pair(items.memSize, &items));
+		}
+		items.memSize = newSize;
+		if(newSize != 0) {
+			endpointsBySize_.insert(std::make_pair(newSize, &items));
+		}
+	}
+
+	/**
+	 * Add a newly queued item to the index of the drop policy.
+	 */
+	void track(const QueueItem &item, size_t itemSize, Position position) {
+		if(dropPolicy_ == DROP_FAIR) {
+			EndpointItems &items = endpointItems_[item.endpoint];
+			changeEndpointSize(items, items.memSize + itemSize);
+			items.positions.push_back(position);
+		} else if(dropPolicy_ == DROP_PRIORITY) {
+			priorityItems_[item.priority].push_back(position);
+		}
+	}
+
+	/**
+	 * Remove an item from the index of the drop policy. It must be the oldest
+	 * of its endpoint or priority.
+	 */
+	void untrack(const QueueItem &item, size_t itemSize) {
+		if(dropPolicy_ == DROP_FAIR) {
+			auto items = endpointItems_.find(item.endpoint);
+			changeEndpointSize(items->second, items->second.memSize - itemSize);
+			items->second.positions.pop_front();
+			if(items->second.positions.empty()) {
+				endpointItems_.erase(items);
+			}
+		} else if(dropPolicy_ == DROP_PRIORITY) {
+			auto items = priorityItems_.find(item.priority);
+			items->second.pop_front();
+			if(items->second.empty()) {
+				priorityItems_.erase(items);
+			}
+		}
+	}
+
+	void rebuildIndex() {
+		endpointItems_.clear();
+		endpointsBySize_.clear();
+		priorityItems_.clear();
+		for(size_t i = 0; i < count_; ++i) {
+			size_t index = indexAt(i);
+			if(itemSizes_[index] != 0) {
+				track(ring_[index], itemSizes_[index], headPosition_ + i);
+			}
+		}
+	}
+
+	/**
+	 * Return the offset of the queued item to drop for the new one, or NEW_ITEM.
+	 */
+	size_t findVictim(const QueueItem &newItem, size_t newItemSize) {
+		switch(dropPolicy_) {
+		case DROP_NEWEST:
+			return NEW_ITEM;
+
+		case DROP_FAIR: {
+			if(endpointsBySize_.empty()) {
+				return NEW_ITEM;
+			}
+			const EndpointItems *heaviest = endpointsBySize_.rbegin()->second;
+
+			auto newEndpoint = endpointItems_.find(newItem.endpoint);
+			if(newEndpoint == endpointItems_.end()) {
+				return (newItemSize > heaviest->memSize) ? NEW_ITEM
+						: static_cast<size_t>(heaviest->positions.front() - headPosition_);
+			}
+
+			size_t newEndpointSize = newItemSize + newEndpoint->second.memSize;
+			const EndpointItems *victim = (newEndpointSize > heaviest->memSize) ? &newEndpoint->second : heaviest;
+			return static_cast<size_t>(victim->positions.front() - headPosition_);
+		}
+
+		case DROP_PRIORITY: {
+			if(priorityItems_.empty()) {
+				return NEW_ITEM;
+			}
+			auto lowest = priorityItems_.begin();
+			return newItem.priority < lowest->first ? NEW_ITEM
+					: static_cast<size_t>(lowest->second.front() - headPosition_);
+		}
+
+		default:
+			return 0;
+		}
+	}
+
+	/**
+	 * Remove the item at the given offset from the queue, leaving a gap
+	 * unless it is at the head.
+	 */
+	void removeAt(size_t offset) {
+		size_t index = indexAt(offset);
+		memSize_ -= itemSizes_[index];
+		untrack(ring_[index], itemSizes_[index]);
+		ring_[index] = QueueItem();
+		itemSizes_[index] = 0;
+		--liveCount_;
+
+		while(count_ > 0 && itemSizes_[head_] == 0) {
+			head_ = (head_ + 1) % ring_.size();
+			++headPosition_;
+			--count_;
+		}
+	}
+
+	void dropAt(size_t offset) {
+		countDrop(ring_[indexAt(offset)]);
+		removeAt(offset);
+	}
+
+public:
+	DatagramQueue() : memSize_(0), memSizeLimit_(DEFAULT_MEM_LIMIT), ring_(), itemSizes_(), head_(0), count_(0),
+			liveCount_(0), headPosition_(0), dropPolicy_(DROP_OLDEST), counters_(), endpointItems_(),
+			endpointsBySize_(), priorityItems_() {}
+
+	/**
+	 * Add the item to the end of the queue. Returns true if any datagrams
+	 * had to be discarded to stay within the memory limit, which may
+	 * include the new one depending on the drop policy.
+	 */
+	bool push(QueueItem &&item) {
+		bool datagramsDiscarded = false;
+		size_t itemSize = item.memSize();
+		++counters_.pushedDatagrams;
+		counters_.pushedBytes += dataSize(item);
+
+		// A datagram which can't possibly fit into the queue is always thrown away
+		if(memSizeLimit_ < itemSize) {
+			countDrop(item);
+			return true;
+		}
+
+		while(memSize_ > memSizeLimit_ || memSizeLimit_ - memSize_ < itemSize) {
+			size_t victim = findVictim(item, itemSize);
+			if(victim == NEW_ITEM) {
+				countDrop(item);
+				return true;
+			}
+			dropAt(victim);
+			datagramsDiscarded = true;
+		}
+
+		if(count_ == ring_.size()) {
+			compact();
+		}
+		size_t index = indexAt(count_);
+		track(item, itemSize, headPosition_ + count_);
+		ring_[index] = std::move(item);
+		itemSizes_[index] = itemSize;
+		++count_;
+		++liveCount_;
+		memSize_ += itemSize;
+		counters_.highWaterMark = std::max(counters_.highWaterMark, memSize_);
+		return datagramsDiscarded;
+	}
+
+	QueueItem& peek() {
+		return ring_[head_];
+	}
+
+	void pop() {
+		if(count_ > 0) {
+			removeAt(0);
+		}
+	}
+
+	/**
+	 * Remove the first item from the queue and return it.
+	 */
+	QueueItem take() {
+		QueueItem item(std::move(peek()));
+		pop();
+		return item;
+	}
+
+	bool isEmpty() {
+		return count_ == 0;
+	}
+
+	size_t size() {
+		return liveCount_;
+	}
+
+	void clear() {
+		while(count_ > 0) {
+			pop();
+		}
+		memSize_ = 0;
+		rebuildIndex();
+	}
+
+	size_t getMemSize() {
+		return memSize_;
+	}
+
+	void setMemSizeLimit(size_t limit) {
+		memSizeLimit_ = limit;
+		while(memSize_ > memSizeLimit_) {
+			dropAt(0);
+		}
+	}
+
+	void setDropPolicy(DropPolicy policy) {
+		dropPolicy_ = policy;
+		rebuildIndex();
+	}
+
+	DropPolicy getDropPolicy() {
+		return dropPolicy_;
+	}
+
+	const DatagramQueueCounters &getCounters() {
+		return counters_;
+	}
+};
@@ -0,0 +1,155 @@
+#include "Fragmentation.hpp"
+
+#include <algorithm>
+
+namespace {
+	boost::posix_time::ptime now() {
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	void putUint16(uint8_t *out, uint16_t value) {
+		out[0] = static_cast<uint8_t>(value);
+		out[1] = static_cast<uint8_t>(value >> 8);
+	}
+
+	uint16_t getUint16(const uint8_t *in) {
+		return static_cast<uint16_t>(in[0] | (in[1] << 8));
+	}
+}
+
+std::vector<std::unique_ptr<Buffer> > splitIntoFragments(const Buffer &message, size_t maxDatagramSize,
+		uint32_t messageId) {
+	std::vector<std::unique_ptr<Buffer> > fragments;
+	size_t fragmentSize = maxDatagramSize - FRAGMENT_HEADER_SIZE;
+	size_t count = (message.size() + fragmentSize - 1) / fragmentSize;
+	if (count > MAX_FRAGMENTS) {
+		return fragments;
+	}
+
+	for (size_t index = 0; index < count; ++index) {
+		uint8_t header[FRAGMENT_HEADER_SIZE];
+		header[0] = DATAGRAM_FRAGMENT;
+		for (size_t i = 0; i < 4; ++i) {
+			header[1 + i] = static_cast<uint8_t>(messageId >> (8 * i));
+		}
+		putUint16(header + 5, static_cast<uint16_t>(index));
+		putUint16(header + 7, static_cast<uint16_t>(count));
+
+		size_t offset = index * fragmentSize;
+		size_t size = std::min(fragmentSize, message.size() - offset);
+		std::unique_ptr<Buffer> fragment(new Buffer());
+		fragment->prepareWrite(FRAGMENT_HEADER_SIZE + size);
+		fragment->write(header, FRAGMENT_HEADER_SIZE);
+		fragment->write(message.getData() + offset, size);
+		fragments.push_back(std::move(fragment));
+	}
+	return fragments;
+}
+
+const long FragmentReassembler::TIMEOUT_MILLIS;
+
+FragmentReassembler::FragmentReassembler() :
+		partialMessages_(), memSize_(0), lastExpiryCheck_(now()) {
+}
+
+bool FragmentReassembler::add(const uint8_t *data, size_t size, const boost::asio::ip::udp::endpoint &sender,
+		Buffer &target) {
+	if (size < FRAGMENT_HEADER_SIZE) {
+		return false;
+	}
+
+	uint32_t messageId = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		messageId |= static_cast<uint32_t>(data[1 + i]) << (8 * i);
+	}
+	size_t index = getUint16(data + 5);
+	size_t count = getUint16(data + 7);
+	if (count == 0 || count > MAX_FRAGMENTS || index >= count) {
+		return false;
+	}
+
+	boost::posix_time::ptime currentTime = now();
+	if (currentTime - lastExpiryCheck_ >= boost::posix_time::seconds(1)) {
+		dropExpired(currentTime);
+		lastExpiryCheck_ = currentTime;
+	}
+
+	MessageKey key(sender, messageId);
+	auto found = partialMessages_.find(key);
+	if (found != partialMessages_.end() && found->second.fragments.size() != count) {
+		// Same id but a different message, the old one is not going to be completed anymore
+		memSize_ -= found->second.memSize;
+		partialMessages_.erase(found);
+		found = partialMessages_.end();
+	}
+
+	if (found == partialMessages_.end()) {
+		if (partialMessages_.size() >= MAX_PARTIAL_MESSAGES) {
+			dropOldest();
+		}
+		PartialMessage &message = partialMessages_[key];
+		message.started = currentTime;
+		message.received = 0;
+		message.fragments.resize(count);
+		message.memSize = count * sizeof(std::vector<uint8_t>);
+		memSize_ += message.memSize;
+		found = partialMessages_.find(key);
+	}
+
+	PartialMessage &message = found->second;
+	std::vector<uint8_t> &fragment = message.fragments[index];
+	if (!fragment.empty() || size == FRAGMENT_HEADER_SIZE) {
+		// Duplicate, or an empty fragment which can't be told apart from a missing one
+		return false;
+	}
+
+	fragment.assign(data + FRAGMENT_HEADER_SIZE, data + size);
+	message.memSize += fragment.size();
+	memSize_ += fragment.size();
+	++message.received;
+
+	if (message.received == count) {
+		target.clear();
+		for (size_t i = 0; i < count; ++i) {
+			target.write(message.fragments[i].data(), message.fragments[i].size());
+		}
+		memSize_ -= message.memSize;
+		partialMessages_.erase(found);
+		return true;
+	}
+
+	while (memSize_ > MAX_MEMORY && !partialMessages_.empty()) {
+		dropOldest();
+	}
+	return false;
+}
+
+void FragmentReassembler::clear() {
+	partialMessages_.clear();
+	memSize_ = 0;
+}
+
+void FragmentReassembler::dropExpired(const boost::posix_time::ptime &now) {
+	for (auto it = partialMessages_.begin(); it != partialMessages_.end();) {
+		if (now - it->second.started >= boost::posix_time::milliseconds(TIMEOUT_MILLIS)) {
+			memSize_ -= it->second.memSize;
+			partialMessages_.erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+void FragmentReassembler::dropOldest() {
+	auto oldest = partialMessages_.begin();
+	for (auto it = partialMessages_.begin(); it != partialMessages_.end(); ++it) {
+		if (it->second.started < oldest->second.started) {
+			oldest = it;
+		}
+	}
+
+	if (oldest != partialMessages_.end()) {
+		memSize_ -= oldest->second.memSize;
+		partialMessages_.erase(oldest);
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <faucet/Buffer.hpp>
+#include <faucet/Asio.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <memory>
+#include <vector>
+#include <map>
+#include <utility>
+
+/*
+ * When fragmentation is enabled on a UdpSocket, every datagram starts with a
+ * one byte type. A whole message is sent as DATAGRAM_WHOLE followed by the data.
+ * Larger messages are split into DATAGRAM_FRAGMENT datagrams, each with a header
+ * of the message id (uint32), the fragment index and the fragment count (uint16
+ * each, little endian), followed by a part of the data.
+ */
+enum DatagramType {
+	DATAGRAM_WHOLE = 0,
+	DATAGRAM_FRAGMENT = 1
+};
+
+const size_t WHOLE_HEADER_SIZE = 1;
+const size_t FRAGMENT_HEADER_SIZE = 9;
+
+/**
+ * Messages which would need more fragments than this are not sent.
+ */
+const size_t MAX_FRAGMENTS = 1024;
+
+/**
+ * Split the message into datagrams of at most maxDatagramSize bytes, including
+ * the headers described above. Returns an empty list if the message is too large.
+ */
+std::vector<std::unique_ptr<Buffer> > splitIntoFragments(const Buffer &message, size_t maxDatagramSize,
+		uint32_t messageId);
+
+/**
+ * Collects fragments until a message is complete. Partial messages are dropped
+ * when they are not completed within a timeout, or when the total memory held
+ * by partial messages would exceed a limit, oldest first. Not thread safe.
+ */
+class FragmentReassembler {
+public:
+	FragmentReassembler();
+
+	/**
+	 * Process a DATAGRAM_FRAGMENT datagram, including its header. If it completes
+	 * a message, the message is written to target and true is returned.
+	 */
+	bool add(const uint8_t *data, size_t size, const boost::asio::ip::udp::endpoint &sender, Buffer &target);
+
+	void clear();
+
+private:
+	static const size_t MAX_MEMORY = 4*1024*1024;
+	static const size_t MAX_PARTIAL_MESSAGES = 64;
+	static const long TIMEOUT_MILLIS = 5000;
+
+	struct PartialMessage {
+		boost::posix_time::ptime started;
+		size_t received;
+		size_t memSize;
+		std::vector<std::vector<uint8_t> > fragments;
+	};
+
+	typedef std::pair<boost::asio::ip::udp::endpoint, uint32_t> MessageKey;
+
+	void dropExpired(const boost::posix_time::ptime &now);
+	void dropOldest();
+
+	std::map<MessageKey, PartialMessage> partialMessages_;
+	size_t memSize_;
+	boost::posix_time::ptime lastExpiryCheck_;
+};
@@ -0,0 +1,640 @@
+#include "ReliableUdpConnection.hpp"
+
+#include <faucet/EventQueue.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+/*
+ * Wire format, all numbers little endian:
+ *
+ * uint8  packet type
+ * uint32 nonce of the sending connection, never 0
+ * uint32 nonce of the receiving connection as last seen by the sender, 0 if none
+ * uint32 sequence number of the latest packet received from the peer, 0 if none
+ * uint32 bit field, bit i is set if the packet before that by i+1 was received
+ *
+ * Data packets continue with:
+ *
+ * uint32 packet sequence number, starting at 1 and skipping 0 when it wraps around
+ * uint8  channel
+ * uint8  channel mode
+ * uint32 message sequence number within the channel, counted separately for
+ *        reliable and unreliable messages, starting at 1
+ * the message
+ */
+namespace {
+	enum PacketType {
+		PACKET_ACK = 0,
+		PACKET_DATA = 1
+	};
+
+	const size_t ACK_HEADER_SIZE = 17;
+	const size_t DATA_HEADER_SIZE = ACK_HEADER_SIZE + 10;
+
+	void putUint32(uint8_t *out, uint32_t value) {
+		for (size_t i = 0; i < 4; ++i) {
+			out[i] = static_cast<uint8_t>(value >> (8 * i));
+		}
+	}
+
+	uint32_t getUint32(const uint8_t *in) {
+		uint32_t value = 0;
+		for (size_t i = 0; i < 4; ++i) {
+			value |= static_cast<uint32_t>(in[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	boost::posix_time::ptime now() {
+		return boost::posix_time::microsec_clock::universal_time();
+	}
+
+	/**
+	 * Whether sequence number a comes after b, with wraparound (RFC 1982).
+	 */
+	bool sequenceAfter(uint32_t a, uint32_t b) {
+		return a != b && a - b < 0x80000000u;
+	}
+
+	/**
+	 * A random nonce other than 0. std::random_device is deterministic with some
+	 * MinGW versions, so the clock and the address of the connection are mixed in.
+	 */
+	uint32_t makeNonce(const void *salt) {
+		std::random_device device;
+		uint64_t ticks = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		std::seed_seq seed({device(), static_cast<uint32_t>(ticks), static_cast<uint32_t>(ticks >> 32),
+				static_cast<uint32_t>(reinterpret_cast<uintptr_t>(salt))});
+		std::mt19937 generator(seed);
+		uint32_t nonce;
+		do {
+			nonce = generator();
+		} while (nonce == 0);
+		return nonce;
+	}
+}
+
+const long ReliableUdpConnection::TICK_MILLIS;
+
+ReliableUdpConnection::ReliableUdpConnection() :
+		commonMutex_(), socket_(), tickTimer_(Asio::getIoService()), tickScheduled_(false),
+		hasError_(false), errorMessage_(), localNonce_(makeNonce(this)), remoteNonce_(0),
+		retiredNonces_(), nextPacketSequence_(1), inFlight_(), sendqueue_(),
+		sendqueueSize_(0), sendqueueLimit_(std::numeric_limits<size_t>::max()), remoteSequence_(0),
+		remoteAckBits_(0), ackPending_(false), packetsSinceAck_(0), smoothedRtt_(0), rttVariance_(0),
+		hasRttSample_(false), receivequeue_(), receivequeueSize_(0), receiving_(true),
+		receiveBuffer_(new Buffer()), receiveChannel_(0), sendBuffer_() {
+	getStats().detachFromGlobal();
+}
+
+ReliableUdpConnection::~ReliableUdpConnection() {
+}
+
+std::shared_ptr<ReliableUdpConnection> ReliableUdpConnection::error(const std::string &message) {
+	std::shared_ptr<ReliableUdpConnection> connection(new ReliableUdpConnection());
+	connection->hasError_ = true;
+	connection->errorMessage_ = message;
+	return connection;
+}
+
+std::shared_ptr<ReliableUdpConnection> ReliableUdpConnection::connect(uint16_t localPort,
+		const std::string &host, uint16_t port) {
+	std::shared_ptr<UdpSocket> socket = UdpSocket::bind(localPort);
+	if (socket->hasError()) {
+		return error(socket->getErrorMessage());
+	}
+
+	std::shared_ptr<ReliableUdpConnection> connection(new ReliableUdpConnection());
+	connection->socket_ = socket;
+	socket->setReceiveListener(boost::bind(&ReliableUdpConnection::handleReceive,
+			std::weak_ptr<ReliableUdpConnection>(connection)));
+	socket->connect(host, port);
+	return connection;
+}
+
+std::string ReliableUdpConnection::getErrorMessage() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return errorMessage_;
+}
+
+bool ReliableUdpConnection::hasError() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return hasError_;
+}
+
+void ReliableUdpConnection::write(const uint8_t *in, size_t size) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendBuffer_.write(in, size);
+}
+
+size_t ReliableUdpConnection::read(uint8_t *out, size_t size) {
+	return receiveBuffer_->read(out, size);
+}
+
+std::string ReliableUdpConnection::readString(size_t size) {
+	return receiveBuffer_->readString(size);
+}
+
+size_t ReliableUdpConnection::bytesRemaining() const {
+	return receiveBuffer_->bytesRemaining();
+}
+
+void ReliableUdpConnection::setReadpos(size_t pos) {
+	receiveBuffer_->setReadpos(pos);
+}
+
+size_t ReliableUdpConnection::getSendbufferSize() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return sendqueueSize_ + sendBuffer_.size();
+}
+
+size_t ReliableUdpConnection::getReceivebufferSize() {
+	return receiveBuffer_->size();
+}
+
+void ReliableUdpConnection::setSendbufferLimit(size_t maxSize) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendqueueLimit_ = maxSize;
+}
+
+Buffer &ReliableUdpConnection::getReceiveBuffer() {
+	return *receiveBuffer_;
+}
+
+std::string ReliableUdpConnection::getRemoteIp() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return socket_ ? socket_->getRemoteIp() : "";
+}
+
+uint16_t ReliableUdpConnection::getRemotePort() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return socket_ ? socket_->getRemotePort() : 0;
+}
+
+uint64_t ReliableUdpConnection::getRemoteEndpointId() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return socket_ ? socket_->getRemoteEndpointId() : 0;
+}
+
+uint16_t ReliableUdpConnection::getLocalPort() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return socket_ ? socket_->getLocalPort() : 0;
+}
+
+bool ReliableUdpConnection::setChannelMode(size_t channel, ChannelMode mode) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (channel >= MAX_CHANNELS) {
+		return false;
+	}
+	channels_[channel].mode = mode;
+	return true;
+}
+
+bool ReliableUdpConnection::send(size_t channel) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (hasError_ || !socket_ || channel >= MAX_CHANNELS || sendBuffer_.size() > MAX_MESSAGE_SIZE) {
+		return false;
+	}
+
+	ChannelState &state = channels_[channel];
+	OutgoingMessage message;
+	message.channel = static_cast<uint8_t>(channel);
+	message.mode = static_cast<uint8_t>(state.mode);
+	message.payload = std::make_shared<Buffer>();
+	message.payload->write(sendBuffer_.getData(), sendBuffer_.size());
+	message.retransmits = 0;
+
+	if (state.mode == UNRELIABLE_SEQUENCED) {
+		message.channelSequence = state.nextUnreliable++;
+		sendPacket(&message);
+	} else {
+		if (sendqueueSize_ + sendBuffer_.size() > sendqueueLimit_) {
+			return false;
+		}
+		message.channelSequence = state.nextReliable++;
+		sendqueueSize_ += sendBuffer_.size();
+		sendqueue_.push_back(message);
+		fillWindow();
+	}
+
+	getStats().increment(STAT_MESSAGES_SENT);
+	getStats().add(STAT_BYTES_SENT, sendBuffer_.size());
+	sendBuffer_.clear();
+	return true;
+}
+
+bool ReliableUdpConnection::receive() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (receivequeue_.empty()) {
+		return false;
+	}
+
+	receiveChannel_ = receivequeue_.front().first;
+	receiveBuffer_ = std::move(receivequeue_.front().second);
+	receivequeue_.pop_front();
+	receivequeueSize_ -= receiveBuffer_->size();
+	return true;
+}
+
+size_t ReliableUdpConnection::getReceiveChannel() {
+	return receiveChannel_;
+}
+
+double ReliableUdpConnection::getRoundTripTime() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return smoothedRtt_ * 1000;
+}
+
+void ReliableUdpConnection::close() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	inFlight_.clear();
+	sendqueue_.clear();
+	sendqueueSize_ = 0;
+	receivequeue_.clear();
+	receivequeueSize_ = 0;
+	sendBuffer_.clear();
+	receiveBuffer_->clear();
+	ackPending_ = false;
+	packetsSinceAck_ = 0;
+
+	boost::system::error_code ignored;
+	tickTimer_.cancel(ignored);
+	if (socket_) {
+		socket_->setReceiveListener(std::function<void()>());
+		socket_->close();
+	}
+}
+
+void ReliableUdpConnection::stopReceiving() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	receiving_ = false;
+	receivequeue_.clear();
+	receivequeueSize_ = 0;
+}
+
+/**
+ * Move messages from the send queue into flight as long as the window allows.
+ */
+void ReliableUdpConnection::fillWindow() {
+	while (!sendqueue_.empty() && inFlight_.size() < MAX_IN_FLIGHT) {
+		OutgoingMessage message = sendqueue_.front();
+		sendqueue_.pop_front();
+		sendqueueSize_ -= message.payload->size();
+		transmit(message);
+	}
+}
+
+/**
+ * Send a reliable message in a new packet and track it until it is acknowledged.
+ */
+void ReliableUdpConnection::transmit(OutgoingMessage &message) {
+	uint32_t sequence = nextPacketSequence_;
+	message.sentAt = now();
+	sendPacket(&message);
+	inFlight_[sequence] = message;
+	scheduleTick();
+}
+
+/**
+ * Send a packet with the current acknowledgement state, and the message if there is one.
+ */
+void ReliableUdpConnection::sendPacket(const OutgoingMessage *message) {
+	uint8_t header[DATA_HEADER_SIZE];
+	header[0] = message ? PACKET_DATA : PACKET_ACK;
+	putUint32(header + 1, localNonce_);
+	putUint32(header + 5, remoteNonce_);
+	putUint32(header + 9, remoteSequence_);
+	putUint32(header + 13, remoteAckBits_);
+	ackPending_ = false;
+	packetsSinceAck_ = 0;
+
+	if (message) {
+		putUint32(header + 17, nextPacketSequence_);
+		if (++nextPacketSequence_ == 0) {
+			nextPacketSequence_ = 1;
+		}
+		header[21] = message->channel;
+		header[22] = message->mode;
+		putUint32(header + 23, message->channelSequence);
+		socket_->write(header, DATA_HEADER_SIZE);
+		socket_->write(message->payload->getData(), message->payload->size());
+	} else {
+		socket_->write(header, ACK_HEADER_SIZE);
+	}
+	socket_->sendToPeer();
+}
+
+void ReliableUdpConnection::scheduleTick() {
+	if (!tickScheduled_ && !hasError_) {
+		tickScheduled_ = true;
+		tickTimer_.expires_from_now(boost::posix_time::milliseconds(TICK_MILLIS));
+		tickTimer_.async_wait(boost::bind(&ReliableUdpConnection::handleTick,
+				shared_from_this(), boost::asio::placeholders::error));
+	}
+}
+
+/*
+ * The timer handler holds a strong reference, so that unacknowledged messages
+ * are still delivered after the handle has been destroyed.
+ */
+void ReliableUdpConnection::handleTick(std::shared_ptr<ReliableUdpConnection> connection,
+		const boost::system::error_code &error) {
+	boost::lock_guard<boost::recursive_mutex> guard(connection->commonMutex_);
+	connection->tickScheduled_ = false;
+	if (error || connection->hasError_) {
+		return;
+	}
+
+	if (connection->socket_->hasError()) {
+		connection->enterErrorState(connection->socket_->getErrorMessage());
+		return;
+	} else if (connection->socket_->getPeerState() == UdpSocket::PEER_FAILED) {
+		connection->enterErrorState("Unable to resolve the peer");
+		return;
+	}
+
+	boost::posix_time::ptime currentTime = now();
+	std::vector<OutgoingMessage> expired;
+	for (auto it = connection->inFlight_.begin(); it != connection->inFlight_.end();) {
+		if (currentTime - it->second.sentAt >= connection->getRetransmitTimeout(it->second.retransmits)) {
+			expired.push_back(it->second);
+			connection->inFlight_.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	for (size_t i = 0; i < expired.size(); ++i) {
+		if (expired[i].retransmits >= MAX_RETRANSMITS) {
+			connection->enterErrorState("The peer is not responding");
+			return;
+		}
+		++expired[i].retransmits;
+		connection->transmit(expired[i]);
+	}
+
+	if (connection->ackPending_) {
+		connection->sendPacket(0);
+	}
+
+	if (!connection->inFlight_.empty()) {
+		connection->scheduleTick();
+	}
+}
+
+void ReliableUdpConnection::handleReceive(std::weak_ptr<ReliableUdpConnection> ptr) {
+	std::shared_ptr<ReliableUdpConnection> connection = ptr.lock();
+	if (!connection) {
+		return;
+	}
+
+	boost::lock_guard<boost::recursive_mutex> guard(connection->commonMutex_);
+	bool wasEmpty = connection->receivequeue_.empty();
+	while (connection->socket_->receive()) {
+		Buffer &packet = connection->socket_->getReceiveBuffer();
+		connection->processPacket(packet.getData(), packet.size());
+	}
+
+	if (connection->ackPending_) {
+		connection->scheduleTick();
+	}
+	if (wasEmpty && !connection->receivequeue_.empty()) {
+		EventQueue::push(connection, EVENT_READABLE);
+	}
+}
+
+void ReliableUdpConnection::processPacket(const uint8_t *data, size_t size) {
+	if (size < ACK_HEADER_SIZE || (data[0] == PACKET_DATA && size < DATA_HEADER_SIZE)) {
+		return;
+	}
+
+	uint32_t nonce = getUint32(data + 1);
+	uint32_t echoedNonce = getUint32(data + 5);
+	if (nonce == 0 || std::find(retiredNonces_.begin(), retiredNonces_.end(), nonce) != retiredNonces_.end()) {
+		// Late packets of an earlier incarnation of the peer
+		return;
+	} else if (echoedNonce != 0 && echoedNonce != localNonce_) {
+		/*
+		 * Addressed to an earlier incarnation of this side. The peer only learns
+		 * of the restart from our nonce, so it gets an acknowledgement even if
+		 * this side has nothing to send.
+		 */
+		ackPending_ = true;
+		return;
+	}
+
+	if (nonce != remoteNonce_) {
+		uint32_t previousNonce = remoteNonce_;
+		remoteNonce_ = nonce;
+		if (previousNonce != 0) {
+			retiredNonces_.push_back(previousNonce);
+			if (retiredNonces_.size() > MAX_RETIRED_NONCES) {
+				retiredNonces_.pop_front();
+			}
+			handlePeerRestart();
+		}
+	}
+
+	processAcks(getUint32(data + 9), getUint32(data + 13));
+	if (data[0] == PACKET_DATA) {
+		uint32_t sequence = getUint32(data + 17);
+		if (processMessage(data[21], data[22], getUint32(data + 23), data + DATA_HEADER_SIZE,
+				size - DATA_HEADER_SIZE)) {
+			recordReceivedPacket(sequence);
+			ackPending_ = true;
+			if (++packetsSinceAck_ >= IMMEDIATE_ACK_PACKETS) {
+				sendPacket(0);
+			}
+		}
+	}
+}
+
+void ReliableUdpConnection::processAcks(uint32_t ack, uint32_t ackBits) {
+	if (ack == 0) {
+		return;
+	}
+
+	boost::posix_time::ptime currentTime = now();
+	for (uint32_t i = 0; i <= 32 && ack - i != 0; ++i) {
+		if (i > 0 && !(ackBits & (1u << (i - 1)))) {
+			continue;
+		}
+
+		auto it = inFlight_.find(ack - i);
+		if (it != inFlight_.end()) {
+			// Samples from retransmitted messages are ambiguous
+			if (it->second.retransmits == 0) {
+				updateRoundTripTime(currentTime - it->second.sentAt);
+			}
+			inFlight_.erase(it);
+		}
+	}
+	fillWindow();
+}
+
+/**
+ * Handle a received message. Returns false if the message was dropped and
+ * its packet must not be acknowledged.
+ */
+bool ReliableUdpConnection::processMessage(uint8_t channel, uint8_t mode, uint32_t channelSequence,
+		const uint8_t *data, size_t size) {
+	if (channel >= MAX_CHANNELS || mode > UNRELIABLE_SEQUENCED) {
+		return false;
+	}
+
+	ChannelState &state = channels_[channel];
+	if (mode == UNRELIABLE_SEQUENCED) {
+		if (sequenceAfter(channelSequence, state.lastSequenced)) {
+			state.lastSequenced = channelSequence;
+			if (receivequeueSize_ < MAX_RECEIVE_QUEUE_SIZE) {
+				std::unique_ptr<Buffer> message(new Buffer());
+				message->write(data, size);
+				deliver(channel, std::move(message));
+			}
+		}
+		return true;
+	}
+
+	if (sequenceAfter(state.expectedReliable, channelSequence) || state.pending.count(channelSequence)) {
+		// Duplicate, the acknowledgement was probably lost
+		return true;
+	} else if (channelSequence - state.expectedReliable >= MAX_REORDER_DISTANCE
+			|| receivequeueSize_ >= MAX_RECEIVE_QUEUE_SIZE) {
+		return false;
+	}
+
+	std::unique_ptr<Buffer> message(new Buffer());
+	message->write(data, size);
+	if (mode == RELIABLE_UNORDERED) {
+		deliver(channel, std::move(message));
+	}
+	state.pending[channelSequence] = std::move(message);
+
+	// Looked up one by one, because the order of the map breaks where the numbers wrap around
+	for (auto next = state.pending.find(state.expectedReliable); next != state.pending.end();
+			next = state.pending.find(state.expectedReliable)) {
+		if (next->second) {
+			deliver(channel, std::move(next->second));
+		}
+		state.pending.erase(next);
+		++state.expectedReliable;
+	}
+	return true;
+}
+
+void ReliableUdpConnection::recordReceivedPacket(uint32_t sequence) {
+	if (remoteSequence_ == 0 || sequenceAfter(sequence, remoteSequence_)) {
+		uint32_t shift = sequence - remoteSequence_;
+		if (remoteSequence_ == 0 || shift > 32) {
+			remoteAckBits_ = 0;
+		} else {
+			remoteAckBits_ = static_cast<uint32_t>(((static_cast<uint64_t>(remoteAckBits_) << 1) | 1) << (shift - 1));
+		}
+		remoteSequence_ = sequence;
+	} else if (sequenceAfter(remoteSequence_, sequence) && remoteSequence_ - sequence <= 32) {
+		remoteAckBits_ |= 1u << (remoteSequence_ - sequence - 1);
+	}
+}
+
+/**
+ * The peer has a new nonce, so it was restarted and knows nothing about the
+ * messages exchanged so far. It expects the messages of each channel to start
+ * at 1 again, so the unacknowledged reliable messages are renumbered and queued
+ * again, in the order in which they were sent. Already delivered messages stay
+ * in the receive queue.
+ */
+void ReliableUdpConnection::handlePeerRestart() {
+	remoteSequence_ = 0;
+	remoteAckBits_ = 0;
+	ackPending_ = false;
+	packetsSinceAck_ = 0;
+
+	std::vector<OutgoingMessage> unacknowledged;
+	for (auto it = inFlight_.begin(); it != inFlight_.end(); ++it) {
+		unacknowledged.push_back(it->second);
+	}
+	inFlight_.clear();
+	std::stable_sort(unacknowledged.begin(), unacknowledged.end(),
+			[](const OutgoingMessage &a, const OutgoingMessage &b) {
+		return a.channel < b.channel
+				|| (a.channel == b.channel && sequenceAfter(b.channelSequence, a.channelSequence));
+	});
+
+	for (size_t i = 0; i < MAX_CHANNELS; ++i) {
+		ChannelState &state = channels_[i];
+		state.nextReliable = 1;
+		state.nextUnreliable = 1;
+		state.expectedReliable = 1;
+		state.pending.clear();
+		state.lastSequenced = 0;
+	}
+
+	sendqueue_.insert(sendqueue_.begin(), unacknowledged.begin(), unacknowledged.end());
+	sendqueueSize_ = 0;
+	for (auto it = sendqueue_.begin(); it != sendqueue_.end(); ++it) {
+		it->channelSequence = channels_[it->channel].nextReliable++;
+		it->retransmits = 0;
+		sendqueueSize_ += it->payload->size();
+	}
+	fillWindow();
+}
+
+void ReliableUdpConnection::deliver(uint8_t channel, std::unique_ptr<Buffer> message) {
+	if (!receiving_) {
+		return;
+	}
+	getStats().increment(STAT_MESSAGES_RECEIVED);
+	getStats().add(STAT_BYTES_RECEIVED, message->size());
+	receivequeueSize_ += message->size();
+	receivequeue_.push_back(std::make_pair(channel, std::move(message)));
+}
+
+/**
+ * Update the round trip estimate as described in RFC 6298.
+ */
+void ReliableUdpConnection::updateRoundTripTime(boost::posix_time::time_duration sample) {
+	double seconds = sample.total_microseconds() / 1000000.0;
+	if (!hasRttSample_) {
+		smoothedRtt_ = seconds;
+		rttVariance_ = seconds / 2;
+		hasRttSample_ = true;
+	} else {
+		rttVariance_ = 0.75 * rttVariance_ + 0.25 * std::fabs(smoothedRtt_ - seconds);
+		smoothedRtt_ = 0.875 * smoothedRtt_ + 0.125 * seconds;
+	}
+}
+
+boost::posix_time::time_duration ReliableUdpConnection::getRetransmitTimeout(unsigned int retransmits) {
+	long millis = INITIAL_RTO_MILLIS;
+	if (hasRttSample_) {
+		millis = static_cast<long>((smoothedRtt_ + std::max(4 * rttVariance_, TICK_MILLIS / 1000.0)) * 1000);
+	}
+	if (millis < MIN_RTO_MILLIS) {
+		millis = MIN_RTO_MILLIS;
+	}
+	for (unsigned int i = 0; i < retransmits && millis < MAX_RTO_MILLIS; ++i) {
+		millis *= 2;
+	}
+	if (millis > MAX_RTO_MILLIS) {
+		millis = MAX_RTO_MILLIS;
+	}
+	return boost::posix_time::milliseconds(millis);
+}
+
+void ReliableUdpConnection::enterErrorState(const std::string &message) {
+	if (!hasError_) {
+		EventQueue::push(shared_from_this(), EVENT_ERROR);
+		getStats().increment(STAT_ERRORS);
+	}
+	hasError_ = true;
+	errorMessage_ = message;
+	inFlight_.clear();
+	sendqueue_.clear();
+	sendqueueSize_ = 0;
+}
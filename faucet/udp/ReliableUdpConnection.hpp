@@ -0,0 +1,274 @@
+#pragma once
+
+#include "UdpSocket.hpp"
+
+#include <faucet/Socket.hpp>
+#include <faucet/Asio.hpp>
+#include <faucet/Buffer.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/utility.hpp>
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <map>
+
+/**
+ * A connection to a single peer which delivers messages over a connected
+ * UdpSocket, with reliability handled on the IO thread.
+ *
+ * Each message is sent on one of MAX_CHANNELS channels in one of the modes
+ * below. Reliable messages are retransmitted until the peer acknowledges them,
+ * with a timeout based on the measured round trip time. Every packet carries
+ * the sequence number of the latest packet received from the peer and a bit
+ * field for the 32 packets before it, so losing a single acknowledgement does
+ * not cause a retransmission. Channels are ordered independently of each other,
+ * so a lost message only holds back later messages on its own channel.
+ *
+ * There is no handshake, both sides create a connection to each other. Each
+ * connection picks a random nonce which is sent with every packet, so that a peer
+ * which restarted is recognized: The receiving state is reset, and the reliable
+ * messages which haven't been acknowledged yet are renumbered and sent again.
+ * Packets echo the nonce of the peer; a restarted side answers packets meant for
+ * its earlier incarnation with an acknowledgement, so the peer learns of the
+ * restart even if nothing else is sent. Sequence numbers are compared with serial number arithmetic (RFC 1982), so they
+ * can wrap around.
+ *
+ * Acknowledgements without data wait for the next tick, so that they can ride
+ * on outgoing messages, unless IMMEDIATE_ACK_PACKETS packets are waiting for one.
+ * Received reliable messages are not acknowledged while the receive queue is
+ * full, which leaves it to the peer to send them again later.
+ *
+ * When the handle is destroyed, reliable messages which are still unacknowledged
+ * keep being retransmitted in the background until the peer has received them.
+ */
+class ReliableUdpConnection: public Socket,
+		public std::enable_shared_from_this<ReliableUdpConnection>,
+		boost::noncopyable {
+
+public:
+	/**
+	 * The values are part of the API and the wire format.
+	 */
+	enum ChannelMode {
+		RELIABLE_ORDERED = 0,
+		RELIABLE_UNORDERED = 1,
+		UNRELIABLE_SEQUENCED = 2
+	};
+
+	static const size_t MAX_CHANNELS = 16;
+
+	/**
+	 * Larger messages are refused, so that each message fits into a single
+	 * datagram on common network paths.
+	 */
+	static const size_t MAX_MESSAGE_SIZE = 1200;
+
+	virtual ~ReliableUdpConnection();
+
+	virtual std::string getErrorMessage();
+	virtual bool hasError();
+
+	// Functions required by the ReadWritable interface
+	virtual void write(const uint8_t *in, size_t size);
+	virtual size_t read(uint8_t *out, size_t size);
+	virtual std::string readString(size_t size);
+	virtual size_t bytesRemaining() const;
+	virtual void setReadpos(size_t pos);
+
+	virtual size_t getSendbufferSize();
+	virtual size_t getReceivebufferSize();
+	virtual void setSendbufferLimit(size_t maxSize);
+
+	virtual Buffer &getReceiveBuffer();
+
+	virtual std::string getRemoteIp();
+	virtual uint16_t getRemotePort();
+	virtual uint64_t getRemoteEndpointId();
+	virtual uint16_t getLocalPort();
+
+	/**
+	 * Set the mode used for messages sent on the channel. All channels
+	 * start out as RELIABLE_ORDERED. The receiver uses the mode of each
+	 * message as sent, so only the sender needs to configure its channels.
+	 */
+	bool setChannelMode(size_t channel, ChannelMode mode);
+
+	/**
+	 * Send the content of the send buffer as one message on the given channel.
+	 * Returns false and keeps the send buffer if the message can't be sent.
+	 */
+	bool send(size_t channel);
+
+	/**
+	 * Move the next delivered message into the receive buffer.
+	 */
+	bool receive();
+
+	/**
+	 * The channel of the message in the receive buffer.
+	 */
+	size_t getReceiveChannel();
+
+	/**
+	 * The smoothed round trip time in milliseconds.
+	 */
+	double getRoundTripTime();
+
+	void close();
+
+	/**
+	 * Called when the handle is destroyed without the abortive flag. Sending
+	 * goes on until everything is acknowledged, but received messages are
+	 * discarded from now on, because nobody will read them.
+	 */
+	void stopReceiving();
+
+	static std::shared_ptr<ReliableUdpConnection> error(const std::string &message);
+	static std::shared_ptr<ReliableUdpConnection> connect(uint16_t localPort, const std::string &host, uint16_t port);
+
+private:
+	/**
+	 * Interval of the IO thread timer which sends delayed acknowledgements
+	 * and retransmits, while there is anything to do.
+	 */
+	static const long TICK_MILLIS = 10;
+
+	static const long INITIAL_RTO_MILLIS = 250;
+	static const long MIN_RTO_MILLIS = 50;
+	static const long MAX_RTO_MILLIS = 2000;
+
+	/**
+	 * The connection fails if a message has been retransmitted this often.
+	 */
+	static const unsigned int MAX_RETRANSMITS = 12;
+
+	/**
+	 * Maximum number of unacknowledged reliable messages. Further messages
+	 * wait in the send queue.
+	 */
+	static const size_t MAX_IN_FLIGHT = 256;
+
+	/**
+	 * Reliable messages further ahead of the next expected one are dropped
+	 * without acknowledgement, which bounds the memory used for reordering.
+	 */
+	static const uint32_t MAX_REORDER_DISTANCE = 1024;
+
+	/**
+	 * Number of earlier nonces of the peer whose late packets are ignored,
+	 * instead of being taken for another restart.
+	 */
+	static const size_t MAX_RETIRED_NONCES = 8;
+
+	/**
+	 * Packets are acknowledged right away once this many have arrived since the
+	 * last acknowledgement, instead of waiting for the next tick. An ack covers
+	 * 33 packets, so with one-way traffic the sender learns of every packet.
+	 */
+	static const size_t IMMEDIATE_ACK_PACKETS = 16;
+
+	/**
+	 * Reliable messages are not acknowledged while the messages waiting to be
+	 * received take up this many bytes, so the peer retransmits them later.
+	 */
+	static const size_t MAX_RECEIVE_QUEUE_SIZE = 2*1024*1024;
+
+	struct OutgoingMessage {
+		uint8_t channel;
+		uint8_t mode;
+		uint32_t channelSequence;
+		std::shared_ptr<Buffer> payload;
+		boost::posix_time::ptime sentAt;
+		unsigned int retransmits;
+	};
+
+	/*
+	 * State of a channel. The sending side numbers its messages with nextReliable
+	 * and nextUnreliable. On the receiving side, reliable messages which arrived
+	 * ahead of expectedReliable are kept in pending, or as an empty entry if they
+	 * have already been delivered out of order.
+	 */
+	struct ChannelState {
+		ChannelState() : mode(RELIABLE_ORDERED), nextReliable(1), nextUnreliable(1),
+				expectedReliable(1), pending(), lastSequenced(0) {}
+
+		ChannelMode mode;
+		uint32_t nextReliable;
+		uint32_t nextUnreliable;
+
+		uint32_t expectedReliable;
+		std::map<uint32_t, std::unique_ptr<Buffer> > pending;
+		uint32_t lastSequenced;
+	};
+
+	ReliableUdpConnection();
+	void transmit(OutgoingMessage &message);
+	void sendPacket(const OutgoingMessage *message);
+	void fillWindow();
+	void scheduleTick();
+	static void handleTick(std::shared_ptr<ReliableUdpConnection> connection, const boost::system::error_code &error);
+	static void handleReceive(std::weak_ptr<ReliableUdpConnection> ptr);
+	void processPacket(const uint8_t *data, size_t size);
+	void processAcks(uint32_t ack, uint32_t ackBits);
+	bool processMessage(uint8_t channel, uint8_t mode, uint32_t channelSequence, const uint8_t *data, size_t size);
+	void recordReceivedPacket(uint32_t sequence);
+	void handlePeerRestart();
+	void deliver(uint8_t channel, std::unique_ptr<Buffer> message);
+	void updateRoundTripTime(boost::posix_time::time_duration sample);
+	boost::posix_time::time_duration getRetransmitTimeout(unsigned int retransmits);
+	void enterErrorState(const std::string &message);
+
+	boost::recursive_mutex commonMutex_;
+	std::shared_ptr<UdpSocket> socket_;
+	boost::asio::deadline_timer tickTimer_;
+	bool tickScheduled_;
+
+	bool hasError_;
+	std::string errorMessage_;
+
+	/*
+	 * The nonce of this connection, and the latest one seen from the peer, 0 if none.
+	 */
+	uint32_t localNonce_;
+	uint32_t remoteNonce_;
+	std::deque<uint32_t> retiredNonces_;
+
+	/*
+	 * Sending state. inFlight_ holds the unacknowledged reliable messages by the
+	 * sequence number of the packet they were last sent in.
+	 */
+	uint32_t nextPacketSequence_;
+	std::map<uint32_t, OutgoingMessage> inFlight_;
+	std::deque<OutgoingMessage> sendqueue_;
+	size_t sendqueueSize_;
+	size_t sendqueueLimit_;
+
+	/*
+	 * The latest packet received from the peer and the bit field of the 32
+	 * packets before it, which are sent with the next packet.
+	 */
+	uint32_t remoteSequence_;
+	uint32_t remoteAckBits_;
+	bool ackPending_;
+	size_t packetsSinceAck_;
+
+	double smoothedRtt_;
+	double rttVariance_;
+	bool hasRttSample_;
+
+	ChannelState channels_[MAX_CHANNELS];
+	std::deque<std::pair<uint8_t, std::unique_ptr<Buffer> > > receivequeue_;
+	size_t receivequeueSize_;
+	bool receiving_;
+
+	/*
+	 * Only used by the client thread, like the buffers of the other sockets.
+	 */
+	std::unique_ptr<Buffer> receiveBuffer_;
+	size_t receiveChannel_;
+	Buffer sendBuffer_;
+};
@@ -0,0 +1,120 @@
+#include "UdpPeer.hpp"
+#include "UdpSocket.hpp"
+
+#include <faucet/EndpointId.hpp>
+
+#include <boost/thread/locks.hpp>
+
+UdpPeer::UdpPeer(std::shared_ptr<UdpSocket> socket, const boost::asio::ip::udp::endpoint &endpoint,
+		size_t queueLimit) :
+		socket_(socket), endpoint_(endpoint), remoteIp_(endpoint.address().to_string()), receivequeue_(),
+		receiveBuffer_(new Buffer()), sendBuffer_(new Buffer()) {
+	receivequeue_.setMemSizeLimit(queueLimit);
+	getStats().detachFromGlobal();
+}
+
+UdpPeer::~UdpPeer() {
+}
+
+std::string UdpPeer::getErrorMessage() {
+	return socket_->getErrorMessage();
+}
+
+bool UdpPeer::hasError() {
+	return socket_->hasError();
+}
+
+void UdpPeer::write(const uint8_t *in, size_t size) {
+	sendBuffer_->write(in, size);
+}
+
+size_t UdpPeer::read(uint8_t *out, size_t size) {
+	return receiveBuffer_->read(out, size);
+}
+
+std::string UdpPeer::readString(size_t size) {
+	return receiveBuffer_->readString(size);
+}
+
+size_t UdpPeer::bytesRemaining() const {
+	return receiveBuffer_->bytesRemaining();
+}
+
+void UdpPeer::setReadpos(size_t pos) {
+	receiveBuffer_->setReadpos(pos);
+}
+
+size_t UdpPeer::getSendbufferSize() {
+	return sendBuffer_->size();
+}
+
+size_t UdpPeer::getReceivebufferSize() {
+	return receiveBuffer_->size();
+}
+
+/*
+ * Does nothing: sent datagrams go through the send queue of the socket, and
+ * its limit applies to all peers together, so it is set on the socket.
+ */
+void UdpPeer::setSendbufferLimit(size_t maxSize) {
+}
+
+Buffer &UdpPeer::getReceiveBuffer() {
+	return *receiveBuffer_;
+}
+
+std::string UdpPeer::getRemoteIp() {
+	return remoteIp_;
+}
+
+uint16_t UdpPeer::getRemotePort() {
+	return endpoint_.port();
+}
+
+uint64_t UdpPeer::getRemoteEndpointId() {
+	return getEndpointId(endpoint_.address(), endpoint_.port());
+}
+
+uint16_t UdpPeer::getLocalPort() {
+	return socket_->getLocalPort();
+}
+
+bool UdpPeer::send() {
+	getStats().increment(STAT_MESSAGES_SENT);
+	getStats().add(STAT_BYTES_SENT, sendBuffer_->size());
+	bool datagramsDiscarded = socket_->send(std::move(sendBuffer_), endpoint_);
+	sendBuffer_.reset(new Buffer());
+	return datagramsDiscarded;
+}
+
+bool UdpPeer::receive() {
+	boost::lock_guard<boost::recursive_mutex> guard(socket_->commonMutex_);
+	if (receivequeue_.isEmpty()) {
+		receiveBuffer_->clear();
+		return false;
+	}
+
+	QueueItem item = receivequeue_.take();
+	socket_->returnPooledBuffer(std::move(receiveBuffer_));
+	receiveBuffer_ = std::move(item.buffer);
+	return true;
+}
+
+uint64_t UdpPeer::getReceivedCount() {
+	boost::lock_guard<boost::recursive_mutex> guard(socket_->commonMutex_);
+	return receivequeue_.getCounters().pushedDatagrams;
+}
+
+uint64_t UdpPeer::getDroppedCount() {
+	boost::lock_guard<boost::recursive_mutex> guard(socket_->commonMutex_);
+	return receivequeue_.getCounters().droppedDatagrams;
+}
+
+bool UdpPeer::queueReceived(std::unique_ptr<Buffer> datagram) {
+	bool wasEmpty = receivequeue_.isEmpty();
+	getStats().increment(STAT_MESSAGES_RECEIVED);
+	getStats().add(STAT_BYTES_RECEIVED, datagram->size());
+	receivequeue_.push(QueueItem(std::move(datagram), endpoint_));
+	getStats().raise(STAT_RECEIVE_QUEUE_HIGH_WATER, receivequeue_.getMemSize());
+	return wasEmpty && !receivequeue_.isEmpty();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "DatagramQueue.hpp"
+
+#include <faucet/Socket.hpp>
+#include <faucet/Asio.hpp>
+#include <faucet/Buffer.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/utility.hpp>
+#include <string>
+#include <memory>
+
+class UdpSocket;
+
+/**
+ * One remote endpoint which sends datagrams to a UdpSocket with demultiplexing
+ * enabled. The peer has its own receive queue with its own memory limit, so a
+ * single sender flooding the socket can only cause its own datagrams to be
+ * dropped. Datagrams written to the peer are sent to its endpoint through
+ * the socket.
+ *
+ * All state shared with the IO thread is protected by the mutex of the socket.
+ */
+class UdpPeer: public Socket,
+		public std::enable_shared_from_this<UdpPeer>,
+		boost::noncopyable {
+	friend class UdpSocket;
+
+public:
+	UdpPeer(std::shared_ptr<UdpSocket> socket, const boost::asio::ip::udp::endpoint &endpoint, size_t queueLimit);
+	virtual ~UdpPeer();
+
+	virtual std::string getErrorMessage();
+	virtual bool hasError();
+
+	// Functions required by the ReadWritable interface
+	virtual void write(const uint8_t *in, size_t size);
+	virtual size_t read(uint8_t *out, size_t size);
+	virtual std::string readString(size_t size);
+	virtual size_t bytesRemaining() const;
+	virtual void setReadpos(size_t pos);
+
+	virtual size_t getSendbufferSize();
+	virtual size_t getReceivebufferSize();
+
+	/**
+	 * Does nothing, the send queue of the socket is shared by all its peers.
+	 */
+	virtual void setSendbufferLimit(size_t maxSize);
+
+	virtual Buffer &getReceiveBuffer();
+
+	virtual std::string getRemoteIp();
+	virtual uint16_t getRemotePort();
+	virtual uint64_t getRemoteEndpointId();
+	virtual uint16_t getLocalPort();
+
+	bool send();
+	bool receive();
+
+	uint64_t getReceivedCount();
+	uint64_t getDroppedCount();
+
+private:
+	/**
+	 * Called by the socket on the IO thread, with its mutex locked.
+	 * Returns true if the queue was empty before.
+	 */
+	bool queueReceived(std::unique_ptr<Buffer> datagram);
+
+	/*
+	 * The socket keeps new peers until they are accepted, which makes this a
+	 * cycle until then. Disabling demultiplexing releases those peers.
+	 */
+	std::shared_ptr<UdpSocket> socket_;
+	boost::asio::ip::udp::endpoint endpoint_;
+	std::string remoteIp_;
+
+	DatagramQueue receivequeue_;
+
+	std::unique_ptr<Buffer> receiveBuffer_;
+	std::unique_ptr<Buffer> sendBuffer_;
+};
@@ -1,320 +1,1138 @@
-#include "UdpSocket.hpp"
-
-#include "broadcastAddrs.hpp"
-#include <faucet/resolve.hpp>
-
-#include <boost/lexical_cast.hpp>
-#include <boost/make_shared.hpp>
-#include <boost/bind.hpp>
-#include <boost/thread/locks.hpp>
-
-using namespace boost::asio::ip;
-
-UdpSocket::UdpSocket() :
-		commonMutex_(), sendqueue_(), receivequeue_(), asyncSendInProgress_(
-				false), ipv4socket_(Asio::getIoService()), ipv6socket_(
-				Asio::getIoService()), resolver_(Asio::getIoService()), hasError_(false), errorMessage_(), localPort_(
-				0), remoteIp_(), remotePort_(), receiveBuffer_(new Buffer()), sendBuffer_(
-				new Buffer()) {
-}
-
-UdpSocket::~UdpSocket() {
-}
-
-/*
- * This code is intended to work on both WinXP and Vista/7, and allow binding to a random
- * unused port. Unfortunately there is no "safe" way to bind the same unused port for IPv4
- * and IPv6 in WinXP. Further, Vista's dual stack sockets don't work as expected with
- * regard to port re-use. Specifically, they apparently allow you to bind another pure
- * IPv4 and/or IPv6 socket to the same port within your application.
- *
- * To work around these problems, this is now done the following way:
- *
- * If the port number is not 0, we simply try binding an IPv4 and IPv6 socket to the given
- * port. If it is 0 and we are on Vista/7, we bind a dual stack socket first just to get
- * a port number assigned from the operating system which is free for both IPv4 and IPv6.
- * We remember the port number and then close that socket again, and then proceed just as
- * if that port had been given in the first place.
- * On WinXP with port 0, the dual stack socket creation will fail, and we just attempt to
- * open an IPv4 socket with an unused port, and then an IPv6 socket on the same port.
- *
- * As a consequence, this operation is not reliable on WinXP, since the IPv6 part may fail
- * even though there might be free ports available. It's also not reliable on Vista and
- * later because another process might steal the port after we close the dual stack socket,
- * but before we bind the other sockets. However, that seems rather unlikely in real-world
- * scenarios.
- */
-std::shared_ptr<UdpSocket> UdpSocket::bind(uint16_t portnr) {
-	std::shared_ptr<UdpSocket> socketPtr(new UdpSocket());
-	boost::system::error_code ignoredError, v4Error, v6Error;
-
-	if (portnr == 0) {
-		try {
-		    udp::socket dualstack_placeholder(Asio::getIoService());
-			dualstack_placeholder.open(udp::v6());
-			dualstack_placeholder.set_option(v6_only(false));
-			dualstack_placeholder.bind(udp::endpoint(udp::v6(), portnr));
-			portnr = dualstack_placeholder.local_endpoint().port();
-			dualstack_placeholder.close(ignoredError);
-		} catch (boost::system::system_error &e) {
-			// Error -> Probably no dual stack support or no v6 support at all
-		}
-	}
-
-	try {
-		socketPtr->ipv4socket_.open(udp::v4());
-		socketPtr->ipv4socket_.set_option(udp::socket::broadcast(true));
-		socketPtr->ipv4socket_.bind(udp::endpoint(udp::v4(), portnr));
-		portnr = socketPtr->ipv4socket_.local_endpoint().port();
-	} catch (boost::system::system_error &e) {
-		// Error -> IPv4 port is probably in use
-		v4Error = e.code();
-		socketPtr->ipv4socket_.close(ignoredError);
-	}
-
-    try {
-        socketPtr->ipv6socket_.open(udp::v6());
-        socketPtr->ipv6socket_.set_option(udp::socket::broadcast(true));
-        socketPtr->ipv6socket_.set_option(v6_only(true), ignoredError);
-        socketPtr->ipv6socket_.bind(udp::endpoint(udp::v6(), portnr));
-        portnr = socketPtr->ipv6socket_.local_endpoint().port();
-    } catch (boost::system::system_error &e) {
-        v6Error = e.code();
-        socketPtr->ipv6socket_.close(ignoredError);
-    }
-
-	if (!socketPtr->ipv4socket_.is_open()
-			&& !socketPtr->ipv6socket_.is_open()) {
-		socketPtr->hasError_ = true;
-		socketPtr->errorMessage_ = "IPv4: " + v4Error.message() + ", IPv6:"
-				+ v6Error.message();
-	} else {
-		socketPtr->localPort_ = portnr;
-		if (socketPtr->ipv4socket_.is_open()) {
-            auto buf = std::make_shared<std::array<uint8_t, 65536>>();
-			socketPtr->asyncReceive(&(socketPtr->ipv4socket_), buf);
-		}
-		if (socketPtr->ipv6socket_.is_open()) {
-		    auto buf = std::make_shared<std::array<uint8_t, 65536>>();
-			socketPtr->asyncReceive(&(socketPtr->ipv6socket_), buf);
-		}
-	}
-
-	return socketPtr;
-}
-
-std::shared_ptr<UdpSocket> UdpSocket::error(const std::string &message) {
-	std::shared_ptr<UdpSocket> socketPtr(new UdpSocket());
-	socketPtr->hasError_ = true;
-	socketPtr->errorMessage_ = message;
-	return socketPtr;
-}
-
-std::string UdpSocket::getErrorMessage() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return errorMessage_;
-}
-
-bool UdpSocket::hasError() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return hasError_;
-}
-
-void UdpSocket::write(const uint8_t *in, size_t size) {
-	sendBuffer_->write(in, size);
-}
-
-size_t UdpSocket::read(uint8_t *out, size_t size) {
-	return receiveBuffer_->read(out, size);
-}
-
-std::string UdpSocket::readString(size_t size) {
-	return receiveBuffer_->readString(size);
-}
-
-size_t UdpSocket::bytesRemaining() const {
-	return receiveBuffer_->bytesRemaining();
-}
-
-void UdpSocket::setReadpos(size_t pos) {
-	return receiveBuffer_->setReadpos(pos);
-}
-
-size_t UdpSocket::getSendbufferSize() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	return sendqueue_.getMemSize() + sendBuffer_->size();
-}
-
-size_t UdpSocket::getReceivebufferSize() {
-	return receiveBuffer_->size();
-}
-
-void UdpSocket::setSendbufferLimit(size_t maxSize) {
-	sendqueue_.setMemSizeLimit(maxSize);
-}
-
-Buffer &UdpSocket::getReceiveBuffer() {
-	return *receiveBuffer_;
-}
-
-uint16_t UdpSocket::getLocalPort() {
-	return localPort_;
-}
-
-bool UdpSocket::send(const std::string &host, uint16_t port) {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-
-	QueueItem item(sendBuffer_, host, port);
-	bool datagramsDiscarded = sendqueue_.push(item);
-	if(!asyncSendInProgress_) {
-		asyncSend();
-	}
-
-	sendBuffer_.reset(new Buffer());
-	return datagramsDiscarded;
-}
-
-bool UdpSocket::broadcast(uint16_t port) {
-	std::vector<boost::asio::ip::address_v4> addrs = findLocalBroadcastAddresses();
-
-	bool anyDiscarded = false;
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-
-	for(size_t i=0; i<addrs.size(); i++) {
-		QueueItem item(sendBuffer_, addrs[i].to_string(), port);
-		anyDiscarded |= sendqueue_.push(item);
-	}
-
-	if(!asyncSendInProgress_) {
-		asyncSend();
-	}
-
-	sendBuffer_.reset(new Buffer());
-
-	return anyDiscarded;
-}
-
-void UdpSocket::handleResolve(const boost::system::error_code &error,
-		udp::resolver::iterator endpointIterator,
-		std::shared_ptr<Buffer> buffer) {
-	handleSend(error ? error : boost::asio::error::host_not_found, buffer, V4FirstIterator<udp>(endpointIterator));
-}
-
-bool UdpSocket::receive() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	if (receivequeue_.isEmpty()) {
-		receiveBuffer_->clear();
-		remoteIp_ = "";
-		remotePort_ = 0;
-		return false;
-	}
-
-	receiveBuffer_ = receivequeue_.peek().buffer;
-	remoteIp_ = receivequeue_.peek().remoteHost;
-	remotePort_ = receivequeue_.peek().remotePort;
-	receivequeue_.pop();
-	return true;
-}
-
-void UdpSocket::close() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	sendqueue_.clear();
-	receivequeue_.clear();
-	sendBuffer_->clear();
-	receiveBuffer_->clear();
-}
-
-std::string UdpSocket::getRemoteIp() {
-	return remoteIp_;
-}
-
-uint16_t UdpSocket::getRemotePort() {
-	return remotePort_;
-}
-
-void UdpSocket::asyncSend() {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-
-	if (sendqueue_.isEmpty()) {
-		return;
-	}
-
-	QueueItem item = sendqueue_.peek();
-	sendqueue_.pop();
-	asyncSendInProgress_ = true;
-
-    fct_async_resolve<udp>(item.remoteHost, item.remotePort, resolver_, boost::bind(&UdpSocket::handleResolve, shared_from_this(),
-				boost::asio::placeholders::error, boost::asio::placeholders::iterator, item.buffer));
-}
-
-udp::socket *UdpSocket::getAppropriateSocket(const udp::endpoint &endpoint) {
-	if (endpoint.protocol() == udp::v4()) {
-		return &ipv4socket_;
-	} else {
-		return &ipv6socket_;
-	}
-}
-
-void UdpSocket::handleSend(const boost::system::error_code &err, std::shared_ptr<Buffer> buffer, V4FirstIterator<udp> endpoints) {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-
-	if(err && endpoints.hasNext()) {
-		udp::endpoint endpoint;
-		udp::socket *sock;
-		do {
-			endpoint = endpoints.next();
-			sock = getAppropriateSocket(endpoint);
-		} while(!sock->is_open() && endpoints.hasNext());
-
-		if(sock->is_open()) {
-			sock->async_send_to(
-					boost::asio::const_buffers_1(buffer->getData(), buffer->size()),
-					endpoint,
-					boost::bind(&UdpSocket::handleSend, shared_from_this(), boost::asio::placeholders::error, buffer, endpoints));
-			return;
-		}
-	}
-
-	asyncSendInProgress_ = false;
-
-	if (!sendqueue_.isEmpty()) {
-		asyncSend();
-	}
-}
-
-void UdpSocket::asyncReceive(boost::asio::ip::udp::socket *sock,
-		std::shared_ptr<std::array<uint8_t, 65536>> recvbuffer) {
-	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
-	auto endpoint = std::make_shared<udp::endpoint>();
-	sock->async_receive_from(
-			boost::asio::mutable_buffers_1(recvbuffer->data(), recvbuffer->size()),
-			*endpoint,
-			boost::bind(&UdpSocket::handleReceive, std::weak_ptr<UdpSocket>(shared_from_this()),
-					boost::asio::placeholders::error,
-					boost::asio::placeholders::bytes_transferred, endpoint,
-					sock, recvbuffer));
-}
-
-void UdpSocket::handleReceive(std::weak_ptr<UdpSocket> ptr, const boost::system::error_code &err,
-		size_t bytesTransferred,
-		std::shared_ptr<boost::asio::ip::udp::endpoint> endpoint,
-		boost::asio::ip::udp::socket *sock,
-		std::shared_ptr<std::array<uint8_t, 65536>> recvbuffer) {
-	std::shared_ptr<UdpSocket> sockPtr = ptr.lock();
-	if(!sockPtr) {
-		// The UdpSocket has been destroyed or has errored out, no need to keep receiving
-		return;
-	}
-
-	boost::lock_guard<boost::recursive_mutex> guard(sockPtr->commonMutex_);
-	if (!err) {
-		auto buffer = std::make_shared<Buffer>();
-		buffer->write(recvbuffer->data(), bytesTransferred);
-		boost::system::error_code ec;
-		sockPtr->receivequeue_.push(QueueItem(buffer, endpoint->address().to_string(ec), endpoint->port()));
-	}
-
-	if(sock->is_open()) {
-		sockPtr->asyncReceive(sock, recvbuffer);
-	}
-}
+#include "UdpSocket.hpp"
+
+#include "UdpPeer.hpp"
+#include "broadcastAddrs.hpp"
+#include <faucet/resolve.hpp>
+#include <faucet/EventQueue.hpp>
+#include <faucet/Trace.hpp>
+#include <faucet/EndpointId.hpp>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#include <cerrno>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+using namespace boost::asio::ip;
+
+#ifdef IP_MTU
+typedef boost::asio::detail::socket_option::integer<IPPROTO_IP, IP_MTU> ip_mtu;
+#endif
+#ifdef IPV6_MTU
+typedef boost::asio::detail::socket_option::integer<IPPROTO_IPV6, IPV6_MTU> ipv6_mtu;
+#endif
+
+namespace {
+	/**
+	 * The received datagrams are copied out of the slots before receiveDatagrams
+	 * returns, so all sockets served by an IO thread share its slots.
+	 */
+	boost::thread_specific_ptr<std::vector<uint8_t> > threadReceiveSlots;
+}
+
+UdpSocket::UdpSocket() :
+		commonMutex_(), sendqueue_(), receivequeue_(), asyncSendInProgress_(
+				false), sendBatch_(), sendBatchPos_(0), pendingResolves_(0), peerState_(PEER_NONE),
+				peerEndpoint_(), peerSocket_(0), peerGeneration_(0), peerWaiters_(), peerResolveStarted_(), ipv4socket_(Asio::getIoService()), ipv6socket_(
+				Asio::getIoService()), hasError_(false), errorMessage_(), localPort_(
+				0), remoteEndpoint_(), ipStrings_(), receiveBuffer_(new Buffer()), sendBuffer_(
+				new Buffer()), bufferPool_(), receiveListener_(), maxDatagramSize_(0),
+				nextMessageId_(0), reassembler_(), peerQueueLimit_(0), peers_(), newPeers_(),
+				peerCleanupSize_(MAX_NEW_PEERS), segmentationOffload_(false),
+				segmentationFailed_(false), corked_(false), sendPriority_(0) {
+}
+
+UdpSocket::~UdpSocket() {
+}
+
+/*
+ * This code is intended to work on both WinXP and Vista/7, and allow binding to a random
+ * unused port. Unfortunately there is no "safe" way to bind the same unused port for IPv4
+ * and IPv6 in WinXP. Further, Vista's dual stack sockets don't work as expected with
+ * regard to port re-use. Specifically, they apparently allow you to bind another pure
+ * IPv4 and/or IPv6 socket to the same port within your application.
+ *
+ * To work around these problems, this is now done the following way:
+ *
+ * If the port number is not 0, we simply try binding an IPv4 and IPv6 socket to the given
+ * port. If it is 0 and we are on Vista/7, we bind a dual stack socket first just to get
+ * a port number assigned from the operating system which is free for both IPv4 and IPv6.
+ * We remember the port number and then close that socket again, and then proceed just as
+ * if that port had been given in the first place.
+ * On WinXP with port 0, the dual stack socket creation will fail, and we just attempt to
+ * open an IPv4 socket with an unused port, and then an IPv6 socket on the same port.
+ *
+ * As a consequence, this operation is not reliable on WinXP, since the IPv6 part may fail
+ * even though there might be free ports available. It's also not reliable on Vista and
+ * later because another process might steal the port after we close the dual stack socket,
+ * but before we bind the other sockets. However, that seems rather unlikely in real-world
+ * scenarios.
+ */
+std::shared_ptr<UdpSocket> UdpSocket::bind(uint16_t portnr) {
+	std::shared_ptr<UdpSocket> socketPtr(new UdpSocket());
+	boost::system::error_code ignoredError, v4Error, v6Error;
+
+	if (portnr == 0) {
+		try {
+		    udp::socket dualstack_placeholder(Asio::getIoService());
+			dualstack_placeholder.open(udp::v6());
+			dualstack_placeholder.set_option(v6_only(false));
+			dualstack_placeholder.bind(udp::endpoint(udp::v6(), portnr));
+			portnr = dualstack_placeholder.local_endpoint().port();
+			dualstack_placeholder.close(ignoredError);
+		} catch (boost::system::system_error &e) {
+			// Error -> Probably no dual stack support or no v6 support at all
+		}
+	}
+
+	try {
+		socketPtr->ipv4socket_.open(udp::v4());
+		socketPtr->ipv4socket_.set_option(udp::socket::broadcast(true));
+		socketPtr->ipv4socket_.bind(udp::endpoint(udp::v4(), portnr));
+		socketPtr->ipv4socket_.non_blocking(true);
+		portnr = socketPtr->ipv4socket_.local_endpoint().port();
+	} catch (boost::system::system_error &e) {
+		// Error -> IPv4 port is probably in use
+		v4Error = e.code();
+		socketPtr->ipv4socket_.close(ignoredError);
+	}
+
+    try {
+        socketPtr->ipv6socket_.open(udp::v6());
+        socketPtr->ipv6socket_.set_option(udp::socket::broadcast(true));
+        socketPtr->ipv6socket_.set_option(v6_only(true), ignoredError);
+        socketPtr->ipv6socket_.bind(udp::endpoint(udp::v6(), portnr));
+        socketPtr->ipv6socket_.non_blocking(true);
+        portnr = socketPtr->ipv6socket_.local_endpoint().port();
+    } catch (boost::system::system_error &e) {
+        v6Error = e.code();
+        socketPtr->ipv6socket_.close(ignoredError);
+    }
+
+	if (!socketPtr->ipv4socket_.is_open()
+			&& !socketPtr->ipv6socket_.is_open()) {
+		socketPtr->hasError_ = true;
+		socketPtr->getStats().increment(STAT_ERRORS);
+		socketPtr->errorMessage_ = "IPv4: " + v4Error.message() + ", IPv6:"
+				+ v6Error.message();
+	} else {
+		socketPtr->localPort_ = portnr;
+		socketPtr->setSegmentationOffload(true);
+		if (socketPtr->ipv4socket_.is_open()) {
+			socketPtr->asyncReceive(&(socketPtr->ipv4socket_));
+		}
+		if (socketPtr->ipv6socket_.is_open()) {
+			socketPtr->asyncReceive(&(socketPtr->ipv6socket_));
+		}
+	}
+
+	return socketPtr;
+}
+
+std::shared_ptr<UdpSocket> UdpSocket::error(const std::string &message) {
+	std::shared_ptr<UdpSocket> socketPtr(new UdpSocket());
+	socketPtr->hasError_ = true;
+	socketPtr->errorMessage_ = message;
+	return socketPtr;
+}
+
+std::string UdpSocket::getErrorMessage() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return errorMessage_;
+}
+
+bool UdpSocket::hasError() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return hasError_;
+}
+
+void UdpSocket::write(const uint8_t *in, size_t size) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendBuffer_->write(in, size);
+}
+
+size_t UdpSocket::read(uint8_t *out, size_t size) {
+	return receiveBuffer_->read(out, size);
+}
+
+std::string UdpSocket::readString(size_t size) {
+	return receiveBuffer_->readString(size);
+}
+
+size_t UdpSocket::bytesRemaining() const {
+	return receiveBuffer_->bytesRemaining();
+}
+
+void UdpSocket::setReadpos(size_t pos) {
+	return receiveBuffer_->setReadpos(pos);
+}
+
+size_t UdpSocket::getSendbufferSize() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return sendqueue_.getMemSize() + sendBuffer_->size();
+}
+
+size_t UdpSocket::getReceivebufferSize() {
+	return receiveBuffer_->size();
+}
+
+void UdpSocket::setSendbufferLimit(size_t maxSize) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendqueue_.setMemSizeLimit(maxSize);
+}
+
+Buffer &UdpSocket::getReceiveBuffer() {
+	return *receiveBuffer_;
+}
+
+uint16_t UdpSocket::getLocalPort() {
+	return localPort_;
+}
+
+bool UdpSocket::send(const std::string &host, uint16_t port) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	// IP literals are parsed right away, so only hostnames need to go through the resolver
+	boost::system::error_code ec;
+	address parsedAddress = address::from_string(host, ec);
+	bool datagramsDiscarded;
+	if(!ec) {
+		datagramsDiscarded = queueDatagram(QueueItem(std::move(sendBuffer_), udp::endpoint(parsedAddress, port)));
+	} else {
+		datagramsDiscarded = queueDatagram(QueueItem(std::move(sendBuffer_), host, port));
+	}
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+
+	sendBuffer_.reset(new Buffer());
+	return datagramsDiscarded;
+}
+
+bool UdpSocket::send(std::unique_ptr<Buffer> datagram, const udp::endpoint &endpoint) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	bool datagramsDiscarded = queueDatagram(QueueItem(std::move(datagram), endpoint));
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+	return datagramsDiscarded;
+}
+
+void UdpSocket::connect(const std::string &host, uint16_t port) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	peerState_ = PEER_RESOLVING;
+	peerResolveStarted_ = LatencyClock::now();
+	FCT_TRACE_EVENT("udp resolve start", getHandle());
+	fct_async_resolve<udp>(host, port, boost::bind(&UdpSocket::handlePeerResolve, shared_from_this(),
+			boost::asio::placeholders::error, boost::asio::placeholders::iterator, ++peerGeneration_));
+}
+
+void UdpSocket::handlePeerResolve(const boost::system::error_code &error,
+		udp::resolver::iterator endpointIterator,
+		uint32_t peerGeneration) {
+	StatTimer timer(getStats(), STAT_SEND_HANDLER_NANOS);
+	FCT_TRACE_SCOPE("udp resolve done", getHandle());
+	FCT_TRACE_BEGIN("mutex wait", getHandle());
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	FCT_TRACE_END("mutex wait", getHandle());
+	if (peerGeneration != peerGeneration_) {
+		return;
+	}
+
+	LatencyClock::time_point now = LatencyClock::now();
+	getStats().recordLatency(LATENCY_RESOLVE_TIME, peerResolveStarted_, now);
+	peerState_ = PEER_FAILED;
+	peerSocket_ = 0;
+	if (!error) {
+		V4FirstIterator<udp> endpoints(endpointIterator);
+		while (endpoints.hasNext() && peerState_ != PEER_CONNECTED) {
+			udp::endpoint endpoint = endpoints.next();
+			udp::socket *sock = getAppropriateSocket(endpoint);
+			boost::system::error_code ec;
+			if (sock->is_open() && !sock->connect(endpoint, ec)) {
+				peerState_ = PEER_CONNECTED;
+				peerEndpoint_ = endpoint;
+				peerSocket_ = sock;
+			}
+		}
+	}
+
+	// Datagrams for the peer in the current batch have been waiting for this
+	std::vector<size_t> waiters;
+	waiters.swap(peerWaiters_);
+	for (size_t i = 0; i < waiters.size(); ++i) {
+		if (peerState_ == PEER_CONNECTED) {
+			sendBatch_[waiters[i]].endpoints.push_back(peerEndpoint_);
+		}
+		sendBatch_[waiters[i]].readyAt = now;
+		if (--pendingResolves_ == 0) {
+			sendBatch();
+		}
+	}
+}
+
+bool UdpSocket::sendToPeer() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	bool datagramsDiscarded = queueDatagram(QueueItem(std::move(sendBuffer_)));
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+
+	sendBuffer_.reset(new Buffer());
+	return datagramsDiscarded;
+}
+
+UdpSocket::PeerState UdpSocket::getPeerState() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return peerState_;
+}
+
+bool UdpSocket::broadcast(uint16_t port) {
+	auto addrs = findLocalBroadcastAddresses();
+
+	bool anyDiscarded = false;
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	for(auto &addr : *addrs) {
+		std::unique_ptr<Buffer> buffer(new Buffer());
+		buffer->write(sendBuffer_->getData(), sendBuffer_->size());
+		anyDiscarded |= queueDatagram(QueueItem(std::move(buffer), udp::endpoint(addr, port)));
+	}
+
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+
+	sendBuffer_->clear();
+
+	return anyDiscarded;
+}
+
+/**
+ * Add the datagram to the send queue, after adding the fragmentation header
+ * or splitting it up if fragmentation is enabled.
+ */
+bool UdpSocket::queueDatagram(QueueItem &&item) {
+	item.priority = sendPriority_;
+	if (maxDatagramSize_ == 0) {
+		return pushToSendqueue(std::move(item));
+	}
+
+	size_t datagramSize = getDatagramSize(item);
+	if (item.buffer->size() + WHOLE_HEADER_SIZE <= datagramSize) {
+		std::unique_ptr<Buffer> datagram = takePooledBuffer();
+		uint8_t type = DATAGRAM_WHOLE;
+		datagram->prepareWrite(WHOLE_HEADER_SIZE + item.buffer->size());
+		datagram->write(&type, WHOLE_HEADER_SIZE);
+		datagram->write(item.buffer->getData(), item.buffer->size());
+		returnPooledBuffer(std::move(item.buffer));
+		item.buffer = std::move(datagram);
+		return pushToSendqueue(std::move(item));
+	}
+
+	auto fragments = splitIntoFragments(*item.buffer, datagramSize, nextMessageId_++);
+	if (fragments.empty()) {
+		return true;
+	}
+
+	bool datagramsDiscarded = false;
+	for (size_t i = 0; i < fragments.size(); ++i) {
+		QueueItem fragment;
+		fragment.buffer = std::move(fragments[i]);
+		fragment.endpoint = item.endpoint;
+		fragment.remoteHost = item.remoteHost;
+		fragment.toPeer = item.toPeer;
+		fragment.priority = item.priority;
+		datagramsDiscarded |= pushToSendqueue(std::move(fragment));
+	}
+	return datagramsDiscarded;
+}
+
+bool UdpSocket::pushToSendqueue(QueueItem &&item) {
+	item.queuedAt = LatencyClock::now();
+	bool datagramsDiscarded = sendqueue_.push(std::move(item));
+	getStats().raise(STAT_SEND_QUEUE_HIGH_WATER, sendqueue_.getMemSize());
+	return datagramsDiscarded;
+}
+
+/**
+ * The size limit for datagrams to the item's destination, including the fragmentation header.
+ */
+size_t UdpSocket::getDatagramSize(const QueueItem &item) {
+	size_t datagramSize = maxDatagramSize_;
+	if (item.toPeer) {
+		size_t pathMtu = getPathMtu();
+		size_t headerSize = (peerEndpoint_.address().is_v4() ? 20 : 40) + 8;
+		if (pathMtu > headerSize + MIN_FRAGMENTED_DATAGRAM_SIZE) {
+			datagramSize = std::min(datagramSize, pathMtu - headerSize);
+		}
+	}
+	return datagramSize;
+}
+
+void UdpSocket::setFragmentation(size_t maxDatagramSize) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (maxDatagramSize != 0) {
+		if (maxDatagramSize < MIN_FRAGMENTED_DATAGRAM_SIZE) {
+			maxDatagramSize = MIN_FRAGMENTED_DATAGRAM_SIZE;
+		} else if (maxDatagramSize > MAX_FRAGMENTED_DATAGRAM_SIZE) {
+			maxDatagramSize = MAX_FRAGMENTED_DATAGRAM_SIZE;
+		}
+	} else {
+		reassembler_.clear();
+	}
+	maxDatagramSize_ = maxDatagramSize;
+}
+
+/*
+ * The OS learns the path MTU from ICMP messages and keeps it for the route,
+ * which only a connected socket can query.
+ */
+size_t UdpSocket::getPathMtu() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (peerState_ != PEER_CONNECTED) {
+		return 0;
+	}
+
+	boost::system::error_code ec;
+	if (peerEndpoint_.address().is_v4()) {
+#ifdef IP_MTU
+		ip_mtu mtu;
+		peerSocket_->get_option(mtu, ec);
+		if (!ec && mtu.value() > 0) {
+			return mtu.value();
+		}
+#endif
+	} else {
+#ifdef IPV6_MTU
+		ipv6_mtu mtu;
+		peerSocket_->get_option(mtu, ec);
+		if (!ec && mtu.value() > 0) {
+			return mtu.value();
+		}
+#endif
+	}
+	return 0;
+}
+
+void UdpSocket::setDemultiplexing(size_t peerQueueLimit) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	peerQueueLimit_ = peerQueueLimit;
+	if (peerQueueLimit == 0) {
+		peers_.clear();
+		newPeers_.clear();
+	}
+}
+
+std::shared_ptr<UdpPeer> UdpSocket::acceptPeer() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	std::shared_ptr<UdpPeer> peer;
+	if (!newPeers_.empty()) {
+		peer = newPeers_.front();
+		newPeers_.pop_front();
+	}
+	return peer;
+}
+
+bool UdpSocket::joinGroup(const std::string &group) {
+	return changeGroupMembership(group, true);
+}
+
+bool UdpSocket::leaveGroup(const std::string &group) {
+	return changeGroupMembership(group, false);
+}
+
+bool UdpSocket::changeGroupMembership(const std::string &group, bool join) {
+	boost::system::error_code ec;
+	address groupAddress = address::from_string(group, ec);
+	if (ec || !groupAddress.is_multicast()) {
+		return false;
+	}
+
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	udp::socket &sock = groupAddress.is_v4() ? ipv4socket_ : ipv6socket_;
+	if (!sock.is_open()) {
+		return false;
+	}
+
+	if (join) {
+		sock.set_option(multicast::join_group(groupAddress), ec);
+	} else {
+		sock.set_option(multicast::leave_group(groupAddress), ec);
+	}
+	return !ec;
+}
+
+bool UdpSocket::sendGroup(const std::string &group, uint16_t port) {
+	boost::system::error_code ec;
+	address groupAddress = address::from_string(group, ec);
+	if (ec || !groupAddress.is_multicast()) {
+		return false;
+	}
+
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	bool datagramsDiscarded = queueDatagram(QueueItem(std::move(sendBuffer_), udp::endpoint(groupAddress, port)));
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+
+	sendBuffer_.reset(new Buffer());
+	return datagramsDiscarded;
+}
+
+bool UdpSocket::setMulticastHops(int hops) {
+	return setOnBothSockets(multicast::hops(hops));
+}
+
+bool UdpSocket::setMulticastLoopback(bool enabled) {
+	return setOnBothSockets(multicast::enable_loopback(enabled));
+}
+
+/**
+ * Set the option on the open sockets. Returns true if it succeeded on any of them.
+ */
+template<typename Option>
+bool UdpSocket::setOnBothSockets(const Option &option) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	bool success = false;
+	boost::system::error_code ec;
+	if (ipv4socket_.is_open()) {
+		ipv4socket_.set_option(option, ec);
+		success |= !ec;
+	}
+	if (ipv6socket_.is_open()) {
+		ipv6socket_.set_option(option, ec);
+		success |= !ec;
+	}
+	return success;
+}
+
+void UdpSocket::setCorked(bool corked) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	corked_ = corked;
+	if(!asyncSendInProgress_ && !corked_) {
+		asyncSend();
+	}
+}
+
+void UdpSocket::setDropPolicy(DropPolicy policy) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendqueue_.setDropPolicy(policy);
+	receivequeue_.setDropPolicy(policy);
+}
+
+void UdpSocket::setSendPriority(uint8_t priority) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendPriority_ = priority;
+}
+
+DatagramQueueCounters UdpSocket::getSendQueueCounters() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return sendqueue_.getCounters();
+}
+
+DatagramQueueCounters UdpSocket::getReceiveQueueCounters() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	return receivequeue_.getCounters();
+}
+
+void UdpSocket::setSegmentationOffload(bool enabled) {
+#ifdef __linux__
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	segmentationOffload_ = enabled;
+
+	// Kernels before 5.0 don't support UDP_GRO, which just means datagrams arrive one by one
+	int value = enabled ? 1 : 0;
+	if (ipv4socket_.is_open()) {
+		::setsockopt(ipv4socket_.native_handle(), SOL_UDP, UDP_GRO, &value, sizeof(value));
+	}
+	if (ipv6socket_.is_open()) {
+		::setsockopt(ipv6socket_.native_handle(), SOL_UDP, UDP_GRO, &value, sizeof(value));
+	}
+#endif
+}
+
+void UdpSocket::handleResolve(const boost::system::error_code &error,
+		udp::resolver::iterator endpointIterator,
+		size_t batchIndex) {
+	StatTimer timer(getStats(), STAT_SEND_HANDLER_NANOS);
+	FCT_TRACE_SCOPE("udp resolve done", getHandle());
+	FCT_TRACE_BEGIN("mutex wait", getHandle());
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	FCT_TRACE_END("mutex wait", getHandle());
+	OutgoingDatagram &datagram = sendBatch_[batchIndex];
+	datagram.readyAt = LatencyClock::now();
+	getStats().recordLatency(LATENCY_RESOLVE_TIME, datagram.resolveStarted, datagram.readyAt);
+	if (!error) {
+		V4FirstIterator<udp> endpoints(endpointIterator);
+		while (endpoints.hasNext()) {
+			datagram.endpoints.push_back(endpoints.next());
+		}
+	}
+
+	if (--pendingResolves_ == 0) {
+		sendBatch();
+	}
+}
+
+bool UdpSocket::receive() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	if (receivequeue_.isEmpty()) {
+		receiveBuffer_->clear();
+		remoteEndpoint_ = udp::endpoint();
+		return false;
+	}
+
+	QueueItem item = receivequeue_.take();
+	returnPooledBuffer(std::move(receiveBuffer_));
+	receiveBuffer_ = std::move(item.buffer);
+	remoteEndpoint_ = item.endpoint;
+	return true;
+}
+
+size_t UdpSocket::receiveBatch(Buffer &target, size_t maxCount) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	size_t count = 0;
+	while (count < maxCount && !receivequeue_.isEmpty()) {
+		QueueItem item = receivequeue_.take();
+		target.writeIntValue<uint32_t>(item.buffer->size());
+		target.writeDouble(getEndpointId(item.endpoint.address(), item.endpoint.port()));
+		target.writeIntValue<uint16_t>(item.endpoint.port());
+		target.write(item.buffer->getData(), item.buffer->size());
+		returnPooledBuffer(std::move(item.buffer));
+		++count;
+	}
+	return count;
+}
+
+void UdpSocket::setReceiveListener(const std::function<void()> &listener) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	receiveListener_ = listener;
+}
+
+void UdpSocket::close() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	sendqueue_.clear();
+	receivequeue_.clear();
+	sendBuffer_->clear();
+	receiveBuffer_->clear();
+}
+
+std::string UdpSocket::getRemoteIp() {
+	if (remoteEndpoint_ == udp::endpoint()) {
+		return "";
+	}
+
+	auto cached = ipStrings_.find(remoteEndpoint_.address());
+	if (cached != ipStrings_.end()) {
+		return cached->second;
+	}
+
+	if (ipStrings_.size() >= MAX_CACHED_IP_STRINGS) {
+		ipStrings_.clear();
+	}
+	boost::system::error_code ec;
+	std::string ip = remoteEndpoint_.address().to_string(ec);
+	ipStrings_[remoteEndpoint_.address()] = ip;
+	return ip;
+}
+
+uint16_t UdpSocket::getRemotePort() {
+	return remoteEndpoint_.port();
+}
+
+uint64_t UdpSocket::getRemoteEndpointId() {
+	if (remoteEndpoint_ == udp::endpoint()) {
+		return 0;
+	}
+	return getEndpointId(remoteEndpoint_.address(), remoteEndpoint_.port());
+}
+
+/**
+ * Take a batch of datagrams from the send queue and start resolving their
+ * destinations. Sending starts once all of them are resolved, which usually
+ * happens immediately, since most destinations are IP literals or cached.
+ */
+void UdpSocket::asyncSend() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	if (sendqueue_.isEmpty()) {
+		return;
+	}
+
+	asyncSendInProgress_ = true;
+	sendBatch_.clear();
+	FCT_TRACE_EVENT("udp send start", getHandle());
+	sendBatchPos_ = 0;
+	segmentationFailed_ = false;
+	std::vector<QueueItem> items;
+	LatencyClock::time_point now = LatencyClock::now();
+	while (!sendqueue_.isEmpty() && items.size() < SEND_BATCH_SIZE) {
+		items.push_back(sendqueue_.take());
+		getStats().recordLatency(LATENCY_QUEUE_WAIT, items.back().queuedAt, now);
+
+		OutgoingDatagram datagram;
+		datagram.buffer = std::move(items.back().buffer);
+		datagram.nextEndpoint = 0;
+		datagram.resolveStarted = now;
+		datagram.readyAt = now;
+		sendBatch_.push_back(std::move(datagram));
+	}
+
+	// Hold back one count until all lookups are started, so that results which
+	// are available immediately don't start sending a half-initialized batch
+	pendingResolves_ = items.size() + 1;
+	for (size_t i = 0; i < items.size(); ++i) {
+		if (items[i].toPeer) {
+			if (peerState_ == PEER_RESOLVING) {
+				peerWaiters_.push_back(i);
+			} else {
+				if (peerState_ == PEER_CONNECTED) {
+					sendBatch_[i].endpoints.push_back(peerEndpoint_);
+				}
+				--pendingResolves_;
+			}
+		} else if (items[i].remoteHost.empty()) {
+			sendBatch_[i].endpoints.push_back(items[i].endpoint);
+			--pendingResolves_;
+		} else {
+			FCT_TRACE_EVENT("udp resolve start", getHandle());
+			fct_async_resolve<udp>(items[i].remoteHost, items[i].endpoint.port(), boost::bind(&UdpSocket::handleResolve, shared_from_this(),
+					boost::asio::placeholders::error, boost::asio::placeholders::iterator, i));
+		}
+	}
+
+	if (--pendingResolves_ == 0) {
+		sendBatch();
+	}
+}
+
+udp::socket *UdpSocket::getAppropriateSocket(const udp::endpoint &endpoint) {
+	if (endpoint.protocol() == udp::v4()) {
+		return &ipv4socket_;
+	} else {
+		return &ipv6socket_;
+	}
+}
+
+/**
+ * Send the datagrams of the current batch without blocking, for as long as the
+ * OS accepts them. If it doesn't, wait until the socket is writable again.
+ * If sending a datagram fails, its next endpoint is tried, if any.
+ */
+void UdpSocket::sendBatch() {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+
+	while (sendBatchPos_ < sendBatch_.size()) {
+		OutgoingDatagram &datagram = sendBatch_[sendBatchPos_];
+		if (datagram.nextEndpoint >= datagram.endpoints.size()) {
+			// No (more) endpoints to try, drop the datagram
+			++sendBatchPos_;
+			continue;
+		}
+
+		udp::socket *sock = getAppropriateSocket(datagram.endpoints[datagram.nextEndpoint]);
+		if (!sock->is_open()) {
+			++datagram.nextEndpoint;
+			continue;
+		}
+
+		boost::system::error_code ec;
+		size_t sent = sendDatagrams(*sock, sendBatch_.size() - sendBatchPos_, ec);
+		getStats().increment(STAT_SEND_SYSCALLS);
+		getStats().add(STAT_MESSAGES_SENT, sent);
+		LatencyClock::time_point sentAt = LatencyClock::now();
+		size_t bytesSent = 0;
+		for (size_t i = 0; i < sent; ++i) {
+			bytesSent += sendBatch_[sendBatchPos_ + i].buffer->size();
+			getStats().recordLatency(LATENCY_DISPATCH_DELAY, sendBatch_[sendBatchPos_ + i].readyAt, sentAt);
+		}
+		getStats().add(STAT_BYTES_SENT, bytesSent);
+		sendBatchPos_ += sent;
+		if (ec == boost::asio::error::would_block || ec == boost::asio::error::try_again) {
+			FCT_TRACE_EVENT("udp send wait", getHandle());
+			sock->async_send(boost::asio::null_buffers(),
+					boost::bind(&UdpSocket::handleSendReady, shared_from_this(), boost::asio::placeholders::error));
+			return;
+		} else if (ec && sendBatchPos_ < sendBatch_.size()) {
+			getStats().increment(STAT_ERRORS);
+			++sendBatch_[sendBatchPos_].nextEndpoint;
+		}
+	}
+
+	sendBatch_.clear();
+	sendBatchPos_ = 0;
+	asyncSendInProgress_ = false;
+
+	if (sendqueue_.isEmpty()) {
+		EventQueue::push(shared_from_this(), EVENT_SENDBUFFER_EMPTY);
+	} else if (!corked_) {
+		asyncSend();
+	}
+}
+
+void UdpSocket::handleSendReady(const boost::system::error_code &err) {
+	StatTimer timer(getStats(), STAT_SEND_HANDLER_NANOS);
+	FCT_TRACE_SCOPE("udp send ready", getHandle());
+	FCT_TRACE_BEGIN("mutex wait", getHandle());
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	FCT_TRACE_END("mutex wait", getHandle());
+	if (err && sendBatchPos_ < sendBatch_.size()) {
+		++sendBatch_[sendBatchPos_].nextEndpoint;
+	}
+	sendBatch();
+}
+
+/**
+ * Send up to count datagrams from the current batch position through the given socket,
+ * stopping at the first one which is meant for a different socket. Returns the number
+ * of datagrams sent. If that is less than count, ec may contain the error which occurred
+ * when sending the next one.
+ *
+ * On Linux, the datagrams are passed to the kernel with a single sendmmsg call. Runs of
+ * datagrams to the same endpoint which have the same size (except for a shorter last one)
+ * are combined into one message with a UDP_SEGMENT header, which the kernel splits up
+ * into separate datagrams again.
+ */
+size_t UdpSocket::sendDatagrams(udp::socket &sock, size_t count, boost::system::error_code &ec) {
+#ifdef __linux__
+	union SegmentControl {
+		cmsghdr header;
+		char space[CMSG_SPACE(sizeof(uint16_t))];
+	};
+
+	mmsghdr messages[SEND_BATCH_SIZE];
+	iovec iovecs[SEND_BATCH_SIZE];
+	SegmentControl controls[SEND_BATCH_SIZE];
+	size_t datagramCounts[SEND_BATCH_SIZE];
+	size_t messageCount = 0;
+	size_t datagramCount = 0;
+	while (datagramCount < count) {
+		OutgoingDatagram &datagram = sendBatch_[sendBatchPos_ + datagramCount];
+		if (datagram.nextEndpoint >= datagram.endpoints.size()
+				|| getAppropriateSocket(datagram.endpoints[datagram.nextEndpoint]) != &sock) {
+			break;
+		}
+
+		udp::endpoint &endpoint = datagram.endpoints[datagram.nextEndpoint];
+		size_t maxSegmentSize = endpoint.address().is_v4() ? MAX_SEGMENT_SIZE_V4 : MAX_SEGMENT_SIZE_V6;
+		size_t segmentSize = datagram.buffer->size();
+		size_t totalSize = 0;
+		size_t segments = 0;
+		do {
+			OutgoingDatagram &segment = sendBatch_[sendBatchPos_ + datagramCount + segments];
+			iovecs[datagramCount + segments].iov_base = const_cast<uint8_t *>(segment.buffer->getData());
+			iovecs[datagramCount + segments].iov_len = segment.buffer->size();
+			totalSize += segment.buffer->size();
+			++segments;
+			if (segment.buffer->size() < segmentSize) {
+				break;
+			}
+		} while (segmentationOffload_ && !segmentationFailed_ && segmentSize > 0 && segmentSize <= maxSegmentSize
+				&& segments < MAX_SEGMENTS && datagramCount + segments < count
+				&& totalSize + segmentSize <= MAX_SEGMENTED_SIZE
+				&& sendBatch_[sendBatchPos_ + datagramCount + segments].buffer->size() <= segmentSize
+				&& sendBatch_[sendBatchPos_ + datagramCount + segments].nextEndpoint == 0
+				&& sendBatch_[sendBatchPos_ + datagramCount + segments].endpoints.size() == 1
+				&& sendBatch_[sendBatchPos_ + datagramCount + segments].endpoints[0] == endpoint);
+
+		mmsghdr &message = messages[messageCount];
+		std::memset(&message, 0, sizeof(mmsghdr));
+		if (&sock != peerSocket_ || endpoint != peerEndpoint_) {
+			message.msg_hdr.msg_name = endpoint.data();
+			message.msg_hdr.msg_namelen = endpoint.size();
+		}
+		message.msg_hdr.msg_iov = &iovecs[datagramCount];
+		message.msg_hdr.msg_iovlen = segments;
+		if (segments > 1) {
+			std::memset(&controls[messageCount], 0, sizeof(SegmentControl));
+			message.msg_hdr.msg_control = controls[messageCount].space;
+			message.msg_hdr.msg_controllen = sizeof(controls[messageCount].space);
+			cmsghdr *control = CMSG_FIRSTHDR(&message.msg_hdr);
+			control->cmsg_level = SOL_UDP;
+			control->cmsg_type = UDP_SEGMENT;
+			control->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t size = static_cast<uint16_t>(segmentSize);
+			std::memcpy(CMSG_DATA(control), &size, sizeof(size));
+		}
+		datagramCounts[messageCount] = segments;
+		datagramCount += segments;
+		++messageCount;
+	}
+
+	int result = ::sendmmsg(sock.native_handle(), messages, messageCount, 0);
+	if (result < 0) {
+		if (errno == EIO && messages[0].msg_hdr.msg_control) {
+			// The device doesn't support segmentation, try again without it
+			segmentationOffload_ = false;
+			return 0;
+		} else if ((errno == EINVAL || errno == EMSGSIZE) && messages[0].msg_hdr.msg_control) {
+			// The segments exceed the path MTU, depending on the kernel version either
+			// error means that. Other endpoints may be fine, so this only affects this batch
+			segmentationFailed_ = true;
+			return 0;
+		}
+		ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+		return 0;
+	}
+
+	size_t sent = 0;
+	for (int i = 0; i < result; ++i) {
+		sent += datagramCounts[i];
+	}
+	return sent;
+#else
+	OutgoingDatagram &datagram = sendBatch_[sendBatchPos_];
+	boost::asio::const_buffers_1 data(datagram.buffer->getData(), datagram.buffer->size());
+	if (&sock == peerSocket_ && datagram.endpoints[datagram.nextEndpoint] == peerEndpoint_) {
+		sock.send(data, 0, ec);
+	} else {
+		sock.send_to(data, datagram.endpoints[datagram.nextEndpoint], 0, ec);
+	}
+	return ec ? 0 : 1;
+#endif
+}
+
+/**
+ * Wait until the socket is readable. The datagrams are then read in a batch,
+ * without blocking, by receiveDatagrams.
+ */
+void UdpSocket::asyncReceive(boost::asio::ip::udp::socket *sock) {
+	boost::lock_guard<boost::recursive_mutex> guard(commonMutex_);
+	FCT_TRACE_EVENT("udp receive start", getHandle());
+	sock->async_receive(boost::asio::null_buffers(),
+			boost::bind(&UdpSocket::handleReceive, std::weak_ptr<UdpSocket>(shared_from_this()),
+					boost::asio::placeholders::error, sock));
+}
+
+void UdpSocket::handleReceive(std::weak_ptr<UdpSocket> ptr, const boost::system::error_code &err,
+		boost::asio::ip::udp::socket *sock) {
+	std::shared_ptr<UdpSocket> sockPtr = ptr.lock();
+	if(!sockPtr) {
+		// The UdpSocket has been destroyed or has errored out, no need to keep receiving
+		return;
+	}
+
+	StatTimer timer(sockPtr->getStats(), STAT_RECEIVE_HANDLER_NANOS);
+	FCT_TRACE_SCOPE("udp receive done", sockPtr->getHandle());
+	std::function<void()> listener;
+	{
+		FCT_TRACE_BEGIN("mutex wait", sockPtr->getHandle());
+		boost::lock_guard<boost::recursive_mutex> guard(sockPtr->commonMutex_);
+		FCT_TRACE_END("mutex wait", sockPtr->getHandle());
+		if (err != boost::asio::error::operation_aborted && sock->is_open()) {
+			// Even on error, the pending datagrams (or the error) need to be consumed
+			sockPtr->receiveDatagrams(*sock);
+		}
+
+		if(sock->is_open()) {
+			sockPtr->asyncReceive(sock);
+		}
+
+		if (!sockPtr->receivequeue_.isEmpty()) {
+			listener = sockPtr->receiveListener_;
+		}
+	}
+
+	if (listener) {
+		listener();
+	}
+}
+
+/**
+ * Read up to RECEIVE_BATCH_SIZE datagrams from the socket without blocking,
+ * and add them to the receive queue. On Linux this is a single recvmmsg call.
+ */
+void UdpSocket::receiveDatagrams(udp::socket &sock) {
+	bool wasEmpty = receivequeue_.isEmpty();
+	ReceiveSlots &slots = getReceiveSlots();
+
+#ifdef __linux__
+	union SegmentControl {
+		cmsghdr header;
+		char space[CMSG_SPACE(sizeof(int))];
+	};
+
+	mmsghdr messages[RECEIVE_BATCH_SIZE];
+	iovec iovecs[RECEIVE_BATCH_SIZE];
+	SegmentControl controls[RECEIVE_BATCH_SIZE];
+	udp::endpoint endpoints[RECEIVE_BATCH_SIZE];
+	std::memset(messages, 0, sizeof(messages));
+	for (size_t i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+		iovecs[i].iov_base = &slots[i * MAX_DATAGRAM_SIZE];
+		iovecs[i].iov_len = MAX_DATAGRAM_SIZE;
+		messages[i].msg_hdr.msg_name = endpoints[i].data();
+		messages[i].msg_hdr.msg_namelen = endpoints[i].capacity();
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_control = controls[i].space;
+		messages[i].msg_hdr.msg_controllen = sizeof(controls[i].space);
+	}
+
+	int received = ::recvmmsg(sock.native_handle(), messages, RECEIVE_BATCH_SIZE, MSG_DONTWAIT, 0);
+	getStats().increment(STAT_RECEIVE_SYSCALLS);
+	for (int i = 0; i < received; ++i) {
+		endpoints[i].resize(messages[i].msg_hdr.msg_namelen);
+
+		// With UDP_GRO, the kernel may have coalesced several datagrams of the given size
+		size_t segmentSize = messages[i].msg_len;
+		for (cmsghdr *control = CMSG_FIRSTHDR(&messages[i].msg_hdr); control;
+				control = CMSG_NXTHDR(&messages[i].msg_hdr, control)) {
+			if (control->cmsg_level == SOL_UDP && control->cmsg_type == UDP_GRO) {
+				int size;
+				std::memcpy(&size, CMSG_DATA(control), sizeof(size));
+				if (size > 0) {
+					segmentSize = size;
+				}
+			}
+		}
+
+		const uint8_t *data = &slots[i * MAX_DATAGRAM_SIZE];
+		size_t remaining = messages[i].msg_len;
+		do {
+			size_t size = std::min(segmentSize, remaining);
+			queueReceivedDatagram(data, size, endpoints[i]);
+			data += size;
+			remaining -= size;
+		} while (remaining > 0);
+	}
+#else
+	for (size_t i = 0; i < RECEIVE_BATCH_SIZE; ++i) {
+		boost::system::error_code ec;
+		udp::endpoint endpoint;
+		size_t size = sock.receive_from(boost::asio::mutable_buffers_1(slots.data(), MAX_DATAGRAM_SIZE),
+				endpoint, 0, ec);
+		getStats().increment(STAT_RECEIVE_SYSCALLS);
+		if (ec == boost::asio::error::would_block) {
+			break;
+		} else if (!ec) {
+			queueReceivedDatagram(slots.data(), size, endpoint);
+		}
+	}
+#endif
+
+	if (wasEmpty && !receivequeue_.isEmpty()) {
+		EventQueue::push(shared_from_this(), EVENT_READABLE);
+	}
+}
+
+UdpSocket::ReceiveSlots &UdpSocket::getReceiveSlots() {
+	if (!threadReceiveSlots.get()) {
+		threadReceiveSlots.reset(new ReceiveSlots(RECEIVE_SLOT_COUNT * MAX_DATAGRAM_SIZE));
+	}
+	return *threadReceiveSlots;
+}
+
+void UdpSocket::queueReceivedDatagram(const uint8_t *data, size_t size, const udp::endpoint &endpoint) {
+	// The connected socket is filtered by the OS, the other one needs to be filtered here
+	if (peerState_ == PEER_CONNECTED && endpoint != peerEndpoint_) {
+		return;
+	}
+
+	getStats().increment(STAT_MESSAGES_RECEIVED);
+	getStats().add(STAT_BYTES_RECEIVED, size);
+
+	auto buffer = takePooledBuffer();
+	if (maxDatagramSize_ != 0) {
+		if (size > 0 && data[0] == DATAGRAM_FRAGMENT) {
+			if (reassembler_.add(data, size, endpoint, *buffer)) {
+				deliverDatagram(std::move(buffer), endpoint);
+			} else {
+				returnPooledBuffer(std::move(buffer));
+			}
+			return;
+		} else if (size == 0 || data[0] != DATAGRAM_WHOLE) {
+			returnPooledBuffer(std::move(buffer));
+			return;
+		}
+		data += WHOLE_HEADER_SIZE;
+		size -= WHOLE_HEADER_SIZE;
+	}
+
+	buffer->write(data, size);
+	deliverDatagram(std::move(buffer), endpoint);
+}
+
+/**
+ * Add a received datagram to the receive queue, or to the queue of its sender
+ * if demultiplexing is enabled.
+ */
+void UdpSocket::deliverDatagram(std::unique_ptr<Buffer> datagram, const udp::endpoint &endpoint) {
+	if (peerQueueLimit_ == 0) {
+		receivequeue_.push(QueueItem(std::move(datagram), endpoint));
+		getStats().raise(STAT_RECEIVE_QUEUE_HIGH_WATER, receivequeue_.getMemSize());
+		return;
+	}
+
+	std::shared_ptr<UdpPeer> peer = peers_[endpoint].lock();
+	if (!peer) {
+		if (newPeers_.size() >= MAX_NEW_PEERS) {
+			peers_.erase(endpoint);
+			returnPooledBuffer(std::move(datagram));
+			return;
+		}
+
+		peer = std::make_shared<UdpPeer>(shared_from_this(), endpoint, peerQueueLimit_);
+		peers_[endpoint] = peer;
+		newPeers_.push_back(peer);
+		EventQueue::push(shared_from_this(), EVENT_ACCEPTED);
+		if (peers_.size() >= peerCleanupSize_) {
+			removeExpiredPeers();
+		}
+	}
+
+	if (peer->queueReceived(std::move(datagram))) {
+		EventQueue::push(peer, EVENT_READABLE);
+	}
+}
+
+void UdpSocket::removeExpiredPeers() {
+	for (auto it = peers_.begin(); it != peers_.end();) {
+		if (it->second.expired()) {
+			peers_.erase(it++);
+		} else {
+			++it;
+		}
+	}
+	peerCleanupSize_ = 2 * peers_.size();
+	if (peerCleanupSize_ < MAX_NEW_PEERS) {
+		peerCleanupSize_ = MAX_NEW_PEERS;
+	}
+}
+
+std::unique_ptr<Buffer> UdpSocket::takePooledBuffer() {
+	if (bufferPool_.empty()) {
+		return std::unique_ptr<Buffer>(new Buffer());
+	}
+	std::unique_ptr<Buffer> buffer = std::move(bufferPool_.back());
+	bufferPool_.pop_back();
+	return buffer;
+}
+
+/**
+ * Keep the buffer for receiving another datagram, unless it is
+ * too large to be worth keeping.
+ */
+void UdpSocket::returnPooledBuffer(std::unique_ptr<Buffer> buffer) {
+	if (bufferPool_.size() < MAX_POOLED_BUFFERS
+			&& buffer->capacity() <= MAX_POOLED_BUFFER_CAPACITY) {
+		buffer->clear();
+		bufferPool_.push_back(std::move(buffer));
+	}
+}
@@ -1,88 +1,357 @@
-#pragma once
-
-#include "DatagramQueue.hpp"
-
-#include <faucet/Socket.hpp>
-#include <faucet/ReadWritable.hpp>
-#include <faucet/Asio.hpp>
-#include <faucet/Buffer.hpp>
-#include <faucet/V4FirstIterator.hpp>
-
-#include <boost/integer.hpp>
-#include <boost/thread/recursive_mutex.hpp>
-#include <boost/utility.hpp>
-#include <string>
-#include <memory>
-
-// TODO: Seperate error reporting for ipv4 and ipv6
-class UdpSocket: public Socket,
-		public std::enable_shared_from_this<UdpSocket>,
-		boost::noncopyable {
-
-public:
-	virtual ~UdpSocket();
-
-	virtual std::string getErrorMessage();
-	virtual bool hasError();
-
-	// Functions required by the ReadWritable interface
-	virtual void write(const uint8_t *in, size_t size);
-	virtual size_t read(uint8_t *out, size_t size);
-	virtual std::string readString(size_t size);
-	virtual size_t bytesRemaining() const;
-	virtual void setReadpos(size_t pos);
-
-	virtual size_t getSendbufferSize();
-	virtual size_t getReceivebufferSize();
-	virtual void setSendbufferLimit(size_t maxSize);
-
-	virtual Buffer &getReceiveBuffer();
-
-	virtual std::string getRemoteIp();
-	virtual uint16_t getRemotePort();
-	virtual uint16_t getLocalPort();
-
-	bool send(const std::string &host, uint16_t port);
-	bool broadcast(uint16_t port);
-	bool receive();
-
-	void close();
-
-	static std::shared_ptr<UdpSocket> error(const std::string &message);
-	static std::shared_ptr<UdpSocket> bind(uint16_t port);
-
-private:
-	UdpSocket();
-	void asyncSend();
-	void handleSend(const boost::system::error_code &err, std::shared_ptr<Buffer> sendBuffer, V4FirstIterator<boost::asio::ip::udp> endpoints);
-	void asyncReceive(boost::asio::ip::udp::socket *sock, std::shared_ptr<std::array<uint8_t, 65536>> recvbuffer);
-	static void handleReceive(std::weak_ptr<UdpSocket> ptr, const boost::system::error_code &err,
-			size_t bytesTransferred, std::shared_ptr<boost::asio::ip::udp::endpoint> endpoint,
-			boost::asio::ip::udp::socket *sock, std::shared_ptr<std::array<uint8_t, 65536>> recvbuffer);
-	void handleResolve(const boost::system::error_code &error,
-			boost::asio::ip::udp::resolver::iterator endpointIterator,
-			std::shared_ptr<Buffer> buffer);
-	boost::asio::ip::udp::socket *getAppropriateSocket(
-			const boost::asio::ip::udp::endpoint &endpoint);
-
-	boost::recursive_mutex commonMutex_;
-
-	DatagramQueue sendqueue_;
-	DatagramQueue receivequeue_;
-
-	bool asyncSendInProgress_;
-
-	boost::asio::ip::udp::socket ipv4socket_;
-	boost::asio::ip::udp::socket ipv6socket_;
-	boost::asio::ip::udp::resolver resolver_;
-
-	bool hasError_;
-	std::string errorMessage_;
-
-	uint16_t localPort_;
-	std::string remoteIp_;
-	uint16_t remotePort_;
-
-	std::shared_ptr<Buffer> receiveBuffer_;
-	std::shared_ptr<Buffer> sendBuffer_;
-};
+#pragma once
+
+#include "DatagramQueue.hpp"
+#include "Fragmentation.hpp"
+
+#include <faucet/Socket.hpp>
+#include <faucet/ReadWritable.hpp>
+#include <faucet/Asio.hpp>
+#include <faucet/Buffer.hpp>
+#include <faucet/V4FirstIterator.hpp>
+
+#include <boost/integer.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/utility.hpp>
+#include <functional>
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <map>
+
+class UdpPeer;
+
+// TODO: Seperate error reporting for ipv4 and ipv6
+class UdpSocket: public Socket,
+		public std::enable_shared_from_this<UdpSocket>,
+		boost::noncopyable {
+	friend class UdpPeer;
+
+public:
+	virtual ~UdpSocket();
+
+	virtual std::string getErrorMessage();
+	virtual bool hasError();
+
+	// Functions required by the ReadWritable interface
+	virtual void write(const uint8_t *in, size_t size);
+	virtual size_t read(uint8_t *out, size_t size);
+	virtual std::string readString(size_t size);
+	virtual size_t bytesRemaining() const;
+	virtual void setReadpos(size_t pos);
+
+	virtual size_t getSendbufferSize();
+	virtual size_t getReceivebufferSize();
+	virtual void setSendbufferLimit(size_t maxSize);
+
+	virtual Buffer &getReceiveBuffer();
+
+	virtual std::string getRemoteIp();
+	virtual uint16_t getRemotePort();
+	virtual uint64_t getRemoteEndpointId();
+	virtual uint16_t getLocalPort();
+
+	bool send(const std::string &host, uint16_t port);
+	bool send(std::unique_ptr<Buffer> datagram, const boost::asio::ip::udp::endpoint &endpoint);
+
+	/**
+	 * Resolve the host once and connect the socket of the matching protocol to it.
+	 * Datagrams queued with sendToPeer() are then sent without any per-datagram
+	 * resolution, and the OS drops datagrams from other senders. Datagrams
+	 * arriving on the socket of the other protocol are discarded as well.
+	 */
+	void connect(const std::string &host, uint16_t port);
+
+	/**
+	 * Queue the send buffer for the connected peer. If the peer is still
+	 * being resolved, the datagram is sent once that has finished.
+	 */
+	bool sendToPeer();
+
+	enum PeerState { PEER_NONE, PEER_RESOLVING, PEER_CONNECTED, PEER_FAILED };
+	PeerState getPeerState();
+	bool broadcast(uint16_t port);
+
+	/**
+	 * Join or leave an IPv4 or IPv6 multicast group, given as an IP literal,
+	 * on the default interface. Returns false if that failed.
+	 */
+	bool joinGroup(const std::string &group);
+	bool leaveGroup(const std::string &group);
+
+	/**
+	 * Send the send buffer to a multicast group. Unlike send(), the group
+	 * has to be given as an IP literal, so no lookup is needed.
+	 */
+	bool sendGroup(const std::string &group, uint16_t port);
+
+	/**
+	 * Set the TTL (IPv4) and hop limit (IPv6) of multicast datagrams, and
+	 * whether they are looped back to sockets on this host.
+	 */
+	bool setMulticastHops(int hops);
+	bool setMulticastLoopback(bool enabled);
+	bool receive();
+
+	/**
+	 * Move up to maxCount datagrams from the receive queue into the target buffer.
+	 * Each is written as its size (uint32, since reassembled messages can be
+	 * larger than 64 KB), the id of its sender (double, see getEndpointId())
+	 * and the sender's port (uint16), followed by the data. Returns the number
+	 * of datagrams written.
+	 */
+	size_t receiveBatch(Buffer &target, size_t maxCount);
+
+	/**
+	 * Set a function which is called on the IO thread whenever datagrams have
+	 * been added to the receive queue. It is called without holding the lock of
+	 * this socket, so it may call back into the socket.
+	 */
+	void setReceiveListener(const std::function<void()> &listener);
+
+	/**
+	 * Enable splitting messages into datagrams of at most maxDatagramSize bytes,
+	 * and reassembling them on the receiving side. 0 disables fragmentation.
+	 * This changes the format of all datagrams sent and received by the socket,
+	 * so it has to be enabled on both sides.
+	 *
+	 * For the connected peer, the size is further limited to the path MTU known
+	 * to the OS where it can be queried.
+	 */
+	void setFragmentation(size_t maxDatagramSize);
+
+	/**
+	 * The path MTU to the connected peer as known to the OS, or 0 if unknown.
+	 */
+	size_t getPathMtu();
+
+	/**
+	 * Enable sorting received datagrams into a separate queue for each sender,
+	 * each limited to peerQueueLimit bytes. 0 disables demultiplexing, but
+	 * peers which were already accepted keep their queued datagrams.
+	 *
+	 * Datagrams from a new sender create a UdpPeer which is kept until it is
+	 * taken with acceptPeer(). Once it has been accepted, the peer is only
+	 * referenced weakly, so that a new one is created for its endpoint after
+	 * the game has let go of it.
+	 */
+	void setDemultiplexing(size_t peerQueueLimit);
+
+	/**
+	 * On Linux, consecutive datagrams of the same size to the same endpoint are
+	 * passed to the kernel as one buffer which it splits up (UDP_SEGMENT), and
+	 * received datagrams may arrive coalesced (UDP_GRO). This is enabled by
+	 * default where the kernel supports it, and can be turned off to compare
+	 * with the plain path. Has no effect on other platforms. Segments are
+	 * limited to a 1500 byte MTU; where the path MTU is smaller, the kernel
+	 * rejects them and the datagrams are sent one by one instead.
+	 */
+	void setSegmentationOffload(bool enabled);
+
+	/**
+	 * While the socket is corked, sent datagrams are only queued. Uncorking
+	 * sends them in batches, which lets the kernel segment runs of same-sized
+	 * datagrams to one endpoint. Without corking, datagrams are only batched
+	 * when the socket can't keep up.
+	 */
+	void setCorked(bool corked);
+
+	/**
+	 * Set what is discarded when the send or receive queue is full. Received
+	 * datagrams all have the same priority, so DROP_PRIORITY only makes a
+	 * difference for the send queue and drops the oldest received datagrams.
+	 */
+	void setDropPolicy(DropPolicy policy);
+
+	/**
+	 * Set the priority of datagrams sent from now on, used by DROP_PRIORITY.
+	 */
+	void setSendPriority(uint8_t priority);
+
+	DatagramQueueCounters getSendQueueCounters();
+	DatagramQueueCounters getReceiveQueueCounters();
+
+	std::shared_ptr<UdpPeer> acceptPeer();
+
+	void close();
+
+	static std::shared_ptr<UdpSocket> error(const std::string &message);
+	static std::shared_ptr<UdpSocket> bind(uint16_t port);
+
+private:
+	/**
+	 * Maximum number of datagrams taken from the send queue at once.
+	 */
+	static const size_t SEND_BATCH_SIZE = 64;
+
+	/**
+	 * Maximum number of datagrams received per wakeup of the IO thread.
+	 */
+	static const size_t RECEIVE_BATCH_SIZE = 8;
+	static const size_t MAX_DATAGRAM_SIZE = 65536;
+
+	/**
+	 * Datagrams are received into separate slots only by recvmmsg on Linux,
+	 * elsewhere they are read one at a time into the same slot.
+	 */
+#ifdef __linux__
+	static const size_t RECEIVE_SLOT_COUNT = RECEIVE_BATCH_SIZE;
+#else
+	static const size_t RECEIVE_SLOT_COUNT = 1;
+#endif
+
+	/**
+	 * Limits for passing datagrams to the kernel as one segmented buffer. Larger
+	 * datagrams are sent individually, because segments must not exceed the MTU.
+	 * The segment sizes are what fits into a 1500 byte MTU after the IPv4 or IPv6
+	 * and UDP headers.
+	 */
+	static const size_t MAX_SEGMENTS = 64;
+	static const size_t MAX_SEGMENT_SIZE_V4 = 1472;
+	static const size_t MAX_SEGMENT_SIZE_V6 = 1452;
+	static const size_t MAX_SEGMENTED_SIZE = 65000;
+
+	/**
+	 * Buffers of received datagrams which the game is done with are kept for reuse,
+	 * as long as they are reasonably small.
+	 */
+	static const size_t MAX_POOLED_BUFFERS = 64;
+	static const size_t MAX_POOLED_BUFFER_CAPACITY = 4096;
+
+	/**
+	 * Maximum number of formatted IP addresses kept by getRemoteIp().
+	 */
+	static const size_t MAX_CACHED_IP_STRINGS = 256;
+
+	/**
+	 * Datagrams from further new senders are dropped while this many
+	 * peers are waiting to be accepted.
+	 */
+	static const size_t MAX_NEW_PEERS = 64;
+
+	static const size_t MIN_FRAGMENTED_DATAGRAM_SIZE = 256;
+	static const size_t MAX_FRAGMENTED_DATAGRAM_SIZE = 65507;
+
+	/**
+	 * Space for RECEIVE_SLOT_COUNT datagrams of the maximum size, which may also
+	 * be coalesced by UDP_GRO. Each IO thread has its own, see getReceiveSlots().
+	 */
+	typedef std::vector<uint8_t> ReceiveSlots;
+
+	/**
+	 * A datagram taken from the send queue, along with the endpoints
+	 * it can be sent to, in the order in which they are tried.
+	 */
+	struct OutgoingDatagram {
+		std::unique_ptr<Buffer> buffer;
+		std::vector<boost::asio::ip::udp::endpoint> endpoints;
+		size_t nextEndpoint;
+		LatencyClock::time_point resolveStarted;
+		LatencyClock::time_point readyAt;
+	};
+
+	UdpSocket();
+	bool changeGroupMembership(const std::string &group, bool join);
+	template<typename Option>
+	bool setOnBothSockets(const Option &option);
+	bool queueDatagram(QueueItem &&item);
+	bool pushToSendqueue(QueueItem &&item);
+	size_t getDatagramSize(const QueueItem &item);
+	void asyncSend();
+	void sendBatch();
+	void handleSendReady(const boost::system::error_code &err);
+	size_t sendDatagrams(boost::asio::ip::udp::socket &sock, size_t count, boost::system::error_code &ec);
+	void asyncReceive(boost::asio::ip::udp::socket *sock);
+	static void handleReceive(std::weak_ptr<UdpSocket> ptr, const boost::system::error_code &err,
+			boost::asio::ip::udp::socket *sock);
+	void receiveDatagrams(boost::asio::ip::udp::socket &sock);
+	static ReceiveSlots &getReceiveSlots();
+	void queueReceivedDatagram(const uint8_t *data, size_t size, const boost::asio::ip::udp::endpoint &endpoint);
+	void deliverDatagram(std::unique_ptr<Buffer> datagram, const boost::asio::ip::udp::endpoint &endpoint);
+	void removeExpiredPeers();
+	std::unique_ptr<Buffer> takePooledBuffer();
+	void returnPooledBuffer(std::unique_ptr<Buffer> buffer);
+	void handleResolve(const boost::system::error_code &error,
+			boost::asio::ip::udp::resolver::iterator endpointIterator,
+			size_t batchIndex);
+	void handlePeerResolve(const boost::system::error_code &error,
+			boost::asio::ip::udp::resolver::iterator endpointIterator,
+			uint32_t peerGeneration);
+	boost::asio::ip::udp::socket *getAppropriateSocket(
+			const boost::asio::ip::udp::endpoint &endpoint);
+
+	boost::recursive_mutex commonMutex_;
+
+	DatagramQueue sendqueue_;
+	DatagramQueue receivequeue_;
+
+	bool asyncSendInProgress_;
+
+	/*
+	 * The batch of datagrams currently being sent. sendBatchPos_ is the index
+	 * of the next datagram to send, pendingResolves_ the number of datagrams
+	 * whose endpoints are not known yet.
+	 */
+	std::vector<OutgoingDatagram> sendBatch_;
+	size_t sendBatchPos_;
+	size_t pendingResolves_;
+
+	/*
+	 * The connected peer, if any. peerGeneration_ is increased with every
+	 * connect() so that results of earlier lookups can be ignored.
+	 * peerWaiters_ holds the batch indices of datagrams for the peer
+	 * which are waiting for the lookup to finish.
+	 */
+	PeerState peerState_;
+	boost::asio::ip::udp::endpoint peerEndpoint_;
+	boost::asio::ip::udp::socket *peerSocket_;
+	uint32_t peerGeneration_;
+	std::vector<size_t> peerWaiters_;
+	LatencyClock::time_point peerResolveStarted_;
+
+	boost::asio::ip::udp::socket ipv4socket_;
+	boost::asio::ip::udp::socket ipv6socket_;
+
+	bool hasError_;
+	std::string errorMessage_;
+
+	uint16_t localPort_;
+
+	/*
+	 * The sender of the datagram in the receive buffer, and the string forms of
+	 * recent sender addresses. Like the receive buffer, these are only accessed
+	 * by the client thread.
+	 */
+	boost::asio::ip::udp::endpoint remoteEndpoint_;
+	std::map<boost::asio::ip::address, std::string> ipStrings_;
+
+	std::unique_ptr<Buffer> receiveBuffer_;
+	std::unique_ptr<Buffer> sendBuffer_;
+	std::vector<std::unique_ptr<Buffer> > bufferPool_;
+	std::function<void()> receiveListener_;
+
+	/*
+	 * Fragmentation is disabled while maxDatagramSize_ is 0.
+	 */
+	size_t maxDatagramSize_;
+	uint32_t nextMessageId_;
+	FragmentReassembler reassembler_;
+
+	/*
+	 * Demultiplexing is disabled while peerQueueLimit_ is 0. Expired entries
+	 * are removed from peers_ when it reaches peerCleanupSize_.
+	 */
+	size_t peerQueueLimit_;
+	std::map<boost::asio::ip::udp::endpoint, std::weak_ptr<UdpPeer> > peers_;
+	std::deque<std::shared_ptr<UdpPeer> > newPeers_;
+	size_t peerCleanupSize_;
+
+	bool segmentationOffload_;
+	/*
+	 * Set when the kernel rejected a segmented buffer, e.g. because the path MTU
+	 * is below 1500. The rest of the current batch is then sent without it.
+	 */
+	bool segmentationFailed_;
+	bool corked_;
+	uint8_t sendPriority_;
+};
@@ -1,40 +1,184 @@
-#include "broadcastAddrs.hpp"
-
-#define _WIN32_WINNT 0x0501
-#include <Iphlpapi.h>
-#include <cstdlib>
-
-using namespace boost::asio::ip;
-using namespace std;
-
-std::vector<address_v4> findLocalBroadcastAddresses() {
-	std::vector<address_v4> result;
-	PMIB_IPADDRTABLE pTable = (PMIB_IPADDRTABLE) malloc(sizeof(MIB_IPADDRTABLE));
-	DWORD dwSize = 0;
-
-	if(!pTable) {
-		return result;
-	}
-
-	// The size of pTable is probably too small, so this call will tell us how much memory we actually need.
-	if (GetIpAddrTable(pTable, &dwSize, 0) == ERROR_INSUFFICIENT_BUFFER) {
-		free(pTable);
-		pTable = (PMIB_IPADDRTABLE) malloc(dwSize);
-		if(!pTable) {
-			return result;
-		}
-	}
-
-	if (GetIpAddrTable(pTable, &dwSize, 0) != NO_ERROR) {
-		free(pTable);
-		return result;
-	}
-
-	for(DWORD i=0; i<pTable->dwNumEntries; i++) {
-		if(!(pTable->table[i].wType & (0x0008 | 0x0040))) // MIB_IPADDR_DISCONNECTED | MIB_IPADDR_DELETED
-			result.push_back(address_v4(ntohl(pTable->table[i].dwAddr | ~pTable->table[i].dwMask)));
-	}
-
-	free(pTable);
-	return result;
-}
+#include "broadcastAddrs.hpp"
+
+#ifdef _WIN32
+#define _WIN32_WINNT 0x0501
+#include <Iphlpapi.h>
+#include <cstdlib>
+#include <cstring>
+#else
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+using namespace boost::asio::ip;
+using namespace std;
+
+typedef std::vector<address_v4> AddressList;
+
+namespace {
+	/**
+	 * The table is re-read after this time even if no change was reported,
+	 * in case the notification mechanism is unavailable or missed something.
+	 */
+	const long REFRESH_INTERVAL_SECONDS = 10;
+
+	boost::mutex cacheMutex;
+	std::shared_ptr<const AddressList> cachedAddresses;
+	boost::posix_time::ptime lastRefresh;
+}
+
+#ifdef _WIN32
+
+namespace {
+	OVERLAPPED changeOverlapped;
+	HANDLE changeHandle = NULL;
+	bool changeNotificationActive = false;
+	bool changeNotificationFailed = false;
+
+	/**
+	 * Check whether the address table has changed since the last call, and
+	 * re-register for the next notification. Returns true if unsure. If
+	 * notifications are not available, only the refresh interval applies.
+	 */
+	bool interfacesChanged() {
+		if(changeNotificationActive) {
+			if(WaitForSingleObject(changeOverlapped.hEvent, 0) != WAIT_OBJECT_0) {
+				return false;
+			}
+			ResetEvent(changeOverlapped.hEvent);
+		} else if(changeNotificationFailed) {
+			return false;
+		} else {
+			memset(&changeOverlapped, 0, sizeof(changeOverlapped));
+			changeOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		}
+
+		changeNotificationActive = changeOverlapped.hEvent != NULL
+				&& NotifyAddrChange(&changeHandle, &changeOverlapped) == ERROR_IO_PENDING;
+		changeNotificationFailed = !changeNotificationActive;
+		return true;
+	}
+
+	AddressList enumerateBroadcastAddresses() {
+		AddressList result;
+		PMIB_IPADDRTABLE pTable = (PMIB_IPADDRTABLE) malloc(sizeof(MIB_IPADDRTABLE));
+		DWORD dwSize = 0;
+
+		if(!pTable) {
+			return result;
+		}
+
+		// The size of pTable is probably too small, so this call will tell us how much memory we actually need.
+		if (GetIpAddrTable(pTable, &dwSize, 0) == ERROR_INSUFFICIENT_BUFFER) {
+			free(pTable);
+			pTable = (PMIB_IPADDRTABLE) malloc(dwSize);
+			if(!pTable) {
+				return result;
+			}
+		}
+
+		if (GetIpAddrTable(pTable, &dwSize, 0) != NO_ERROR) {
+			free(pTable);
+			return result;
+		}
+
+		for(DWORD i=0; i<pTable->dwNumEntries; i++) {
+			if(!(pTable->table[i].wType & (0x0008 | 0x0040))) // MIB_IPADDR_DISCONNECTED | MIB_IPADDR_DELETED
+				result.push_back(address_v4(ntohl(pTable->table[i].dwAddr | ~pTable->table[i].dwMask)));
+		}
+
+		free(pTable);
+		return result;
+	}
+}
+
+#else
+
+namespace {
+	int netlinkSocket = -1;
+	bool netlinkOpened = false;
+
+	/**
+	 * Check whether a link or IPv4 address change was reported on the netlink
+	 * socket since the last call. Returns true if unsure.
+	 */
+	bool interfacesChanged() {
+		if(!netlinkOpened) {
+			netlinkOpened = true;
+			netlinkSocket = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+			if(netlinkSocket >= 0) {
+				sockaddr_nl address;
+				memset(&address, 0, sizeof(address));
+				address.nl_family = AF_NETLINK;
+				address.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+				if(bind(netlinkSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+					close(netlinkSocket);
+					netlinkSocket = -1;
+				}
+			}
+			return true;
+		}
+
+		if(netlinkSocket < 0) {
+			return false;
+		}
+
+		bool changed = false;
+		char buffer[4096];
+		for(;;) {
+			if(recv(netlinkSocket, buffer, sizeof(buffer), MSG_DONTWAIT) != -1) {
+				changed = true;
+			} else if(errno == ENOBUFS) {
+				// The socket buffer overflowed, so notifications were lost
+				changed = true;
+			} else if(errno != EINTR) {
+				return changed;
+			}
+		}
+	}
+
+	AddressList enumerateBroadcastAddresses() {
+		AddressList result;
+		ifaddrs *interfaces;
+		if(getifaddrs(&interfaces) != 0) {
+			return result;
+		}
+
+		for(ifaddrs *iface = interfaces; iface; iface = iface->ifa_next) {
+			if(!iface->ifa_addr || !iface->ifa_netmask || iface->ifa_addr->sa_family != AF_INET
+					|| !(iface->ifa_flags & IFF_UP)) {
+				continue;
+			}
+			uint32_t addr = reinterpret_cast<sockaddr_in *>(iface->ifa_addr)->sin_addr.s_addr;
+			uint32_t mask = reinterpret_cast<sockaddr_in *>(iface->ifa_netmask)->sin_addr.s_addr;
+			result.push_back(address_v4(ntohl(addr | ~mask)));
+		}
+
+		freeifaddrs(interfaces);
+		return result;
+	}
+}
+
+#endif
+
+std::shared_ptr<const AddressList> findLocalBroadcastAddresses() {
+	boost::lock_guard<boost::mutex> guard(cacheMutex);
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	bool changed = interfacesChanged();
+	if(changed || !cachedAddresses || now - lastRefresh > boost::posix_time::seconds(REFRESH_INTERVAL_SECONDS)) {
+		cachedAddresses = std::make_shared<const AddressList>(enumerateBroadcastAddresses());
+		lastRefresh = now;
+	}
+	return cachedAddresses;
+}
@@ -1,6 +1,14 @@
-#pragma once
-
-#include<vector>
-#include<boost/asio.hpp>
-
-std::vector<boost::asio::ip::address_v4> findLocalBroadcastAddresses();
+#pragma once
+
+#include<vector>
+#include<memory>
+#include<boost/asio.hpp>
+
+/**
+ * Return the broadcast addresses of the local IPv4 interfaces.
+ *
+ * The interface table is cached. It is refreshed when the OS reports a change
+ * of the interfaces or their addresses, and in any case after a few seconds,
+ * so calling this for every broadcast is cheap. Thread safe.
+ */
+std::shared_ptr<const std::vector<boost::asio::ip::address_v4> > findLocalBroadcastAddresses();
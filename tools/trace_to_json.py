@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Convert a trace dump written by trace_dump() into the Trace Event JSON
+format, which can be opened in chrome://tracing or ui.perfetto.dev.
+
+Usage: trace_to_json.py trace.bin [trace.json]
+"""
+
+import json
+import struct
+import sys
+
+PHASES = {0: "B", 1: "E", 2: "i"}
+
+
+def read_dump(data):
+    if data[:8] != b"FCTTRACE":
+        raise ValueError("not a Faucet Networking trace dump")
+    offset = 8
+
+    def take(fmt):
+        nonlocal offset
+        values = struct.unpack_from(fmt, data, offset)
+        offset += struct.calcsize(fmt)
+        return values
+
+    version, = take("<I")
+    if version != 1:
+        raise ValueError("unsupported trace dump version %d" % version)
+
+    name_count, = take("<I")
+    names = []
+    for _ in range(name_count):
+        length, = take("<I")
+        names.append(data[offset:offset + length].decode("utf-8", "replace"))
+        offset += length
+
+    threads = []
+    thread_count, = take("<I")
+    for _ in range(thread_count):
+        thread_id, thread_name, record_count = take("<III")
+        records = [take("<QQII") for _ in range(record_count)]
+        threads.append((thread_id, names[thread_name], records))
+    return names, threads
+
+
+def convert(names, threads):
+    events = []
+    for thread_id, thread_name, records in threads:
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": thread_id,
+                       "args": {"name": thread_name}})
+        for timestamp, arg, name, event_type in records:
+            event = {"name": names[name], "ph": PHASES.get(event_type, "i"), "pid": 1,
+                     "tid": thread_id, "ts": timestamp / 1000.0, "args": {"handle": arg}}
+            if event["ph"] == "i":
+                event["s"] = "t"
+            events.append(event)
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        names, threads = read_dump(f.read())
+    result = json.dumps(convert(names, threads))
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w") as f:
+            f.write(result)
+    else:
+        print(result)
+
+
+if __name__ == "__main__":
+    main()